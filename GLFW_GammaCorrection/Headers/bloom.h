@@ -0,0 +1,355 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "gputimer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Levels of the chain at most, the first one is half the size of the scene
+const unsigned int BLOOM_MAX_MIPS = 8;
+
+// Bloom on a chain of ever smaller textures, after Jimenez, "Next Generation Post Processing in
+// Call of Duty: Advanced Warfare". The scene is downsampled level by level with a 13 tap filter
+// (Shaders/bloom_downsample.fs), the first step weighting its taps by brightness so single bright
+// pixels don't flicker, and then upsampled back with a 3x3 tent filter (bloom_upsample.fs), each
+// level added onto the next larger one. Every pass only touches a level a quarter the size of the
+// one before, so the wide blur costs about a third of one pass at half resolution. Mips is the cost
+// knob: fewer levels are cheaper but give a narrower glow.
+class Bloom {
+public:
+	bool Enabled;
+	int Mips;
+	float Strength;
+	float FilterRadius;
+
+	// GPU time of the last Render() that came back, and how many have come back
+	GpuTimer Timer;
+	unsigned int TimerSamples;
+
+	Bloom() : Enabled(true), Mips(6), Strength(0.04f), FilterRadius(1.0f), TimerSamples(0), width(0), height(0), levelCount(0), emptyVAO(0), downsampleShader(nullptr), upsampleShader(nullptr) {
+		for (unsigned int i = 0; i < BLOOM_MAX_MIPS; i++) {
+			levels[i].FBO = 0;
+			levels[i].Texture = 0;
+			levels[i].Width = 0;
+			levels[i].Height = 0;
+		}
+	}
+
+	// downsampleShader: Shaders/fullscreen.vs + bloom_downsample.fs, upsampleShader: fullscreen.vs + bloom_upsample.fs
+	void Initialize(unsigned int width, unsigned int height, Shader* downsampleShader, Shader* upsampleShader) {
+		this->downsampleShader = downsampleShader;
+		this->upsampleShader = upsampleShader;
+		// Full screen passes draw one triangle from gl_VertexID, but a VAO must be bound.
+		glGenVertexArrays(1, &emptyVAO);
+		Timer.Initialize();
+		Resize(width, height);
+	}
+
+	// width and height of the scene, the chain starts at half of it.
+	void Resize(unsigned int width, unsigned int height) {
+		if (width == 0 || height == 0 || (width == this->width && height == this->height)) {
+			return;
+		}
+		releaseLevels();
+		this->width = width;
+		this->height = height;
+
+		unsigned int levelWidth = width;
+		unsigned int levelHeight = height;
+		for (levelCount = 0; levelCount < BLOOM_MAX_MIPS; levelCount++) {
+			levelWidth /= 2;
+			levelHeight /= 2;
+			if (levelWidth == 0 || levelHeight == 0) {
+				break;
+			}
+			Level& level = levels[levelCount];
+			level.Width = levelWidth;
+			level.Height = levelHeight;
+
+			glGenTextures(1, &level.Texture);
+			glBindTexture(GL_TEXTURE_2D, level.Texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, levelWidth, levelHeight, 0, GL_RGB, GL_FLOAT, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glGenFramebuffers(1, &level.FBO);
+			glBindFramebuffer(GL_FRAMEBUFFER, level.FBO);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, level.Texture, 0);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				std::cout << "ERROR::BLOOM::Framebuffer of level " << levelCount << " is not complete!" << std::endl;
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Levels actually used, Mips limited by what the size allows
+	unsigned int GetMipCount() const {
+		return std::min((unsigned int)std::max(Mips, 1), levelCount);
+	}
+
+	// Blur the scene down and back up the chain. Returns the half resolution texture holding the
+	// sum of all levels, to be divided by GetMipCount(). Depth test and blending must be off, the
+	// framebuffer and viewport are changed.
+	unsigned int Render(unsigned int sceneTexture) {
+		unsigned int count = GetMipCount();
+		if (count == 0) {
+			return 0;
+		}
+		Timer.Begin();
+		glBindVertexArray(emptyVAO);
+		glActiveTexture(GL_TEXTURE0);
+
+		downsampleShader->use();
+		downsampleShader->setInt("source", 0);
+		unsigned int source = sceneTexture;
+		glm::vec2 sourceSize((float)width, (float)height);
+		for (unsigned int i = 0; i < count; i++) {
+			glBindFramebuffer(GL_FRAMEBUFFER, levels[i].FBO);
+			glViewport(0, 0, levels[i].Width, levels[i].Height);
+			glBindTexture(GL_TEXTURE_2D, source);
+			downsampleShader->setVec2("sourceTexelSize", 1.0f / sourceSize);
+			downsampleShader->setVec2("targetSize", glm::vec2((float)levels[i].Width, (float)levels[i].Height));
+			downsampleShader->setBool("karisAverage", i == 0);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+
+			source = levels[i].Texture;
+			sourceSize = glm::vec2((float)levels[i].Width, (float)levels[i].Height);
+		}
+
+		// Each level blurred up onto the one above, which keeps its own downsampled image.
+		GLint blendSource = 0;
+		GLint blendDestination = 0;
+		glGetIntegerv(GL_BLEND_SRC_RGB, &blendSource);
+		glGetIntegerv(GL_BLEND_DST_RGB, &blendDestination);
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE);
+		upsampleShader->use();
+		upsampleShader->setInt("source", 0);
+		upsampleShader->setFloat("filterRadius", FilterRadius);
+		for (unsigned int i = count - 1; i > 0; i--) {
+			glBindFramebuffer(GL_FRAMEBUFFER, levels[i - 1].FBO);
+			glViewport(0, 0, levels[i - 1].Width, levels[i - 1].Height);
+			glBindTexture(GL_TEXTURE_2D, levels[i].Texture);
+			upsampleShader->setVec2("sourceTexelSize", glm::vec2(1.0f / levels[i].Width, 1.0f / levels[i].Height));
+			upsampleShader->setVec2("targetSize", glm::vec2((float)levels[i - 1].Width, (float)levels[i - 1].Height));
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+		glBlendFunc(blendSource, blendDestination);
+		glDisable(GL_BLEND);
+
+		glBindVertexArray(0);
+		Timer.End();
+		if (Timer.Poll()) {
+			TimerSamples++;
+		}
+		return levels[0].Texture;
+	}
+
+	void Release() {
+		releaseLevels();
+		Timer.Release();
+		if (emptyVAO != 0) {
+			glDeleteVertexArrays(1, &emptyVAO);
+			emptyVAO = 0;
+		}
+	}
+
+private:
+	struct Level {
+		unsigned int FBO;
+		unsigned int Texture;
+		unsigned int Width;
+		unsigned int Height;
+	};
+
+	unsigned int width;
+	unsigned int height;
+	Level levels[BLOOM_MAX_MIPS];
+	unsigned int levelCount;
+	unsigned int emptyVAO;
+
+	Shader* downsampleShader;
+	Shader* upsampleShader;
+
+	void releaseLevels() {
+		for (unsigned int i = 0; i < levelCount; i++) {
+			glDeleteFramebuffers(1, &levels[i].FBO);
+			glDeleteTextures(1, &levels[i].Texture);
+			levels[i].FBO = 0;
+			levels[i].Texture = 0;
+		}
+		levelCount = 0;
+		width = 0;
+		height = 0;
+	}
+};
+
+struct BloomResult {
+	unsigned int Width;
+	unsigned int Height;
+	int Mips;
+	float Milliseconds;
+};
+
+// GPU time of the bloom chain at fixed resolutions and every number of levels, which is what the
+// Mips knob costs, whatever the size of the window. The current
+// frame is scaled into a source of each size first (outside the timed part), so the chain runs on
+// a real 1080p or 4K input, until warmupFrames + sampleFrames timings came back; as in
+// LightBenchmark the warmup covers the timings still in flight from the step before.
+class BloomBenchmark {
+public:
+	std::vector<BloomResult> Results;
+	bool Running;
+
+	BloomBenchmark(unsigned int warmupFrames = 10, unsigned int sampleFrames = 60) : Running(false), warmupFrames(warmupFrames), sampleFrames(sampleFrames), step(0), frames(0), total(0.0f), readFBO(0), sourceFBO(0), sourceTexture(0), sourceWidth(0), sourceHeight(0) {
+
+	}
+
+	void Initialize(Shader* downsampleShader, Shader* upsampleShader) {
+		chain.Initialize(1, 1, downsampleShader, upsampleShader);
+		glGenFramebuffers(1, &readFBO);
+	}
+
+	void Start(const std::vector<glm::uvec2>& sizes) {
+		Results.clear();
+		for (unsigned int i = 0; i < sizes.size(); i++) {
+			for (unsigned int mips = 1; mips <= BLOOM_MAX_MIPS; mips++) {
+				BloomResult result;
+				result.Width = sizes[i].x;
+				result.Height = sizes[i].y;
+				result.Mips = mips;
+				result.Milliseconds = 0.0f;
+				Results.push_back(result);
+			}
+		}
+		step = 0;
+		frames = 0;
+		total = 0.0f;
+		Running = !Results.empty();
+	}
+
+	float GetProgress() const {
+		return Results.empty() ? 1.0f : (float)step / Results.size();
+	}
+
+	// Once per frame with the resolved scene and its size, the chain takes the filter radius of bloom.
+	// Same state requirements as Bloom::Render().
+	void Run(const Bloom& bloom, unsigned int sceneTexture, unsigned int sceneWidth, unsigned int sceneHeight) {
+		if (!Running) {
+			return;
+		}
+		unsigned int width = Results[step].Width;
+		unsigned int height = Results[step].Height;
+		resizeSource(width, height);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sceneTexture, 0);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sourceFBO);
+		glBlitFramebuffer(0, 0, sceneWidth, sceneHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+		chain.Resize(width, height);
+		chain.Mips = Results[step].Mips;
+		chain.FilterRadius = bloom.FilterRadius;
+		unsigned int samples = chain.TimerSamples;
+		chain.Render(sourceTexture);
+		if (chain.TimerSamples == samples) {
+			return;
+		}
+
+		frames++;
+		if (frames <= warmupFrames) {
+			return;
+		}
+		total += chain.Timer.Milliseconds;
+		if (frames < warmupFrames + sampleFrames) {
+			return;
+		}
+
+		Results[step].Milliseconds = total / sampleFrames;
+		step++;
+		frames = 0;
+		total = 0.0f;
+		if (step == Results.size()) {
+			Running = false;
+			Print();
+		}
+	}
+
+	void Print() const {
+		std::cout << "Bloom\tMips\tGPU (ms)" << std::endl;
+		for (unsigned int i = 0; i < Results.size(); i++) {
+			std::cout << Results[i].Width << "x" << Results[i].Height << "\t" << Results[i].Mips << "\t" << Results[i].Milliseconds << std::endl;
+		}
+	}
+
+	void Release() {
+		chain.Release();
+		releaseSource();
+		if (readFBO != 0) {
+			glDeleteFramebuffers(1, &readFBO);
+			readFBO = 0;
+		}
+	}
+
+private:
+	Bloom chain;
+	unsigned int warmupFrames;
+	unsigned int sampleFrames;
+	unsigned int step;
+	unsigned int frames;
+	float total;
+
+	// The scene scaled to the size of the step
+	unsigned int readFBO;
+	unsigned int sourceFBO;
+	unsigned int sourceTexture;
+	unsigned int sourceWidth;
+	unsigned int sourceHeight;
+
+	void resizeSource(unsigned int width, unsigned int height) {
+		if (width == sourceWidth && height == sourceHeight) {
+			return;
+		}
+		releaseSource();
+		sourceWidth = width;
+		sourceHeight = height;
+
+		glGenTextures(1, &sourceTexture);
+		glBindTexture(GL_TEXTURE_2D, sourceTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &sourceFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, sourceFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sourceTexture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::BLOOM::Benchmark source framebuffer is not complete!" << std::endl;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	void releaseSource() {
+		if (sourceFBO != 0) {
+			glDeleteFramebuffers(1, &sourceFBO);
+			glDeleteTextures(1, &sourceTexture);
+		}
+		sourceFBO = 0;
+		sourceTexture = 0;
+		sourceWidth = 0;
+		sourceHeight = 0;
+	}
+};
+
+#endif // !BLOOM_H
\ No newline at end of file
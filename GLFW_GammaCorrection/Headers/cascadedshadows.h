@@ -0,0 +1,334 @@
+#ifndef CASCADEDSHADOWS_H
+#define CASCADEDSHADOWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+#include "material.h"
+#include "frustum.h"
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Must match NUM_CASCADES in Shaders/gamma.fs and Shaders/deferred_light.fs
+const unsigned int CASCADE_COUNT = 4;
+const unsigned int SHADOW_SIZE = 1024;
+// Texture unit of the shadow map, after the clustered lighting buffers
+const unsigned int SHADOW_MAP_UNIT = 8;
+// A cascade moves in steps of 1/SHADOW_SNAP_STEPS of its width, whole texels each.
+const unsigned int SHADOW_SNAP_STEPS = 16;
+// How far behind a cascade (towards the light) casters are still drawn into it
+const float SHADOW_CASTER_DISTANCE = 100.0f;
+
+// Shadows of the direction light in CASCADE_COUNT cascades, layers of one depth texture array.
+// Each cascade covers the bounding sphere of a slice of the view frustum. The sphere only depends
+// on the projection, so a cascade keeps its size while the camera turns, and its window moves in
+// whole snapping steps (SHADOW_SNAP_STEPS, each a whole number of texels), so the shadow edges
+// don't swim as the camera moves. Casters are culled against every cascade separately.
+// Static casters are drawn into a second texture array only when their cascade moved a step or
+// the light turned; every frame that cache is copied into the shadow map and only the dynamic
+// casters are drawn on top.
+class CascadedShadows {
+public:
+	// Shadows reach this far from the camera, split with the practical scheme:
+	// logarithmic weighted by SplitLambda, uniform by the rest.
+	float Distance;
+	float SplitLambda;
+	bool CacheStatic;
+
+	// Statistics of the last Render()
+	unsigned int StaticRenders;
+	unsigned int DrawCalls;
+
+	CascadedShadows() : Distance(100.0f), SplitLambda(0.75f), CacheStatic(true), StaticRenders(0), DrawCalls(0), shadowMap(0), staticMap(0), casterShader(nullptr), lightView(1.0f), lightDirection(0.0f, -1.0f, 0.0f) {
+		for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+			cascades[i].FBO = 0;
+			cascades[i].StaticFBO = 0;
+			cascades[i].CacheValid = false;
+		}
+	}
+
+	// The caster shader only writes depth (see Shaders/depth.vs), view and projection are set per cascade.
+	void Initialize(Shader* shader) {
+		casterShader = shader;
+
+		// Sampled with hardware depth comparison (sampler2DArrayShadow)
+		shadowMap = createDepthArray(true);
+		// Only copied from
+		staticMap = createDepthArray(false);
+
+		for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+			cascades[i].FBO = createFramebuffer(shadowMap, i);
+			cascades[i].StaticFBO = createFramebuffer(staticMap, i);
+			cascades[i].StaticQueue.SetDepthProgram(casterShader);
+			cascades[i].DynamicQueue.SetDepthProgram(casterShader);
+		}
+	}
+
+	// A VAO with only the positions, drawn in place of VAO (see RenderQueue::SetDepthVAO()).
+	void SetDepthVAO(unsigned int VAO, unsigned int depthVAO) {
+		for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+			cascades[i].StaticQueue.SetDepthVAO(VAO, depthVAO);
+			cascades[i].DynamicQueue.SetDepthVAO(VAO, depthVAO);
+		}
+	}
+
+	// A caster that never moves, bounds are the local bounds of the mesh.
+	void AddStatic(unsigned int VAO, unsigned int indexCount, const glm::mat4& model, const AABB& bounds) {
+		staticCasters.push_back(makeCaster(VAO, indexCount, model, bounds));
+		for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+			cascades[i].CacheValid = false;
+		}
+	}
+
+	// Fit the cascades to the view frustum of the camera, fovy in degrees.
+	void Update(glm::vec3 position, glm::vec3 front, float fovy, float aspect, float nearPlane, glm::vec3 direction) {
+		// A zero direction from the UI keeps the last one.
+		if (glm::length(direction) > 0.0f) {
+			lightDirection = glm::normalize(direction);
+		}
+		glm::vec3 up = std::fabs(lightDirection.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		lightView = glm::lookAt(glm::vec3(0.0f), lightDirection, up);
+
+		// Squared slope of the frustum corners, off the view axis
+		float tanY = std::tan(glm::radians(fovy) * 0.5f);
+		float tanX = tanY * aspect;
+		float slope = tanX * tanX + tanY * tanY;
+
+		float farPlane = std::max(Distance, nearPlane * 2.0f);
+		float sliceNear = nearPlane;
+		for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+			float t = (float)(i + 1) / CASCADE_COUNT;
+			float logarithmic = nearPlane * std::pow(farPlane / nearPlane, t);
+			float uniform = nearPlane + (farPlane - nearPlane) * t;
+			float sliceFar = SplitLambda * logarithmic + (1.0f - SplitLambda) * uniform;
+
+			// Smallest sphere around the slice, its center on the view axis
+			float center = std::min((sliceNear + sliceFar) * 0.5f * (1.0f + slope), sliceFar);
+			float radius = std::sqrt((sliceFar - center) * (sliceFar - center) + sliceFar * sliceFar * slope);
+			// Keep the size exact from frame to frame, float noise would break the cache.
+			radius = std::ceil(radius * 16.0f) / 16.0f;
+
+			// The window is a snapping step wider than the sphere on every side.
+			float half = radius * SHADOW_SNAP_STEPS / (SHADOW_SNAP_STEPS - 2);
+			float step = 2.0f * half / SHADOW_SNAP_STEPS;
+
+			Cascade& cascade = cascades[i];
+			glm::vec3 worldCenter = position + glm::normalize(front) * center;
+			glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(worldCenter, 1.0f));
+			lightCenter = glm::floor(lightCenter / step + 0.5f) * step;
+
+			cascade.Projection = glm::ortho(lightCenter.x - half, lightCenter.x + half, lightCenter.y - half, lightCenter.y + half, -lightCenter.z - half - SHADOW_CASTER_DISTANCE, -lightCenter.z + half);
+			cascade.Matrix = cascade.Projection * lightView;
+			cascade.Sphere = glm::vec4(worldCenter, radius);
+			cascade.TexelSize = 2.0f * half / SHADOW_SIZE;
+			cascade.Bounds.Update(cascade.Matrix);
+
+			sliceNear = sliceFar;
+		}
+	}
+
+	// Dynamic casters of this frame
+	void Begin() {
+		dynamicCasters.clear();
+	}
+
+	void Add(unsigned int VAO, unsigned int indexCount, const glm::mat4& model, const AABB& bounds) {
+		dynamicCasters.push_back(makeCaster(VAO, indexCount, model, bounds));
+	}
+
+	void Render() {
+		StaticRenders = 0;
+		DrawCalls = 0;
+		if (casterShader == nullptr) {
+			return;
+		}
+
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glViewport(0, 0, SHADOW_SIZE, SHADOW_SIZE);
+		// Slope scaled bias, the shader adds a normal offset on top.
+		glEnable(GL_POLYGON_OFFSET_FILL);
+		glPolygonOffset(2.0f, 4.0f);
+
+		for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+			Cascade& cascade = cascades[i];
+			cascade.Bounds.ResetStats();
+
+			if (CacheStatic && (!cascade.CacheValid || cascade.CachedMatrix != cascade.Matrix)) {
+				glBindFramebuffer(GL_FRAMEBUFFER, cascade.StaticFBO);
+				glClear(GL_DEPTH_BUFFER_BIT);
+				drawCasters(cascade, cascade.StaticQueue, staticCasters);
+				cascade.CachedMatrix = cascade.Matrix;
+				cascade.CacheValid = true;
+				StaticRenders++;
+			}
+
+			if (CacheStatic) {
+				glBindFramebuffer(GL_READ_FRAMEBUFFER, cascade.StaticFBO);
+				glBindFramebuffer(GL_DRAW_FRAMEBUFFER, cascade.FBO);
+				glBlitFramebuffer(0, 0, SHADOW_SIZE, SHADOW_SIZE, 0, 0, SHADOW_SIZE, SHADOW_SIZE, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+				glBindFramebuffer(GL_FRAMEBUFFER, cascade.FBO);
+			} else {
+				glBindFramebuffer(GL_FRAMEBUFFER, cascade.FBO);
+				glClear(GL_DEPTH_BUFFER_BIT);
+				drawCasters(cascade, cascade.StaticQueue, staticCasters);
+			}
+			drawCasters(cascade, cascade.DynamicQueue, dynamicCasters);
+		}
+
+		glDisable(GL_POLYGON_OFFSET_FILL);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	}
+
+	// Bind the shadow map and set the cascade uniforms, the shader decides with useShadows.
+	void Bind(Shader& shader) {
+		glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_UNIT);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap);
+		glActiveTexture(GL_TEXTURE0);
+
+		shader.use();
+		shader.setInt("shadowMap", SHADOW_MAP_UNIT);
+		for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+			std::string index = "[" + std::to_string(i) + "]";
+			shader.setMat4("cascadeMatrices" + index, cascades[i].Matrix);
+			shader.setVec4("cascadeSpheres" + index, cascades[i].Sphere);
+			shader.setFloat("cascadeTexelSizes" + index, cascades[i].TexelSize);
+		}
+	}
+
+	// Casters drawn into a cascade in the last Render()
+	unsigned int GetCasters(unsigned int cascade) {
+		return cascades[cascade].Bounds.Visible;
+	}
+
+	float GetRadius(unsigned int cascade) {
+		return cascades[cascade].Sphere.w;
+	}
+
+	void Release() {
+		for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+			Cascade& cascade = cascades[i];
+			cascade.StaticQueue.Release();
+			cascade.DynamicQueue.Release();
+			if (cascade.FBO != 0) {
+				glDeleteFramebuffers(1, &cascade.FBO);
+				glDeleteFramebuffers(1, &cascade.StaticFBO);
+				cascade.FBO = 0;
+				cascade.StaticFBO = 0;
+			}
+			cascade.CacheValid = false;
+		}
+		if (shadowMap != 0) {
+			glDeleteTextures(1, &shadowMap);
+			glDeleteTextures(1, &staticMap);
+			shadowMap = 0;
+			staticMap = 0;
+		}
+	}
+
+private:
+	struct Caster {
+		unsigned int VAO;
+		unsigned int IndexCount;
+		glm::mat4 Model;
+		AABB Bounds;
+	};
+
+	struct Cascade {
+		glm::mat4 Projection;
+		glm::mat4 Matrix;
+		glm::vec4 Sphere;
+		float TexelSize;
+		Frustum Bounds;
+
+		unsigned int FBO;
+		unsigned int StaticFBO;
+		glm::mat4 CachedMatrix;
+		bool CacheValid;
+
+		RenderQueue StaticQueue;
+		RenderQueue DynamicQueue;
+	};
+
+	Cascade cascades[CASCADE_COUNT];
+	unsigned int shadowMap;
+	unsigned int staticMap;
+	Shader* casterShader;
+	// The render queue wants a material, casters only need their depth.
+	Material casterMaterial;
+
+	std::vector<Caster> staticCasters;
+	std::vector<Caster> dynamicCasters;
+	glm::mat4 lightView;
+	glm::vec3 lightDirection;
+
+	Caster makeCaster(unsigned int VAO, unsigned int indexCount, const glm::mat4& model, const AABB& bounds) {
+		Caster caster;
+		caster.VAO = VAO;
+		caster.IndexCount = indexCount;
+		caster.Model = model;
+		caster.Bounds = bounds;
+		return caster;
+	}
+
+	void drawCasters(Cascade& cascade, RenderQueue& queue, const std::vector<Caster>& casters) {
+		if (casters.empty()) {
+			return;
+		}
+		// Sorted front to back as seen from the light
+		glm::vec3 eye = glm::vec3(cascade.Sphere) - lightDirection * (cascade.Sphere.w + SHADOW_CASTER_DISTANCE);
+		queue.Begin(eye, lightDirection);
+		for (unsigned int i = 0; i < casters.size(); i++) {
+			queue.Submit(casters[i].VAO, casters[i].IndexCount, *casterShader, casterMaterial, casters[i].Model, casters[i].Bounds);
+		}
+		queue.Cull(cascade.Bounds);
+		queue.Sort();
+
+		casterShader->use();
+		casterShader->setMat4("view", lightView);
+		casterShader->setMat4("projection", cascade.Projection);
+		queue.FlushDepth();
+		DrawCalls += queue.DepthDrawCalls;
+	}
+
+	unsigned int createDepthArray(bool compare) {
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, SHADOW_SIZE, SHADOW_SIZE, CASCADE_COUNT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, compare ? GL_LINEAR : GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		if (compare) {
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		return texture;
+	}
+
+	unsigned int createFramebuffer(unsigned int texture, unsigned int layer) {
+		unsigned int FBO;
+		glGenFramebuffers(1, &FBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+		glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::SHADOWS::Cascade framebuffer is not complete!" << std::endl;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		return FBO;
+	}
+};
+
+#endif // !CASCADEDSHADOWS_H
\ No newline at end of file
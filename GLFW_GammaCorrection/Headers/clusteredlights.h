@@ -0,0 +1,393 @@
+#ifndef CLUSTEREDLIGHTS_H
+#define CLUSTEREDLIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "light.h"
+#include "frustum.h"
+#include "streambuffer.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Clusters on screen (x, y) and in depth (z)
+const unsigned int CLUSTER_X = 16;
+const unsigned int CLUSTER_Y = 9;
+const unsigned int CLUSTER_Z = 24;
+
+// Texels of one light: (position, linear), (diffuse, quadratic), (specular, constant), (ambient, radius),
+// (shadow slot, unused)
+const unsigned int CLUSTER_LIGHT_TEXELS = 5;
+
+// Texture units of the buffers, after the ones of the built-in materials (an imported model
+// with several specular maps would use them too)
+const unsigned int CLUSTER_LIGHTS_UNIT = 5;
+const unsigned int CLUSTER_GRID_UNIT = 6;
+const unsigned int CLUSTER_INDICES_UNIT = 7;
+
+// Clustered forward lighting. The view frustum is cut into CLUSTER_X x CLUSTER_Y tiles on screen
+// and CLUSTER_Z slices in depth, spaced exponentially so the clusters stay about as deep as wide.
+// Every frame each point light is tested against the view space bounds of the clusters it may
+// touch, its reach given by Light::GetRadius(). One depth slice is one task for the thread pool
+// and the sphere/box tests run 4 lights at a time. The lists go to three texture buffers:
+//   lights:  CLUSTER_LIGHT_TEXELS RGBA32F texels per light
+//   grid:    RG32UI (first index, count) per cluster
+//   indices: R32UI light index
+// and the fragment shader only loops over the lights of its own cluster (see Shaders/gamma.fs).
+// GL 3.3 has no texture buffer ranges, so every texture buffer covers its whole stream ring and
+// the shader gets the texel offsets of this frame's region as uniforms.
+class ClusteredLights {
+public:
+	// Statistics of the last Update()
+	unsigned int LightCount;
+	unsigned int IndexCount;
+	unsigned int MaxPerCluster;
+	float AssignTime;
+
+	ClusteredLights() : LightCount(0), IndexCount(0), MaxPerCluster(0), AssignTime(0.0f), lightStream(GL_TEXTURE_BUFFER), gridStream(GL_TEXTURE_BUFFER), indexStream(GL_TEXTURE_BUFFER), lightBase(0), gridBase(0), indexBase(0), depthScale(0.0f), depthBias(0.0f), nearPlane(0.1f), farPlane(100.0f), uploaded(false) {
+		for (unsigned int i = 0; i < 3; i++) {
+			textures[i] = 0;
+			attached[i] = 0;
+		}
+	}
+
+	void Initialize() {
+		glGenTextures(3, textures);
+		slices.resize(CLUSTER_Z);
+		cellOffsets.resize(CLUSTER_X * CLUSTER_Y * CLUSTER_Z);
+		cellCounts.resize(CLUSTER_X * CLUSTER_Y * CLUSTER_Z);
+	}
+
+	void Begin() {
+		centerX.clear();
+		centerY.clear();
+		centerZ.clear();
+		radii.clear();
+		lightTexels.clear();
+	}
+
+	// Point lights only, direction and spot lights stay in the uniform array of the shader.
+	void Add(const Light& light) {
+		if (!light.Enable || light.Caster != Light_Caster::POINT) {
+			return;
+		}
+		float radius = light.GetRadius();
+		centerX.push_back(light.Position.x);
+		centerY.push_back(light.Position.y);
+		centerZ.push_back(light.Position.z);
+		radii.push_back(radius);
+
+		lightTexels.push_back(glm::vec4(light.Position, light.Linear));
+		lightTexels.push_back(glm::vec4(light.Diffuse, light.Quadratic));
+		lightTexels.push_back(glm::vec4(light.Specular, light.Constant));
+		lightTexels.push_back(glm::vec4(light.Ambient, radius));
+		lightTexels.push_back(glm::vec4((float)light.ShadowSlot, 0.0f, 0.0f, 0.0f));
+	}
+
+	// Assign the lights to the clusters of this view and upload the lists.
+	// The projection must be a symmetric perspective with the given near and far planes.
+	void Update(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane, ThreadPool* pool) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		this->nearPlane = nearPlane;
+		this->farPlane = farPlane;
+		tanX = 1.0f / projection[0][0];
+		tanY = 1.0f / projection[1][1];
+
+		// slice = floor(log(depth) * depthScale + depthBias), the same formula as the shader.
+		float logRange = std::log(farPlane / nearPlane);
+		depthScale = CLUSTER_Z / logRange;
+		depthBias = -(float)CLUSTER_Z * std::log(nearPlane) / logRange;
+		sliceDepths.resize(CLUSTER_Z + 1);
+		for (unsigned int i = 0; i <= CLUSTER_Z; i++) {
+			sliceDepths[i] = nearPlane * std::pow(farPlane / nearPlane, (float)i / CLUSTER_Z);
+		}
+
+		// Light centers in view space, depth grows away from the camera.
+		LightCount = radii.size();
+		viewX.resize(LightCount);
+		viewY.resize(LightCount);
+		viewDepth.resize(LightCount);
+		for (unsigned int i = 0; i < LightCount; i++) {
+			glm::vec4 center = view * glm::vec4(centerX[i], centerY[i], centerZ[i], 1.0f);
+			viewX[i] = center.x;
+			viewY[i] = center.y;
+			viewDepth[i] = -center.z;
+		}
+
+		if (pool != nullptr) {
+			pool->ParallelFor(CLUSTER_Z, 1, [this](unsigned int begin, unsigned int end) {
+				for (unsigned int i = begin; i < end; i++) {
+					assignSlice(i);
+				}
+			});
+		} else {
+			for (unsigned int i = 0; i < CLUSTER_Z; i++) {
+				assignSlice(i);
+			}
+		}
+
+		// Put the slices one after the other, the grid points into the joined list.
+		unsigned int cellsPerSlice = CLUSTER_X * CLUSTER_Y;
+		grid.resize(cellsPerSlice * CLUSTER_Z * 2);
+		indices.clear();
+		MaxPerCluster = 0;
+		for (unsigned int slice = 0; slice < CLUSTER_Z; slice++) {
+			unsigned int base = indices.size();
+			for (unsigned int cell = slice * cellsPerSlice; cell < (slice + 1) * cellsPerSlice; cell++) {
+				grid[cell * 2] = base + cellOffsets[cell];
+				grid[cell * 2 + 1] = cellCounts[cell];
+				MaxPerCluster = std::max(MaxPerCluster, cellCounts[cell]);
+			}
+			indices.insert(indices.end(), slices[slice].Lights.begin(), slices[slice].Lights.end());
+		}
+		IndexCount = indices.size();
+
+		auto stop = std::chrono::high_resolution_clock::now();
+		AssignTime = std::chrono::duration<float, std::milli>(stop - start).count();
+
+		// Every stream gets its frame, EndFrame() closes all three whether the upload worked or not.
+		bool lightsUploaded = upload(0, lightStream, lightTexels.data(), lightTexels.size() * sizeof(glm::vec4), sizeof(glm::vec4), lightBase);
+		bool gridUploaded = upload(1, gridStream, grid.data(), grid.size() * sizeof(uint32_t), 2 * sizeof(uint32_t), gridBase);
+		bool indicesUploaded = upload(2, indexStream, indices.data(), indices.size() * sizeof(uint32_t), sizeof(uint32_t), indexBase);
+		uploaded = lightsUploaded && gridUploaded && indicesUploaded;
+	}
+
+	// Bind the buffers and set the uniforms of the shader, which must be in use.
+	// Returns false when the lists couldn't be uploaded, the shader should not use them then.
+	bool Bind(Shader& shader, unsigned int screenWidth, unsigned int screenHeight) {
+		if (!uploaded) {
+			return false;
+		}
+		attach(0, lightStream.GetBuffer(), GL_RGBA32F, CLUSTER_LIGHTS_UNIT);
+		attach(1, gridStream.GetBuffer(), GL_RG32UI, CLUSTER_GRID_UNIT);
+		attach(2, indexStream.GetBuffer(), GL_R32UI, CLUSTER_INDICES_UNIT);
+		glActiveTexture(GL_TEXTURE0);
+
+		shader.setInt("clusterLights", CLUSTER_LIGHTS_UNIT);
+		shader.setInt("clusterGrid", CLUSTER_GRID_UNIT);
+		shader.setInt("clusterIndices", CLUSTER_INDICES_UNIT);
+		shader.setInt("clusterLightBase", lightBase);
+		shader.setInt("clusterGridBase", gridBase);
+		shader.setInt("clusterIndexBase", indexBase);
+		shader.setVec2("clusterTileSize", glm::vec2((float)screenWidth / CLUSTER_X, (float)screenHeight / CLUSTER_Y));
+		shader.setVec2("clusterDepth", glm::vec2(depthScale, depthBias));
+		shader.setVec2("clusterPlanes", glm::vec2(nearPlane, farPlane));
+		return true;
+	}
+
+	// Fence this frame's lists after the last draw using them.
+	void EndFrame() {
+		lightStream.EndFrame();
+		gridStream.EndFrame();
+		indexStream.EndFrame();
+	}
+
+	void Release() {
+		lightStream.Release();
+		gridStream.Release();
+		indexStream.Release();
+		if (textures[0] != 0) {
+			glDeleteTextures(3, textures);
+		}
+		for (unsigned int i = 0; i < 3; i++) {
+			textures[i] = 0;
+			attached[i] = 0;
+		}
+		uploaded = false;
+	}
+
+private:
+	struct Slice {
+		// Lights touching the slice and their view space spheres, padded to a multiple of 4
+		std::vector<unsigned int> Candidates;
+		std::vector<float> X;
+		std::vector<float> Y;
+		std::vector<float> Depth;
+		std::vector<float> Radius;
+
+		// Light lists of the clusters of the slice, one after the other
+		std::vector<unsigned int> Lights;
+	};
+
+	// World space lights, filled by Add()
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radii;
+	std::vector<glm::vec4> lightTexels;
+
+	// View space lights and the clusters of this frame
+	std::vector<float> viewX;
+	std::vector<float> viewY;
+	std::vector<float> viewDepth;
+	std::vector<float> sliceDepths;
+	std::vector<Slice> slices;
+	std::vector<unsigned int> cellOffsets;
+	std::vector<unsigned int> cellCounts;
+	std::vector<uint32_t> grid;
+	std::vector<uint32_t> indices;
+
+	StreamBuffer lightStream;
+	StreamBuffer gridStream;
+	StreamBuffer indexStream;
+	unsigned int textures[3];
+	unsigned int attached[3];
+	int lightBase;
+	int gridBase;
+	int indexBase;
+
+	float tanX;
+	float tanY;
+	float depthScale;
+	float depthBias;
+	float nearPlane;
+	float farPlane;
+	bool uploaded;
+
+	// Runs on the worker threads, only touches the data of its own slice.
+	void assignSlice(unsigned int slice) {
+		Slice& data = slices[slice];
+		float nearDepth = sliceDepths[slice];
+		float farDepth = sliceDepths[slice + 1];
+		float halfWidth = farDepth * tanX;
+		float halfHeight = farDepth * tanY;
+
+		// Lights overlapping the box around the whole slice
+		data.Candidates.clear();
+		data.X.clear();
+		data.Y.clear();
+		data.Depth.clear();
+		data.Radius.clear();
+		for (unsigned int i = 0; i < LightCount; i++) {
+			float radius = radii[i];
+			if (viewDepth[i] + radius < nearDepth || viewDepth[i] - radius > farDepth) {
+				continue;
+			}
+			if (viewX[i] - radius > halfWidth || viewX[i] + radius < -halfWidth || viewY[i] - radius > halfHeight || viewY[i] + radius < -halfHeight) {
+				continue;
+			}
+			data.Candidates.push_back(i);
+			data.X.push_back(viewX[i]);
+			data.Y.push_back(viewY[i]);
+			data.Depth.push_back(viewDepth[i]);
+			data.Radius.push_back(radius);
+		}
+		unsigned int count = data.Candidates.size();
+		// Padding far away with no reach, never inside a cluster
+		while (data.X.size() % 4 != 0) {
+			data.Candidates.push_back(0);
+			data.X.push_back(1e30f);
+			data.Y.push_back(1e30f);
+			data.Depth.push_back(1e30f);
+			data.Radius.push_back(0.0f);
+		}
+
+		data.Lights.clear();
+		for (unsigned int y = 0; y < CLUSTER_Y; y++) {
+			float bottom = -1.0f + 2.0f * y / CLUSTER_Y;
+			float top = -1.0f + 2.0f * (y + 1) / CLUSTER_Y;
+			float minY = std::min(bottom * nearDepth, bottom * farDepth) * tanY;
+			float maxY = std::max(top * nearDepth, top * farDepth) * tanY;
+
+			for (unsigned int x = 0; x < CLUSTER_X; x++) {
+				float left = -1.0f + 2.0f * x / CLUSTER_X;
+				float right = -1.0f + 2.0f * (x + 1) / CLUSTER_X;
+				float minX = std::min(left * nearDepth, left * farDepth) * tanX;
+				float maxX = std::max(right * nearDepth, right * farDepth) * tanX;
+
+				unsigned int cell = (slice * CLUSTER_Y + y) * CLUSTER_X + x;
+				unsigned int first = data.Lights.size();
+				testCluster(data, count, minX, maxX, minY, maxY, nearDepth, farDepth);
+				cellOffsets[cell] = first;
+				cellCounts[cell] = data.Lights.size() - first;
+			}
+		}
+	}
+
+	// Append the candidates whose sphere touches the box to the light list.
+	void testCluster(Slice& data, unsigned int count, float minX, float maxX, float minY, float maxY, float minDepth, float maxDepth) {
+		unsigned int i = 0;
+#ifdef FRUSTUM_USE_SSE
+		__m128 zero = _mm_setzero_ps();
+		__m128 boxMinX = _mm_set1_ps(minX);
+		__m128 boxMaxX = _mm_set1_ps(maxX);
+		__m128 boxMinY = _mm_set1_ps(minY);
+		__m128 boxMaxY = _mm_set1_ps(maxY);
+		__m128 boxMinDepth = _mm_set1_ps(minDepth);
+		__m128 boxMaxDepth = _mm_set1_ps(maxDepth);
+		for (; i < count; i += 4) {
+			__m128 x = _mm_loadu_ps(&data.X[i]);
+			__m128 y = _mm_loadu_ps(&data.Y[i]);
+			__m128 depth = _mm_loadu_ps(&data.Depth[i]);
+			__m128 radius = _mm_loadu_ps(&data.Radius[i]);
+
+			// Distance from the center to the box on each axis, 0 inside
+			__m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(boxMinX, x), _mm_sub_ps(x, boxMaxX)), zero);
+			__m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(boxMinY, y), _mm_sub_ps(y, boxMaxY)), zero);
+			__m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(boxMinDepth, depth), _mm_sub_ps(depth, boxMaxDepth)), zero);
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+			int mask = _mm_movemask_ps(_mm_cmple_ps(distance, _mm_mul_ps(radius, radius)));
+			for (unsigned int k = 0; k < 4; k++) {
+				if (mask & (1 << k)) {
+					data.Lights.push_back(data.Candidates[i + k]);
+				}
+			}
+		}
+#endif
+		for (; i < count; i++) {
+			float dx = std::max(std::max(minX - data.X[i], data.X[i] - maxX), 0.0f);
+			float dy = std::max(std::max(minY - data.Y[i], data.Y[i] - maxY), 0.0f);
+			float dz = std::max(std::max(minDepth - data.Depth[i], data.Depth[i] - maxDepth), 0.0f);
+			if (dx * dx + dy * dy + dz * dz <= data.Radius[i] * data.Radius[i]) {
+				data.Lights.push_back(data.Candidates[i]);
+			}
+		}
+	}
+
+	// Write one frame of list i, base receives its offset in texels. The frame stays open even when
+	// this fails, EndFrame() ends it.
+	bool upload(unsigned int i, StreamBuffer& stream, const void* data, size_t size, size_t texelSize, int& base) {
+		// Never empty, and room to grow before the ring is recreated.
+		size_t needed = std::max(size, texelSize * 256);
+		if (needed > stream.GetFrameSize()) {
+			stream.Reserve(needed * 2);
+			// The new buffer may well get the old name, attach it again regardless.
+			attached[i] = 0;
+		}
+
+		stream.BeginFrame();
+		// A zero length map is an error, map one texel when the list is empty.
+		size_t offset = 0;
+		void* pointer = stream.Map(std::max(size, texelSize), texelSize, &offset);
+		if (pointer == nullptr) {
+			return false;
+		}
+		if (size > 0) {
+			std::memcpy(pointer, data, size);
+		}
+		stream.Unmap();
+		base = (int)(offset / texelSize);
+		return true;
+	}
+
+	// Point texture buffer i at a stream, again whenever the stream recreated its buffer.
+	void attach(unsigned int i, unsigned int buffer, GLenum format, unsigned int unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+		if (attached[i] != buffer) {
+			glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+			attached[i] = buffer;
+		}
+	}
+};
+
+#endif // !CLUSTEREDLIGHTS_H
\ No newline at end of file
@@ -0,0 +1,398 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+#include "light.h"
+#include "streambuffer.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Light volume instance attributes, see Shaders/deferred_volume.vs
+const unsigned int VOLUME_INSTANCE_LOCATION = 5;
+const unsigned int VOLUME_INSTANCE_ATTRIBUTES = 5;
+// Lights drawn in the full screen pass, must match NUM_LIGHTS in Shaders/deferred_light.fs
+const unsigned int DEFERRED_SCREEN_LIGHTS = 4;
+// The volume mesh is a tessellated sphere inside the unit sphere, grow it to contain the light.
+const float VOLUME_MARGIN = 1.05f;
+
+struct LightVolume {
+	glm::vec4 PositionRadius;
+	glm::vec4 DiffuseLinear;
+	glm::vec4 SpecularQuadratic;
+	glm::vec4 AmbientConstant;
+	// x: point shadow slot
+	glm::vec4 Shadow;
+};
+
+// Deferred shading. The geometry pass (the render queue, drawn with Shaders/gbuffer.fs) writes
+//   albedo (SRGB8_ALPHA8):    albedo, specular intensity (alpha is linear)
+//   normal/material (RGBA16F): octahedral normal, shininess, emission
+//   depth/stencil (D24S8):    the position is rebuilt from depth, stencil marks covered pixels
+// Direction and spot lights are then drawn as one full screen pass, point lights as instanced
+// spheres. Only the back faces of a sphere are drawn, with GL_GEQUAL, so pixels whose surface lies
+// behind the light are rejected by the depth test; the stencil rejects the background. Both
+// accumulate into a RGBA16F target that the composite pass writes to the screen, depth included.
+class DeferredRenderer {
+public:
+	// Statistics of the last Shade()
+	unsigned int LightVolumes;
+
+	DeferredRenderer() : LightVolumes(0), width(0), height(0), gBuffer(0), lightBuffer(0), lightTexture(0), lightDepth(0), blendEnabled(false), srgbEnabled(false), output(0), emptyVAO(0), volumeVAO(0), volumeVBO(0), volumeEBO(0), volumeIndexCount(0), screenShader(nullptr), volumeShader(nullptr), compositeShader(nullptr), volumeStream(GL_ARRAY_BUFFER), volumeOffset(0) {
+		for (unsigned int i = 0; i < 3; i++) {
+			gTextures[i] = 0;
+		}
+	}
+
+	// screenShader: Shaders/fullscreen.vs + deferred_light.fs, volumeShader: deferred_volume.vs +
+	// deferred_light.fs, compositeShader: fullscreen.vs + deferred_composite.fs. The sphere is given
+	// as interleaved vertices with the position first.
+	void Initialize(unsigned int width, unsigned int height, Shader* screenShader, Shader* volumeShader, Shader* compositeShader, const std::vector<float>& sphereVertices, unsigned int stride, const std::vector<unsigned int>& sphereIndices) {
+		this->screenShader = screenShader;
+		this->volumeShader = volumeShader;
+		this->compositeShader = compositeShader;
+
+		// Full screen passes draw one triangle from gl_VertexID, but a VAO must be bound.
+		glGenVertexArrays(1, &emptyVAO);
+
+		std::vector<float> positions;
+		for (unsigned int i = 0; i + stride <= sphereVertices.size(); i += stride) {
+			positions.insert(positions.end(), sphereVertices.begin() + i, sphereVertices.begin() + i + 3);
+		}
+		volumeIndexCount = sphereIndices.size();
+		glGenVertexArrays(1, &volumeVAO);
+		glGenBuffers(1, &volumeVBO);
+		glGenBuffers(1, &volumeEBO);
+		glBindVertexArray(volumeVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, volumeVBO);
+			glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, volumeEBO);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sphereIndices.size() * sizeof(unsigned int), sphereIndices.data(), GL_STATIC_DRAW);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+			for (unsigned int i = 0; i < VOLUME_INSTANCE_ATTRIBUTES; i++) {
+				glEnableVertexAttribArray(VOLUME_INSTANCE_LOCATION + i);
+				glVertexAttribDivisor(VOLUME_INSTANCE_LOCATION + i, 1);
+			}
+		glBindVertexArray(0);
+
+		Resize(width, height);
+	}
+
+	void Resize(unsigned int width, unsigned int height) {
+		if (width == 0 || height == 0 || (width == this->width && height == this->height)) {
+			return;
+		}
+		releaseTargets();
+		this->width = width;
+		this->height = height;
+
+		glGenFramebuffers(1, &gBuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+		glGenTextures(3, gTextures);
+		createTexture(gTextures[0], GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE);
+		createTexture(gTextures[1], GL_RGBA16F, GL_RGBA, GL_FLOAT);
+		createTexture(gTextures[2], GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gTextures[0], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gTextures[1], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gTextures[2], 0);
+		GLenum attachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, attachments);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::DEFERRED::G-buffer is not complete!" << std::endl;
+		}
+
+		// The light pass tests against a copy of the depth/stencil, the original is sampled meanwhile.
+		glGenFramebuffers(1, &lightBuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, lightBuffer);
+		glGenTextures(1, &lightTexture);
+		createTexture(lightTexture, GL_RGBA16F, GL_RGBA, GL_FLOAT);
+		glGenRenderbuffers(1, &lightDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, lightDepth);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lightTexture, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, lightDepth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::DEFERRED::Light buffer is not complete!" << std::endl;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Draw the opaque geometry with Shaders/gbuffer.fs between BeginGeometry() and EndGeometry().
+	void BeginGeometry() {
+		// The lit image goes back to the framebuffer bound now, the window or an HDR target.
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &output);
+		glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glStencilMask(0xFF);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+		// The alpha channels hold data, nothing may blend into them.
+		blendEnabled = glIsEnabled(GL_BLEND);
+		glDisable(GL_BLEND);
+		glEnable(GL_STENCIL_TEST);
+		glStencilFunc(GL_ALWAYS, 1, 0xFF);
+		glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+
+		// The albedo is stored as sRGB for precision in the darks, whether the screen is or not.
+		srgbEnabled = glIsEnabled(GL_FRAMEBUFFER_SRGB);
+		glEnable(GL_FRAMEBUFFER_SRGB);
+	}
+
+	void EndGeometry() {
+		if (!srgbEnabled) {
+			glDisable(GL_FRAMEBUFFER_SRGB);
+		}
+		glStencilMask(0x00);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, lightBuffer);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+		glBindFramebuffer(GL_FRAMEBUFFER, output);
+	}
+
+	void BeginLights() {
+		volumes.clear();
+		screenLights.clear();
+	}
+
+	// Point lights become volumes, direction and spot lights go to the full screen pass.
+	void Add(const Light& light) {
+		if (!light.Enable) {
+			return;
+		}
+		if (light.Caster != Light_Caster::POINT) {
+			if (screenLights.size() < DEFERRED_SCREEN_LIGHTS) {
+				screenLights.push_back(light);
+			}
+			return;
+		}
+		LightVolume volume;
+		volume.PositionRadius = glm::vec4(light.Position, light.GetRadius());
+		volume.DiffuseLinear = glm::vec4(light.Diffuse, light.Linear);
+		volume.SpecularQuadratic = glm::vec4(light.Specular, light.Quadratic);
+		volume.AmbientConstant = glm::vec4(light.Ambient, light.Constant);
+		volume.Shadow = glm::vec4((float)light.ShadowSlot, 0.0f, 0.0f, 0.0f);
+		volumes.push_back(volume);
+	}
+
+	// Accumulate the lights. Both light shaders must already have their other uniforms (useBlinnPhong).
+	void Shade(const glm::mat4& view, const glm::mat4& projection, glm::vec3 viewPosition) {
+		LightVolumes = volumes.size();
+		glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, lightBuffer);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glStencilFunc(GL_EQUAL, 1, 0xFF);
+		bindGBuffer();
+
+		// Direction and spot lights and the emission, over every covered pixel
+		glDisable(GL_DEPTH_TEST);
+		screenShader->use();
+		setCommonUniforms(*screenShader, inverseViewProjection, viewPosition);
+		screenShader->setBool("volumePass", false);
+		screenShader->setInt("lightCount", screenLights.size());
+		for (unsigned int i = 0; i < screenLights.size(); i++) {
+			setLight(*screenShader, i, screenLights[i]);
+		}
+		glBindVertexArray(emptyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+
+		// Point lights, added on top
+		if (!volumes.empty() && uploadVolumes()) {
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_ONE, GL_ONE);
+			glEnable(GL_DEPTH_TEST);
+			glDepthFunc(GL_GEQUAL);
+			glDepthMask(GL_FALSE);
+			// Far sides of volumes reaching past the far plane are kept at the far plane.
+			glEnable(GL_DEPTH_CLAMP);
+			// The sphere of geneSphereData() winds inward, so its far side is the front face.
+			glEnable(GL_CULL_FACE);
+			glCullFace(GL_BACK);
+
+			volumeShader->use();
+			setCommonUniforms(*volumeShader, inverseViewProjection, viewPosition);
+			volumeShader->setBool("volumePass", true);
+			volumeShader->setMat4("view", view);
+			volumeShader->setMat4("projection", projection);
+			volumeShader->setFloat("volumeMargin", VOLUME_MARGIN);
+			glBindVertexArray(volumeVAO);
+			bindVolumes();
+			glDrawElementsInstanced(GL_TRIANGLES, volumeIndexCount, GL_UNSIGNED_INT, 0, volumes.size());
+			volumeStream.EndFrame();
+
+			glDisable(GL_CULL_FACE);
+			glDisable(GL_DEPTH_CLAMP);
+			glDepthMask(GL_TRUE);
+			glDepthFunc(GL_LESS);
+			glDisable(GL_BLEND);
+		}
+
+		glBindVertexArray(0);
+		glEnable(GL_DEPTH_TEST);
+		glDisable(GL_STENCIL_TEST);
+		glStencilMask(0xFF);
+		glBindFramebuffer(GL_FRAMEBUFFER, output);
+	}
+
+	// Write the lit image and the scene depth to the bound framebuffer, the background is left alone.
+	// The shader must already have its other uniforms (useLighting). The colors are linear, an sRGB
+	// framebuffer encodes them.
+	void Composite() {
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, lightTexture);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, gTextures[0]);
+		glActiveTexture(GL_TEXTURE2);
+		glBindTexture(GL_TEXTURE_2D, gTextures[2]);
+		glActiveTexture(GL_TEXTURE0);
+
+		compositeShader->use();
+		compositeShader->setInt("lightAccumulation", 0);
+		compositeShader->setInt("gAlbedoSpecular", 1);
+		compositeShader->setInt("gDepth", 2);
+		compositeShader->setVec2("screenSize", glm::vec2((float)width, (float)height));
+
+		// Forward passes after this one depth test against the deferred geometry.
+		glDepthFunc(GL_ALWAYS);
+		glBindVertexArray(emptyVAO);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glBindVertexArray(0);
+		glDepthFunc(GL_LESS);
+
+		if (blendEnabled) {
+			glEnable(GL_BLEND);
+		}
+	}
+
+	void Release() {
+		releaseTargets();
+		volumeStream.Release();
+		if (emptyVAO != 0) {
+			glDeleteVertexArrays(1, &emptyVAO);
+			emptyVAO = 0;
+		}
+		if (volumeVAO != 0) {
+			glDeleteVertexArrays(1, &volumeVAO);
+			glDeleteBuffers(1, &volumeVBO);
+			glDeleteBuffers(1, &volumeEBO);
+			volumeVAO = 0;
+		}
+	}
+
+private:
+	unsigned int width;
+	unsigned int height;
+	unsigned int gBuffer;
+	unsigned int gTextures[3];
+	unsigned int lightBuffer;
+	unsigned int lightTexture;
+	unsigned int lightDepth;
+	bool blendEnabled;
+	bool srgbEnabled;
+	GLint output;
+
+	unsigned int emptyVAO;
+	unsigned int volumeVAO;
+	unsigned int volumeVBO;
+	unsigned int volumeEBO;
+	unsigned int volumeIndexCount;
+
+	Shader* screenShader;
+	Shader* volumeShader;
+	Shader* compositeShader;
+
+	std::vector<LightVolume> volumes;
+	std::vector<Light> screenLights;
+	StreamBuffer volumeStream;
+	size_t volumeOffset;
+
+	void createTexture(unsigned int texture, GLint internalFormat, GLenum format, GLenum type) {
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	void bindGBuffer() {
+		for (unsigned int i = 0; i < 3; i++) {
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, gTextures[i]);
+		}
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	void setCommonUniforms(Shader& shader, const glm::mat4& inverseViewProjection, glm::vec3 viewPosition) {
+		shader.setInt("gAlbedoSpecular", 0);
+		shader.setInt("gNormalMaterial", 1);
+		shader.setInt("gDepth", 2);
+		shader.setMat4("inverseViewProjection", inverseViewProjection);
+		shader.setVec2("screenSize", glm::vec2((float)width, (float)height));
+		shader.setVec3("viewPos", viewPosition);
+	}
+
+	void setLight(Shader& shader, unsigned int i, const Light& light) {
+		std::string name = "lights[" + std::to_string(i) + "].";
+		shader.setVec3(name + "position", light.Position);
+		shader.setVec3(name + "direction", light.Direction);
+		shader.setVec3(name + "ambient", light.Ambient);
+		shader.setVec3(name + "diffuse", light.Diffuse);
+		shader.setVec3(name + "specular", light.Specular);
+		shader.setFloat(name + "constant", light.Constant);
+		shader.setFloat(name + "linear", light.Linear);
+		shader.setFloat(name + "quadratic", light.Quadratic);
+		shader.setFloat(name + "cutoff", glm::cos(glm::radians(light.Cutoff)));
+		shader.setFloat(name + "outerCutoff", glm::cos(glm::radians(light.OuterCutoff)));
+		shader.setInt(name + "caster", light.Caster);
+		shader.setInt(name + "shadow", light.ShadowSlot);
+	}
+
+	bool uploadVolumes() {
+		size_t size = volumes.size() * sizeof(LightVolume);
+		if (size > volumeStream.GetFrameSize()) {
+			volumeStream.Reserve(size * 2);
+		}
+		volumeStream.BeginFrame();
+		void* data = volumeStream.Map(size, sizeof(LightVolume), &volumeOffset);
+		if (data == nullptr) {
+			volumeStream.EndFrame();
+			return false;
+		}
+		std::memcpy(data, volumes.data(), size);
+		volumeStream.Unmap();
+		return true;
+	}
+
+	void bindVolumes() {
+		// The VAO must be bound.
+		glBindBuffer(GL_ARRAY_BUFFER, volumeStream.GetBuffer());
+		for (unsigned int i = 0; i < VOLUME_INSTANCE_ATTRIBUTES; i++) {
+			glVertexAttribPointer(VOLUME_INSTANCE_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(LightVolume), (void*)(volumeOffset + i * sizeof(glm::vec4)));
+		}
+	}
+
+	void releaseTargets() {
+		if (gBuffer != 0) {
+			glDeleteFramebuffers(1, &gBuffer);
+			glDeleteTextures(3, gTextures);
+			glDeleteFramebuffers(1, &lightBuffer);
+			glDeleteTextures(1, &lightTexture);
+			glDeleteRenderbuffers(1, &lightDepth);
+			gBuffer = 0;
+		}
+		width = 0;
+		height = 0;
+	}
+};
+
+#endif // !DEFERRED_H
\ No newline at end of file
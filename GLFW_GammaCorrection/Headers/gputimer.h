@@ -0,0 +1,82 @@
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <glad/glad.h>
+
+// Queries in flight, results are read this many frames late at the latest.
+const unsigned int GPU_TIMER_QUERIES = 4;
+
+// GPU time of a span of commands with GL_TIME_ELAPSED queries. The results are only read once
+// the GPU has them, so timing never makes the CPU wait.
+class GpuTimer {
+public:
+	// Latest result
+	float Milliseconds;
+
+	GpuTimer() : Milliseconds(0.0f), current(0), initialized(false) {
+		for (unsigned int i = 0; i < GPU_TIMER_QUERIES; i++) {
+			queries[i] = 0;
+			pending[i] = false;
+		}
+	}
+
+	void Initialize() {
+		glGenQueries(GPU_TIMER_QUERIES, queries);
+		initialized = true;
+	}
+
+	void Begin() {
+		if (!initialized) {
+			return;
+		}
+		// The GPU is that far behind, drop the old result rather than wait for it.
+		pending[current] = false;
+		glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+	}
+
+	void End() {
+		if (!initialized) {
+			return;
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+		pending[current] = true;
+		current = (current + 1) % GPU_TIMER_QUERIES;
+	}
+
+	// Read the finished queries, oldest first. Returns true if a new result came in.
+	bool Poll() {
+		bool result = false;
+		for (unsigned int i = 0; i < GPU_TIMER_QUERIES; i++) {
+			unsigned int index = (current + i) % GPU_TIMER_QUERIES;
+			if (!pending[index]) {
+				continue;
+			}
+			GLint available = 0;
+			glGetQueryObjectiv(queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				break;
+			}
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(queries[index], GL_QUERY_RESULT, &elapsed);
+			Milliseconds = (float)(elapsed / 1.0e6);
+			pending[index] = false;
+			result = true;
+		}
+		return result;
+	}
+
+	void Release() {
+		if (initialized) {
+			glDeleteQueries(GPU_TIMER_QUERIES, queries);
+			initialized = false;
+		}
+	}
+
+private:
+	unsigned int queries[GPU_TIMER_QUERIES];
+	bool pending[GPU_TIMER_QUERIES];
+	unsigned int current;
+	bool initialized;
+};
+
+#endif // !GPUTIMER_H
\ No newline at end of file
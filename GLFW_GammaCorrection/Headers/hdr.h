@@ -0,0 +1,341 @@
+#ifndef HDR_H
+#define HDR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "bloom.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Samples of the HDR target, the scene was drawn with multisampling into the window before
+const unsigned int HDR_SAMPLES = 4;
+
+// Edge of the log luminance texture, a power of two so its last mip level is one texel
+const unsigned int LUMINANCE_SIZE = 256;
+
+// Readbacks in flight, the measured luminance is at most this many frames old
+const unsigned int EXPOSURE_READBACKS = 4;
+
+// Middle grey the average luminance is exposed to
+const float EXPOSURE_KEY = 0.18f;
+
+// High dynamic range rendering. The scene is drawn between Begin() and End() into a multisampled
+// R11G11B10F target, resolved, and tone mapped into the window by End() (see Shaders/tonemap.fs).
+// With AutoExposure the exposure follows the average log luminance of the frame: a full screen pass
+// writes log(luminance) into a LUMINANCE_SIZE square R16F texture, glGenerateMipmap reduces it, and
+// the last level is copied into a pixel pack buffer. That copy is only mapped once its fence has
+// passed, several frames later, so the CPU never waits for the GPU to read the exposure back.
+// With a Bloom set, the resolved scene is blurred down its chain and mixed in before the tone map.
+class HdrRenderer {
+public:
+	bool AutoExposure;
+	// Exposure in stops, added to the automatic exposure or the only one without it
+	float ExposureBias;
+	// How fast the eye adapts, 1 / seconds
+	float AdaptationSpeed;
+
+	// Exposure used by the last End(), the last luminance read back and how old it was in frames
+	float Exposure;
+	float AverageLuminance;
+	unsigned int ReadbackLatency;
+
+	HdrRenderer() : AutoExposure(true), ExposureBias(0.0f), AdaptationSpeed(1.5f), Exposure(1.0f), AverageLuminance(EXPOSURE_KEY), ReadbackLatency(0), width(0), height(0), sceneFBO(0), sceneColor(0), sceneDepth(0), resolveFBO(0), resolveTexture(0), luminanceFBO(0), luminanceTexture(0), emptyVAO(0), luminanceShader(nullptr), tonemapShader(nullptr), bloom(nullptr), bloomBenchmark(nullptr), frame(0), current(0), depthTestEnabled(false), blendEnabled(false) {
+		for (unsigned int i = 0; i < EXPOSURE_READBACKS; i++) {
+			readbacks[i] = 0;
+			fences[i] = 0;
+			readbackFrames[i] = 0;
+		}
+	}
+
+	// luminanceShader: Shaders/fullscreen.vs + luminance.fs, tonemapShader: fullscreen.vs + tonemap.fs
+	void Initialize(unsigned int width, unsigned int height, Shader* luminanceShader, Shader* tonemapShader) {
+		this->luminanceShader = luminanceShader;
+		this->tonemapShader = tonemapShader;
+
+		// Full screen passes draw one triangle from gl_VertexID, but a VAO must be bound.
+		glGenVertexArrays(1, &emptyVAO);
+
+		glGenTextures(1, &luminanceTexture);
+		glBindTexture(GL_TEXTURE_2D, luminanceTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, LUMINANCE_SIZE, LUMINANCE_SIZE, 0, GL_RED, GL_FLOAT, NULL);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glGenFramebuffers(1, &luminanceFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, luminanceFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, luminanceTexture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::HDR::Luminance framebuffer is not complete!" << std::endl;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		glGenBuffers(EXPOSURE_READBACKS, readbacks);
+		for (unsigned int i = 0; i < EXPOSURE_READBACKS; i++) {
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readbacks[i]);
+			glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(float), NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		Resize(width, height);
+	}
+
+	void Resize(unsigned int width, unsigned int height) {
+		if (width == 0 || height == 0 || (width == this->width && height == this->height)) {
+			return;
+		}
+		releaseTargets();
+		this->width = width;
+		this->height = height;
+
+		glGenFramebuffers(1, &sceneFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+		glGenRenderbuffers(1, &sceneColor);
+		glBindRenderbuffer(GL_RENDERBUFFER, sceneColor);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, HDR_SAMPLES, GL_R11F_G11F_B10F, width, height);
+		glGenRenderbuffers(1, &sceneDepth);
+		glBindRenderbuffer(GL_RENDERBUFFER, sceneDepth);
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, HDR_SAMPLES, GL_DEPTH24_STENCIL8, width, height);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, sceneColor);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, sceneDepth);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::HDR::Scene framebuffer is not complete!" << std::endl;
+		}
+
+		glGenFramebuffers(1, &resolveFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, resolveFBO);
+		glGenTextures(1, &resolveTexture);
+		glBindTexture(GL_TEXTURE_2D, resolveTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R11F_G11F_B10F, width, height, 0, GL_RGB, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, resolveTexture, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::HDR::Resolve framebuffer is not complete!" << std::endl;
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Bloom of the scene and a benchmark running on it, either may be nullptr.
+	void SetBloom(Bloom* bloom, BloomBenchmark* bloomBenchmark) {
+		this->bloom = bloom;
+		this->bloomBenchmark = bloomBenchmark;
+	}
+
+	// Bind and clear the HDR target, the scene is drawn into it until End().
+	void Begin(glm::vec4 clearColor) {
+		glBindFramebuffer(GL_FRAMEBUFFER, sceneFBO);
+		glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	}
+
+	// Resolve the scene, measure it and tone map it into the window. The tone map shader must
+	// already have its other uniforms.
+	void End(float deltaTime) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, resolveFBO);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+
+		depthTestEnabled = glIsEnabled(GL_DEPTH_TEST);
+		blendEnabled = glIsEnabled(GL_BLEND);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+		glBindVertexArray(emptyVAO);
+
+		frame++;
+		if (AutoExposure) {
+			measure();
+		}
+		poll();
+		adapt(deltaTime);
+
+		unsigned int bloomTexture = 0;
+		if (bloom != nullptr || bloomBenchmark != nullptr) {
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			if (bloom != nullptr && bloom->Enabled) {
+				bloomTexture = bloom->Render(resolveTexture);
+			}
+			if (bloom != nullptr && bloomBenchmark != nullptr) {
+				bloomBenchmark->Run(*bloom, resolveTexture, width, height);
+			}
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			glBindVertexArray(emptyVAO);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, bloomTexture);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, resolveTexture);
+		tonemapShader->use();
+		tonemapShader->setInt("hdrScene", 0);
+		tonemapShader->setFloat("exposure", Exposure);
+		tonemapShader->setBool("useBloom", bloomTexture != 0);
+		tonemapShader->setInt("bloom", 1);
+		if (bloomTexture != 0) {
+			tonemapShader->setFloat("bloomStrength", bloom->Strength);
+			tonemapShader->setFloat("bloomMips", (float)bloom->GetMipCount());
+		}
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
+
+		glBindVertexArray(0);
+		if (depthTestEnabled) {
+			glEnable(GL_DEPTH_TEST);
+		}
+		if (blendEnabled) {
+			glEnable(GL_BLEND);
+		}
+	}
+
+	void Release() {
+		releaseTargets();
+		for (unsigned int i = 0; i < EXPOSURE_READBACKS; i++) {
+			if (fences[i] != 0) {
+				glDeleteSync(fences[i]);
+				fences[i] = 0;
+			}
+		}
+		if (readbacks[0] != 0) {
+			glDeleteBuffers(EXPOSURE_READBACKS, readbacks);
+		}
+		for (unsigned int i = 0; i < EXPOSURE_READBACKS; i++) {
+			readbacks[i] = 0;
+		}
+		glDeleteFramebuffers(1, &luminanceFBO);
+		glDeleteTextures(1, &luminanceTexture);
+		glDeleteVertexArrays(1, &emptyVAO);
+		luminanceFBO = 0;
+		luminanceTexture = 0;
+		emptyVAO = 0;
+	}
+
+private:
+	unsigned int width;
+	unsigned int height;
+	unsigned int sceneFBO;
+	unsigned int sceneColor;
+	unsigned int sceneDepth;
+	unsigned int resolveFBO;
+	unsigned int resolveTexture;
+	unsigned int luminanceFBO;
+	unsigned int luminanceTexture;
+	unsigned int emptyVAO;
+
+	Shader* luminanceShader;
+	Shader* tonemapShader;
+	Bloom* bloom;
+	BloomBenchmark* bloomBenchmark;
+
+	unsigned int readbacks[EXPOSURE_READBACKS];
+	GLsync fences[EXPOSURE_READBACKS];
+	unsigned int readbackFrames[EXPOSURE_READBACKS];
+	unsigned int frame;
+	unsigned int current;
+	bool depthTestEnabled;
+	bool blendEnabled;
+
+	// Reduce the log luminance of the resolved scene and start copying the result back.
+	void measure() {
+		// Every slot is still in flight, skip this frame rather than wait.
+		if (fences[current] != 0) {
+			return;
+		}
+
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glBindFramebuffer(GL_FRAMEBUFFER, luminanceFBO);
+		glViewport(0, 0, LUMINANCE_SIZE, LUMINANCE_SIZE);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, resolveTexture);
+		luminanceShader->use();
+		luminanceShader->setInt("hdrScene", 0);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+		glBindTexture(GL_TEXTURE_2D, luminanceTexture);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		int lastLevel = 0;
+		for (unsigned int size = LUMINANCE_SIZE; size > 1; size /= 2) {
+			lastLevel++;
+		}
+
+		// Into the buffer, not client memory, so the call returns right away.
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readbacks[current]);
+		glGetTexImage(GL_TEXTURE_2D, lastLevel, GL_RED, GL_FLOAT, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		fences[current] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		readbackFrames[current] = frame;
+		current = (current + 1) % EXPOSURE_READBACKS;
+	}
+
+	// Read the copies that have arrived, oldest first.
+	void poll() {
+		for (unsigned int i = 0; i < EXPOSURE_READBACKS; i++) {
+			unsigned int index = (current + i) % EXPOSURE_READBACKS;
+			if (fences[index] == 0) {
+				continue;
+			}
+			if (glClientWaitSync(fences[index], 0, 0) == GL_TIMEOUT_EXPIRED) {
+				break;
+			}
+			glDeleteSync(fences[index]);
+			fences[index] = 0;
+
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readbacks[index]);
+			float* logLuminance = (float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(float), GL_MAP_READ_BIT);
+			if (logLuminance != nullptr) {
+				AverageLuminance = std::exp(*logLuminance);
+				ReadbackLatency = frame - readbackFrames[index];
+				glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			}
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		}
+	}
+
+	void adapt(float deltaTime) {
+		float bias = std::pow(2.0f, ExposureBias);
+		if (!AutoExposure) {
+			Exposure = bias;
+			return;
+		}
+		float target = glm::clamp(EXPOSURE_KEY / std::max(AverageLuminance, 1e-4f), 1.0f / 64.0f, 64.0f) * bias;
+		// Frame rate independent, the same adaptation per second at any frame time
+		float blend = 1.0f - std::exp(-deltaTime * AdaptationSpeed);
+		Exposure += (target - Exposure) * blend;
+	}
+
+	void releaseTargets() {
+		if (sceneFBO != 0) {
+			glDeleteFramebuffers(1, &sceneFBO);
+			glDeleteRenderbuffers(1, &sceneColor);
+			glDeleteRenderbuffers(1, &sceneDepth);
+			glDeleteFramebuffers(1, &resolveFBO);
+			glDeleteTextures(1, &resolveTexture);
+		}
+		sceneFBO = 0;
+		sceneColor = 0;
+		sceneDepth = 0;
+		resolveFBO = 0;
+		resolveTexture = 0;
+		width = 0;
+		height = 0;
+	}
+};
+
+#endif // !HDR_H
\ No newline at end of file
@@ -0,0 +1,139 @@
+#ifndef KERNELCOMPARISON_H
+#define KERNELCOMPARISON_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+enum Comparison_Step {
+	CAPTURE_REFERENCE,
+	CAPTURE_TYPED,
+	TIME_REFERENCE,
+	TIME_TYPED,
+	COMPARISON_DONE
+};
+
+// Checks the per-type lighting loops of Shaders/gamma.fs against the reference kernel, the single
+// loop that branches on the caster. One frame is rendered with each kernel and read back, the two
+// images must match, then the GPU times of both kernels are averaged like LightBenchmark does. The
+// view must stay still while it runs.
+class KernelComparison {
+public:
+	bool Running;
+	bool HasResult;
+
+	// Largest difference of a channel (0 to 255) and the pixels that differ at all
+	unsigned int MaxDifference;
+	unsigned int DifferentPixels;
+	unsigned int Pixels;
+	float ReferenceMs;
+	float TypedMs;
+
+	KernelComparison(unsigned int warmupFrames = 30, unsigned int sampleFrames = 120) : Running(false), HasResult(false), MaxDifference(0), DifferentPixels(0), Pixels(0), ReferenceMs(0.0f), TypedMs(0.0f), warmupFrames(warmupFrames), sampleFrames(sampleFrames), step(COMPARISON_DONE), frames(0), total(0.0f) {
+
+	}
+
+	void Start() {
+		Running = true;
+		HasResult = false;
+		step = CAPTURE_REFERENCE;
+		frames = 0;
+		total = 0.0f;
+	}
+
+	// Kernel to render this frame with
+	bool UseReference() const {
+		return step == CAPTURE_REFERENCE || step == TIME_REFERENCE;
+	}
+
+	float GetProgress() const {
+		return (float)step / COMPARISON_DONE;
+	}
+
+	// Read back the frame just drawn while capturing, before anything else is drawn over it.
+	void Capture(unsigned int width, unsigned int height) {
+		if (!Running || (step != CAPTURE_REFERENCE && step != CAPTURE_TYPED)) {
+			return;
+		}
+		std::vector<unsigned char>& image = step == CAPTURE_REFERENCE ? reference : typed;
+		image.resize(width * height * 4);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+
+		if (step == CAPTURE_TYPED) {
+			diff();
+		}
+		step = (Comparison_Step)(step + 1);
+	}
+
+	// Feed every GPU time that comes in while running.
+	void AddSample(float milliseconds) {
+		if (!Running || (step != TIME_REFERENCE && step != TIME_TYPED)) {
+			return;
+		}
+		frames++;
+		if (frames <= warmupFrames) {
+			return;
+		}
+		total += milliseconds;
+		if (frames < warmupFrames + sampleFrames) {
+			return;
+		}
+
+		if (step == TIME_REFERENCE) {
+			ReferenceMs = total / sampleFrames;
+		} else {
+			TypedMs = total / sampleFrames;
+		}
+		step = (Comparison_Step)(step + 1);
+		frames = 0;
+		total = 0.0f;
+
+		if (step == COMPARISON_DONE) {
+			Running = false;
+			HasResult = true;
+			Print();
+		}
+	}
+
+	void Print() const {
+		std::cout << "Image difference: " << MaxDifference << " at most, " << DifferentPixels << " of " << Pixels << " pixels" << std::endl;
+		std::cout << "Reference kernel: " << ReferenceMs << " ms, per-type kernels: " << TypedMs << " ms" << std::endl;
+	}
+
+private:
+	std::vector<unsigned char> reference;
+	std::vector<unsigned char> typed;
+	unsigned int warmupFrames;
+	unsigned int sampleFrames;
+	Comparison_Step step;
+	unsigned int frames;
+	float total;
+
+	void diff() {
+		MaxDifference = 0;
+		DifferentPixels = 0;
+		// The window may have been resized in between, then every pixel counts as different.
+		if (reference.size() != typed.size()) {
+			Pixels = typed.size() / 4;
+			DifferentPixels = Pixels;
+			MaxDifference = 255;
+			return;
+		}
+		Pixels = typed.size() / 4;
+		for (size_t i = 0; i < typed.size(); i += 4) {
+			unsigned int difference = 0;
+			for (size_t c = 0; c < 4; c++) {
+				difference = std::max(difference, (unsigned int)std::abs((int)reference[i + c] - (int)typed[i + c]));
+			}
+			if (difference > 0) {
+				DifferentPixels++;
+			}
+			MaxDifference = std::max(MaxDifference, difference);
+		}
+	}
+};
+
+#endif // !KERNELCOMPARISON_H
\ No newline at end of file
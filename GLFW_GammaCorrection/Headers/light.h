@@ -6,6 +6,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 enum Light_Caster {
 	DIRECTION,
@@ -24,6 +26,9 @@ const float CUTOFF = 12.0f;
 const float OUTERCUTOFF = 15.0f;
 const float EXPONENT = 128.0f;
 
+// Light below this (in 0-1 color) counts as nothing, this decides the range of a light.
+const float LIGHT_THRESHOLD = 5.0f / 256.0f;
+
 class Light
 {
 public:
@@ -45,27 +50,47 @@ public:
 	bool Enable;
 	unsigned int Caster;
 
+	// Slot in the point shadow atlas, -1 if it has none this frame (see PointShadows)
+	int ShadowSlot;
+
 	// Direction Light
-	Light(glm::vec4 direction = glm::vec4(0.0f, 0.1f, 0.1f, 0.0f), bool enable = true) : Ambient(AMBIENT), Diffuse(DIFFUSE), Specular(SPECULAR), Constant(1.0f), Linear(0.0f), Quadratic(0.0f), Cutoff(0.0f), OuterCutoff(0.0f), Exponent(0.0f) {
+	Light(glm::vec4 direction = glm::vec4(0.0f, 0.1f, 0.1f, 0.0f), bool enable = true) : Ambient(AMBIENT), Diffuse(DIFFUSE), Specular(SPECULAR), Constant(1.0f), Linear(0.0f), Quadratic(0.0f), Cutoff(0.0f), OuterCutoff(0.0f), Exponent(0.0f), ShadowSlot(-1) {
 		Caster = Light_Caster::DIRECTION;
 		Direction = glm::vec3(direction.x, direction.y, direction.z);
 		Enable = enable;
 	}
 
 	// Point Light
-	Light(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), bool enable = true) : Ambient(AMBIENT), Diffuse(DIFFUSE), Specular(SPECULAR), Constant(1.0f), Linear(LINEAR), Quadratic(QUADRATIC), Cutoff(0.0f), OuterCutoff(0.0f), Exponent(0.0f) {
+	Light(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), bool enable = true) : Ambient(AMBIENT), Diffuse(DIFFUSE), Specular(SPECULAR), Constant(1.0f), Linear(LINEAR), Quadratic(QUADRATIC), Cutoff(0.0f), OuterCutoff(0.0f), Exponent(0.0f), ShadowSlot(-1) {
 		Caster = Light_Caster::POINT;
 		Position = position;
 		Enable = enable;
 	}
 
 	// Spot Light
-	Light(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f), bool enable = true) : Ambient(AMBIENT), Diffuse(DIFFUSE), Specular(SPECULAR), Constant(1.0f), Linear(LINEAR), Quadratic(QUADRATIC), Cutoff(CUTOFF), OuterCutoff(OUTERCUTOFF), Exponent(EXPONENT) {
+	Light(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f), bool enable = true) : Ambient(AMBIENT), Diffuse(DIFFUSE), Specular(SPECULAR), Constant(1.0f), Linear(LINEAR), Quadratic(QUADRATIC), Cutoff(CUTOFF), OuterCutoff(OUTERCUTOFF), Exponent(EXPONENT), ShadowSlot(-1) {
 		Caster = Light_Caster::SPOT;
 		Position = position;
 		Direction = direction;
 		Enable = enable;
 	}
+
+	// Distance at which the attenuated light drops below threshold, infinite for a direction light.
+	float GetRadius(float threshold = LIGHT_THRESHOLD) const {
+		float brightest = std::max(std::max(Ambient.x + Diffuse.x + Specular.x, Ambient.y + Diffuse.y + Specular.y), Ambient.z + Diffuse.z + Specular.z);
+		// Solve constant + linear * d + quadratic * d^2 = brightest / threshold
+		float c = Constant - brightest / threshold;
+		if (c >= 0.0f) {
+			return 0.0f;
+		}
+		if (Quadratic > 0.0f) {
+			return (-Linear + std::sqrt(Linear * Linear - 4.0f * Quadratic * c)) / (2.0f * Quadratic);
+		}
+		if (Linear > 0.0f) {
+			return -c / Linear;
+		}
+		return INFINITY;
+	}
 private:
 };
 
@@ -0,0 +1,100 @@
+#ifndef LIGHTBENCHMARK_H
+#define LIGHTBENCHMARK_H
+
+#include <iostream>
+#include <vector>
+
+struct BenchmarkResult {
+	unsigned int Lights;
+	float ForwardMs;
+	float DeferredMs;
+};
+
+// Steps through light counts and renders each with clustered forward and with deferred shading,
+// averaging the GPU frame times. Every step first lets warmupFrames results pass, which covers the
+// frames still in flight with the settings of the step before.
+class LightBenchmark {
+public:
+	std::vector<BenchmarkResult> Results;
+	bool Running;
+
+	LightBenchmark(unsigned int warmupFrames = 30, unsigned int sampleFrames = 60) : Running(false), warmupFrames(warmupFrames), sampleFrames(sampleFrames), step(0), frames(0), total(0.0f) {
+
+	}
+
+	void Start(const std::vector<unsigned int>& lightCounts) {
+		counts = lightCounts;
+		Results.clear();
+		for (unsigned int i = 0; i < counts.size(); i++) {
+			BenchmarkResult result;
+			result.Lights = counts[i];
+			result.ForwardMs = 0.0f;
+			result.DeferredMs = 0.0f;
+			Results.push_back(result);
+		}
+		step = 0;
+		frames = 0;
+		total = 0.0f;
+		Running = !counts.empty();
+	}
+
+	// Settings to render with while running
+	unsigned int GetLightCount() const {
+		return counts[step / 2];
+	}
+
+	bool IsDeferred() const {
+		return step % 2 == 1;
+	}
+
+	float GetProgress() const {
+		return counts.empty() ? 1.0f : (float)step / (counts.size() * 2);
+	}
+
+	// Feed every GPU time that comes in while running.
+	void AddSample(float milliseconds) {
+		if (!Running) {
+			return;
+		}
+		frames++;
+		if (frames <= warmupFrames) {
+			return;
+		}
+		total += milliseconds;
+		if (frames < warmupFrames + sampleFrames) {
+			return;
+		}
+
+		float average = total / sampleFrames;
+		if (IsDeferred()) {
+			Results[step / 2].DeferredMs = average;
+		} else {
+			Results[step / 2].ForwardMs = average;
+		}
+		step++;
+		frames = 0;
+		total = 0.0f;
+
+		if (step == counts.size() * 2) {
+			Running = false;
+			Print();
+		}
+	}
+
+	void Print() const {
+		std::cout << "Lights\tForward (ms)\tDeferred (ms)" << std::endl;
+		for (unsigned int i = 0; i < Results.size(); i++) {
+			std::cout << Results[i].Lights << "\t" << Results[i].ForwardMs << "\t" << Results[i].DeferredMs << std::endl;
+		}
+	}
+
+private:
+	std::vector<unsigned int> counts;
+	unsigned int warmupFrames;
+	unsigned int sampleFrames;
+	unsigned int step;
+	unsigned int frames;
+	float total;
+};
+
+#endif // !LIGHTBENCHMARK_H
\ No newline at end of file
@@ -0,0 +1,240 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "texturearray.h"
+
+#include <string>
+#include <vector>
+
+const glm::vec4 MATERIAL_AMBIENT = glm::vec4(0.1f, 0.1f, 0.1f, 1.0f);
+const glm::vec4 MATERIAL_DIFFUSE = glm::vec4(0.7f, 0.7f, 0.7f, 1.0f);
+const glm::vec4 MATERIAL_SPECULAR = glm::vec4(0.4f, 0.4f, 0.4f, 1.0f);
+const float MATERIAL_SHININESS = 64.0f;
+
+// Texture units of the imported model textures: texture_diffuseN uses DIFFUSE_UNIT + N - 1, and so on.
+const int DIFFUSE_UNIT = 0;
+const int SPECULAR_UNIT = 4;
+const int NORMAL_UNIT = 8;
+const int HEIGHT_UNIT = 12;
+const int MAX_UNITS_PER_TYPE = 4;
+
+struct Texture {
+	unsigned int id;
+	std::string type;
+	std::string path;
+};
+
+// A texture resolved at import time: which target, sampler uniform and unit it goes to.
+struct MaterialSlot {
+	unsigned int Texture;
+	GLenum Target;
+	int Unit;
+	std::string Uniform;
+};
+
+class Material {
+public:
+	// Compact id, used by the render queue as part of the sort key.
+	unsigned int ID;
+
+	unsigned int DiffuseTexture;
+	unsigned int SpecularTexture;
+	unsigned int EmissionTexture;
+
+	// Textures living in texture arrays, selected per instance by layer index
+	TextureLayer DiffuseLayer;
+	TextureLayer SpecularLayer;
+	bool UseTextureArray;
+
+	glm::vec4 Ambient;
+	glm::vec4 Diffuse;
+	glm::vec4 Specular;
+	float Shininess;
+
+	bool EnableColorTexture;
+	bool EnableSpecularTexture;
+	bool EnableEmission;
+	bool EnableEmissionTexture;
+
+	// The diffuse color comes from each draw instead of the material (e.g. light balls).
+	bool PerDrawColor;
+	bool Translucent;
+
+	std::vector<MaterialSlot> Slots;
+
+	Material(unsigned int diffuseTexture = 0, unsigned int specularTexture = 0, unsigned int emissionTexture = 0) : UseTextureArray(false), Ambient(MATERIAL_AMBIENT), Diffuse(MATERIAL_DIFFUSE), Specular(MATERIAL_SPECULAR), Shininess(MATERIAL_SHININESS), EnableEmission(false), PerDrawColor(false), Translucent(false) {
+		ID = nextID();
+		DiffuseTexture = diffuseTexture;
+		SpecularTexture = specularTexture;
+		EmissionTexture = emissionTexture;
+		EnableColorTexture = (diffuseTexture != 0);
+		EnableSpecularTexture = (specularTexture != 0);
+		EnableEmissionTexture = (emissionTexture != 0);
+
+		addSlot(DiffuseTexture, GL_TEXTURE_2D, 0, "material.diffuse_texture");
+		addSlot(SpecularTexture, GL_TEXTURE_2D, 1, "material.specular_texture");
+		addSlot(EmissionTexture, GL_TEXTURE_2D, 2, "material.emission_texture");
+	}
+
+	Material(TextureLayer diffuseLayer, TextureLayer specularLayer = TextureLayer()) : DiffuseTexture(0), SpecularTexture(0), EmissionTexture(0), UseTextureArray(true), Ambient(MATERIAL_AMBIENT), Diffuse(MATERIAL_DIFFUSE), Specular(MATERIAL_SPECULAR), Shininess(MATERIAL_SHININESS), EnableEmission(false), EnableEmissionTexture(false), PerDrawColor(false), Translucent(false) {
+		ID = nextID();
+		DiffuseLayer = diffuseLayer;
+		SpecularLayer = specularLayer;
+		EnableColorTexture = (diffuseLayer.Array != 0);
+		EnableSpecularTexture = (specularLayer.Array != 0);
+
+		addSlot(DiffuseLayer.Array, GL_TEXTURE_2D_ARRAY, 3, "material.diffuse_array");
+		addSlot(SpecularLayer.Array, GL_TEXTURE_2D_ARRAY, 4, "material.specular_array");
+	}
+
+	// Material of an imported mesh, the samplers are named texture_diffuse1, texture_specular1, ...
+	Material(const std::vector<Texture>& textures) : DiffuseTexture(0), SpecularTexture(0), EmissionTexture(0), UseTextureArray(false), Ambient(MATERIAL_AMBIENT), Diffuse(MATERIAL_DIFFUSE), Specular(MATERIAL_SPECULAR), Shininess(MATERIAL_SHININESS), EnableColorTexture(false), EnableSpecularTexture(false), EnableEmission(false), EnableEmissionTexture(false), PerDrawColor(false), Translucent(false) {
+		ID = nextID();
+
+		int diffuseNr = 0;
+		int specularNr = 0;
+		int normalNr = 0;
+		int heightNr = 0;
+		for (unsigned int i = 0; i < textures.size(); i++) {
+			const std::string& name = textures[i].type;
+			int unit = -1;
+			int number = 0;
+			if (name == "texture_diffuse" && diffuseNr < MAX_UNITS_PER_TYPE) {
+				number = ++diffuseNr;
+				unit = DIFFUSE_UNIT + number - 1;
+				EnableColorTexture = true;
+			} else if (name == "texture_specular" && specularNr < MAX_UNITS_PER_TYPE) {
+				number = ++specularNr;
+				unit = SPECULAR_UNIT + number - 1;
+				EnableSpecularTexture = true;
+			} else if (name == "texture_normal" && normalNr < MAX_UNITS_PER_TYPE) {
+				number = ++normalNr;
+				unit = NORMAL_UNIT + number - 1;
+			} else if (name == "texture_height" && heightNr < MAX_UNITS_PER_TYPE) {
+				number = ++heightNr;
+				unit = HEIGHT_UNIT + number - 1;
+			}
+
+			if (unit >= 0) {
+				addSlot(textures[i].id, GL_TEXTURE_2D, unit, name + std::to_string(number));
+			}
+		}
+	}
+
+	// Id of the texture binding, materials sharing the same texture arrays get the same one.
+	unsigned int BindingID() {
+		if (UseTextureArray) {
+			return 0x800 | (DiffuseLayer.Array & 0x7FF);
+		}
+		return ID & 0x7FF;
+	}
+
+	// True if both materials can be drawn without binding anything in between.
+	bool SameBinding(const Material& other) const {
+		if (this == &other) {
+			return true;
+		}
+		if (!UseTextureArray || !other.UseTextureArray) {
+			return false;
+		}
+		return DiffuseLayer.Array == other.DiffuseLayer.Array && SpecularLayer.Array == other.SpecularLayer.Array &&
+			EnableColorTexture == other.EnableColorTexture && EnableSpecularTexture == other.EnableSpecularTexture &&
+			EnableEmission == other.EnableEmission && PerDrawColor == other.PerDrawColor && Translucent == other.Translucent &&
+			Ambient == other.Ambient && Diffuse == other.Diffuse && Specular == other.Specular && Shininess == other.Shininess;
+	}
+
+	// Bind textures and constants. Uniform locations are looked up only the first time
+	// a program is seen, which is also when the sampler units are assigned.
+	void Bind(Shader& shader) {
+		ProgramBinding& binding = getBinding(shader.ID);
+
+		glUniform1i(binding.EnableColorTexture, EnableColorTexture);
+		glUniform1i(binding.EnableSpecularTexture, EnableSpecularTexture);
+		glUniform1i(binding.EnableEmission, EnableEmission);
+		glUniform1i(binding.EnableEmissionTexture, EnableEmissionTexture);
+		glUniform1i(binding.PerDrawColor, PerDrawColor);
+		glUniform1i(binding.UseTextureArray, UseTextureArray);
+
+		glUniform4fv(binding.Ambient, 1, &Ambient[0]);
+		glUniform4fv(binding.Diffuse, 1, &Diffuse[0]);
+		glUniform4fv(binding.Specular, 1, &Specular[0]);
+		glUniform1f(binding.Shininess, Shininess);
+
+		for (unsigned int i = 0; i < Slots.size(); i++) {
+			glActiveTexture(GL_TEXTURE0 + Slots[i].Unit);
+			glBindTexture(Slots[i].Target, Slots[i].Texture);
+		}
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+private:
+	// Locations of the material uniforms in one program, -1 if the program doesn't use them
+	struct ProgramBinding {
+		unsigned int Program;
+		GLint EnableColorTexture;
+		GLint EnableSpecularTexture;
+		GLint EnableEmission;
+		GLint EnableEmissionTexture;
+		GLint PerDrawColor;
+		GLint UseTextureArray;
+		GLint Ambient;
+		GLint Diffuse;
+		GLint Specular;
+		GLint Shininess;
+	};
+
+	std::vector<ProgramBinding> bindings;
+
+	void addSlot(unsigned int texture, GLenum target, int unit, const std::string& uniform) {
+		if (texture == 0) {
+			return;
+		}
+		MaterialSlot slot;
+		slot.Texture = texture;
+		slot.Target = target;
+		slot.Unit = unit;
+		slot.Uniform = uniform;
+		Slots.push_back(slot);
+	}
+
+	// The program must be in use.
+	ProgramBinding& getBinding(unsigned int program) {
+		for (unsigned int i = 0; i < bindings.size(); i++) {
+			if (bindings[i].Program == program) {
+				return bindings[i];
+			}
+		}
+
+		ProgramBinding binding;
+		binding.Program = program;
+		binding.EnableColorTexture = glGetUniformLocation(program, "material.enableColorTexture");
+		binding.EnableSpecularTexture = glGetUniformLocation(program, "material.enableSpecularTexture");
+		binding.EnableEmission = glGetUniformLocation(program, "material.enableEmission");
+		binding.EnableEmissionTexture = glGetUniformLocation(program, "material.enableEmissionTexture");
+		binding.PerDrawColor = glGetUniformLocation(program, "material.perDrawColor");
+		binding.UseTextureArray = glGetUniformLocation(program, "material.useTextureArray");
+		binding.Ambient = glGetUniformLocation(program, "material.ambient");
+		binding.Diffuse = glGetUniformLocation(program, "material.diffuse");
+		binding.Specular = glGetUniformLocation(program, "material.specular");
+		binding.Shininess = glGetUniformLocation(program, "material.shininess");
+
+		// Units only depend on the sampler name, so every material agrees on them.
+		for (unsigned int i = 0; i < Slots.size(); i++) {
+			glUniform1i(glGetUniformLocation(program, Slots[i].Uniform.c_str()), Slots[i].Unit);
+		}
+
+		bindings.push_back(binding);
+		return bindings.back();
+	}
+
+	static unsigned int nextID() {
+		static unsigned int counter = 0;
+		return counter++;
+	}
+};
+
+#endif // !MATERIAL_H
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.h"
+#include "material.h"
+#include "frustum.h"
 
 #include <string>
 #include <vector>
@@ -20,20 +22,18 @@ struct Vertex {
 	glm::vec3 Bitangent;
 };
 
-struct Texture {
-	unsigned int id;
-	string type;
-	string path;
-};
-
 class Mesh {
 public:
 	vector<Vertex> vertices;
 	vector<unsigned int> indices;
 	vector<Texture> textures;
+	Material material;
+	AABB Bounds;
 	unsigned int VAO;
+	// Positions only, for depth-only passes
+	unsigned int DepthVAO;
 
-	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures) {
+	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures) : material(textures) {
 		this->vertices = vertices;
 		this->indices = indices;
 		this->textures = textures;
@@ -42,37 +42,23 @@ public:
 	}
 
 	void Draw(Shader &shader) {
-		unsigned int diffuseNr = 1;
-		unsigned int specularNr = 1;
-		unsigned int normalNr = 1;
-		unsigned int heightNr = 1;
-		for (unsigned int i = 0; i < textures.size(); i++) {
-			glActiveTexture(GL_TEXTURE0 + i);
-			string number;
-			string name = textures[i].type;
-			if (name == "texture_diffuse") {
-				number = std::to_string(diffuseNr++);
-			} else if (name == "texture_specular") {
-				number = std::to_string(specularNr++);
-			} else if (name == "texture_normal") {
-				number = std::to_string(normalNr++);
-			} else if (name == "texture_height") {
-				number = std::to_string(heightNr++);
-			}
-				
-			glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
-		}
-		
+		material.Bind(shader);
+
 		glBindVertexArray(VAO);
 		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
 		glBindVertexArray(0);
+	}
 
-		glActiveTexture(GL_TEXTURE0);
+	// Depth-only draw, the shader only reads the position at location 0.
+	void DrawDepth() {
+		glBindVertexArray(DepthVAO);
+		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
 	}
 
 private:
 	unsigned int VBO, EBO;
+	unsigned int depthVBO;
 
 	void setupMesh() {
 		glGenVertexArrays(1, &VAO);
@@ -98,6 +84,26 @@ private:
 		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
 		glBindVertexArray(0);
+
+		// A tightly packed copy of the positions: 12 bytes a vertex instead of the whole Vertex,
+		// sharing the index buffer.
+		vector<glm::vec3> positions(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); i++) {
+			positions[i] = vertices[i].Position;
+		}
+		glGenVertexArrays(1, &DepthVAO);
+		glGenBuffers(1, &depthVBO);
+
+		glBindVertexArray(DepthVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+		glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+		glBindVertexArray(0);
 	}
 };
 
@@ -29,6 +29,7 @@ class Model {
 public:
 	vector<Texture> textures_loaded;
 	vector<Mesh> meshes;
+	AABB Bounds;
 	string directory;
 	bool gammaCorrection;
 
@@ -42,6 +43,13 @@ public:
 		}
 	}
 
+	// Positions only, for a depth pre-pass with Shaders/depth.vs/.fs.
+	void DrawDepth() {
+		for (unsigned int i = 0; i < meshes.size(); i++) {
+			meshes[i].DrawDepth();
+		}
+	}
+
 private:
 	void loadModel(string const &path) {
 		Assimp::Importer importer;
@@ -59,6 +67,7 @@ private:
 		for (unsigned int i = 0; i < node->mNumMeshes; i++) {
 			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
 			meshes.push_back(processMesh(mesh, scene));
+			Bounds.Expand(meshes.back().Bounds);
 		}
 
 		for (unsigned int i = 0; i < node->mNumChildren; i++) {
@@ -70,6 +79,7 @@ private:
 		vector<Vertex> vertices;
 		vector<unsigned int> indices;
 		vector<Texture> textures;
+		AABB bounds;
 
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
 			Vertex vertex;
@@ -80,6 +90,7 @@ private:
 			vector.y = mesh->mVertices[i].y;
 			vector.z = mesh->mVertices[i].z;
 			vertex.Position = vector;
+			bounds.Expand(vector);
 
 			if (mesh->HasNormals()) {
 				vector.x = mesh->mNormals[i].x;
@@ -120,7 +131,8 @@ private:
 
 		// Handle textures
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+		// Only the colors are sRGB, the other maps hold linear data.
+		vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", gammaCorrection);
 		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
 		vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
@@ -132,10 +144,12 @@ private:
 		vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
 		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-		return Mesh(vertices, indices, textures);
+		Mesh result(vertices, indices, textures);
+		result.Bounds = bounds;
+		return result;
 	}
 	
-	vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) {
+	vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName, bool gamma = false) {
 		vector<Texture> textures;
 		for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
 			aiString str;
@@ -150,7 +164,7 @@ private:
 			}
 			if (!skip) {
 				Texture texture;
-				texture.id = TextureFromFile(str.C_Str(), directory);
+				texture.id = TextureFromFile(str.C_Str(), directory, gamma);
 				texture.type = typeName;
 				texture.path = str.C_Str();
 				textures.push_back(texture);
@@ -172,16 +186,21 @@ unsigned int TextureFromFile(const char* path, const string& directory, bool gam
 	unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
 	if (data) {
 		GLenum format;
+		GLenum internalFormat;
 		if (nrComponents == 1) {
 			format = GL_RED;
+			internalFormat = GL_RED;
 		} else if (nrComponents == 3) {
 			format = GL_RGB;
+			internalFormat = gamma ? GL_SRGB8 : GL_RGB;
 		} else if (nrComponents == 4) {
 			format = GL_RGBA;
+			internalFormat = gamma ? GL_SRGB8_ALPHA8 : GL_RGBA;
 		}
 
+		// With gamma the texels are sRGB, the sampler returns them linear.
 		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
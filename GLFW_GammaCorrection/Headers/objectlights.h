@@ -0,0 +1,294 @@
+#ifndef OBJECTLIGHTS_H
+#define OBJECTLIGHTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "light.h"
+#include "frustum.h"
+#include "streambuffer.h"
+#include "clusteredlights.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+// Lights one object is shaded with at most, must match Shaders/gamma.fs
+const unsigned int OBJECT_LIGHTS = 4;
+
+// Edge of the grid cells on the XZ plane the lights are sorted into
+const float OBJECT_LIGHT_CELL = 8.0f;
+
+// Lights reaching further than this many cells aren't put into the grid
+const float OBJECT_LIGHT_MAX_CELLS = 32.0f;
+
+// The clusters and the object lists are never used together, so they share the texture unit.
+const unsigned int OBJECT_LIGHTS_UNIT = CLUSTER_LIGHTS_UNIT;
+
+// Per-object light lists for forward shading without clusters. Every point light's reach is a
+// sphere of Light::GetRadius(), and each object only gets the OBJECT_LIGHTS lights whose sphere
+// touches its world bounds, the strongest first (estimated at the point of the bounds nearest to
+// the light). The lights go to one texture buffer with the texel layout of ClusteredLights, and the
+// indices of an object's lights travel as a per-instance attribute, so objects sharing a mesh are
+// still drawn as one instanced draw. To keep Select() from testing every light, the lights are put
+// into a grid of OBJECT_LIGHT_CELL cells on the XZ plane, each light into every cell its sphere
+// overlaps. Lights reaching further than OBJECT_LIGHT_MAX_CELLS cells are tested against every object.
+class ObjectLights {
+public:
+	// Statistics since the last Begin()
+	unsigned int LightCount;
+	unsigned int Objects;
+	unsigned int Assigned;
+	unsigned int Tested;
+	unsigned int Dropped;
+	float SelectTime;
+
+	ObjectLights() : LightCount(0), Objects(0), Assigned(0), Tested(0), Dropped(0), SelectTime(0.0f), lightStream(GL_TEXTURE_BUFFER), texture(0), attached(0), lightBase(0), query(0), uploaded(false) {
+
+	}
+
+	void Initialize() {
+		glGenTextures(1, &texture);
+	}
+
+	void Begin() {
+		lights.clear();
+		lightTexels.clear();
+		cells.clear();
+		unbounded.clear();
+		LightCount = 0;
+		Objects = 0;
+		Assigned = 0;
+		Tested = 0;
+		Dropped = 0;
+		SelectTime = 0.0f;
+		uploaded = false;
+	}
+
+	// Point lights only, direction and spot lights stay in the uniform array of the shader.
+	void Add(const Light& light) {
+		if (!light.Enable || light.Caster != Light_Caster::POINT) {
+			return;
+		}
+		float radius = light.GetRadius();
+		if (radius <= 0.0f) {
+			return;
+		}
+
+		Reach reach;
+		reach.Center = light.Position;
+		reach.Radius = radius;
+		reach.Brightest = std::max(std::max(light.Ambient.x + light.Diffuse.x + light.Specular.x, light.Ambient.y + light.Diffuse.y + light.Specular.y), light.Ambient.z + light.Diffuse.z + light.Specular.z);
+		reach.Constant = light.Constant;
+		reach.Linear = light.Linear;
+		reach.Quadratic = light.Quadratic;
+		lights.push_back(reach);
+
+		lightTexels.push_back(glm::vec4(light.Position, light.Linear));
+		lightTexels.push_back(glm::vec4(light.Diffuse, light.Quadratic));
+		lightTexels.push_back(glm::vec4(light.Specular, light.Constant));
+		lightTexels.push_back(glm::vec4(light.Ambient, radius));
+		lightTexels.push_back(glm::vec4((float)light.ShadowSlot, 0.0f, 0.0f, 0.0f));
+	}
+
+	// Sort the lights into the grid and upload them, call after the last Add().
+	void Upload() {
+		LightCount = lights.size();
+		for (unsigned int i = 0; i < LightCount; i++) {
+			const Reach& reach = lights[i];
+			if (reach.Radius > OBJECT_LIGHT_CELL * OBJECT_LIGHT_MAX_CELLS) {
+				unbounded.push_back(i);
+				continue;
+			}
+			int minX = cellOf(reach.Center.x - reach.Radius);
+			int maxX = cellOf(reach.Center.x + reach.Radius);
+			int minZ = cellOf(reach.Center.z - reach.Radius);
+			int maxZ = cellOf(reach.Center.z + reach.Radius);
+			for (int x = minX; x <= maxX; x++) {
+				for (int z = minZ; z <= maxZ; z++) {
+					cells.push_back(std::make_pair(cellKey(x, z), i));
+				}
+			}
+		}
+		std::sort(cells.begin(), cells.end());
+		stamps.assign(LightCount, 0);
+		query = 0;
+
+		uploaded = upload();
+	}
+
+	// Indices of the strongest lights touching the world bounds, the unused ones are -1.
+	glm::vec4 Select(const AABB& bounds) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		float indices[OBJECT_LIGHTS];
+		float scores[OBJECT_LIGHTS];
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < OBJECT_LIGHTS; i++) {
+			indices[i] = -1.0f;
+			scores[i] = 0.0f;
+		}
+
+		// A light overlapping several cells of the bounds is only tested once.
+		query++;
+		if (query == 0) {
+			std::fill(stamps.begin(), stamps.end(), 0);
+			query = 1;
+		}
+
+		auto test = [&](unsigned int i) {
+			if (stamps[i] == query) {
+				return;
+			}
+			stamps[i] = query;
+			Tested++;
+
+			const Reach& reach = lights[i];
+			glm::vec3 nearest = glm::clamp(reach.Center, bounds.Min, bounds.Max);
+			float distance = glm::length(nearest - reach.Center);
+			if (distance > reach.Radius) {
+				return;
+			}
+			float score = reach.Brightest / (reach.Constant + reach.Linear * distance + reach.Quadratic * distance * distance);
+
+			// Insert into the short list, which stays sorted by score.
+			if (count == OBJECT_LIGHTS) {
+				Dropped++;
+				if (score <= scores[OBJECT_LIGHTS - 1]) {
+					return;
+				}
+				count--;
+			}
+			unsigned int slot = count;
+			while (slot > 0 && scores[slot - 1] < score) {
+				scores[slot] = scores[slot - 1];
+				indices[slot] = indices[slot - 1];
+				slot--;
+			}
+			scores[slot] = score;
+			indices[slot] = (float)i;
+			count++;
+		};
+
+		for (unsigned int i = 0; i < unbounded.size(); i++) {
+			test(unbounded[i]);
+		}
+		int minX = cellOf(bounds.Min.x);
+		int maxX = cellOf(bounds.Max.x);
+		int minZ = cellOf(bounds.Min.z);
+		int maxZ = cellOf(bounds.Max.z);
+		for (int x = minX; x <= maxX; x++) {
+			for (int z = minZ; z <= maxZ; z++) {
+				auto first = std::lower_bound(cells.begin(), cells.end(), std::make_pair(cellKey(x, z), 0u));
+				for (auto it = first; it != cells.end() && it->first == cellKey(x, z); ++it) {
+					test(it->second);
+				}
+			}
+		}
+
+		Objects++;
+		Assigned += count;
+
+		auto stop = std::chrono::high_resolution_clock::now();
+		SelectTime += std::chrono::duration<float, std::milli>(stop - start).count();
+		return glm::vec4(indices[0], indices[1], indices[2], indices[3]);
+	}
+
+	// Bind the light buffer and set the uniforms of the shader, which must be in use.
+	// Returns false when the lights couldn't be uploaded, the shader should not use them then.
+	bool Bind(Shader& shader) {
+		if (!uploaded) {
+			return false;
+		}
+		glActiveTexture(GL_TEXTURE0 + OBJECT_LIGHTS_UNIT);
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+		if (attached != lightStream.GetBuffer()) {
+			glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, lightStream.GetBuffer());
+			attached = lightStream.GetBuffer();
+		}
+		glActiveTexture(GL_TEXTURE0);
+
+		shader.setInt("objectLights", OBJECT_LIGHTS_UNIT);
+		shader.setInt("objectLightBase", lightBase);
+		return true;
+	}
+
+	// Fence this frame's lights after the last draw using them.
+	void EndFrame() {
+		lightStream.EndFrame();
+	}
+
+	void Release() {
+		lightStream.Release();
+		if (texture != 0) {
+			glDeleteTextures(1, &texture);
+		}
+		texture = 0;
+		attached = 0;
+		uploaded = false;
+	}
+
+private:
+	struct Reach {
+		glm::vec3 Center;
+		float Radius;
+		float Brightest;
+		float Constant;
+		float Linear;
+		float Quadratic;
+	};
+
+	std::vector<Reach> lights;
+	std::vector<glm::vec4> lightTexels;
+	std::vector<std::pair<uint64_t, unsigned int>> cells;
+	std::vector<unsigned int> unbounded;
+	std::vector<unsigned int> stamps;
+
+	StreamBuffer lightStream;
+	unsigned int texture;
+	unsigned int attached;
+	int lightBase;
+	unsigned int query;
+	bool uploaded;
+
+	static int cellOf(float coordinate) {
+		return (int)std::floor(coordinate / OBJECT_LIGHT_CELL);
+	}
+
+	static uint64_t cellKey(int x, int z) {
+		return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+	}
+
+	bool upload() {
+		size_t texelSize = sizeof(glm::vec4);
+		size_t size = lightTexels.size() * texelSize;
+		// Never empty, and room to grow before the ring is recreated.
+		size_t needed = std::max(size, texelSize * 256);
+		if (needed > lightStream.GetFrameSize()) {
+			lightStream.Reserve(needed * 2);
+			// The new buffer may well get the old name, attach it again regardless.
+			attached = 0;
+		}
+
+		lightStream.BeginFrame();
+		// A zero length map is an error, map one texel when there are no lights.
+		size_t offset = 0;
+		void* pointer = lightStream.Map(std::max(size, texelSize), texelSize, &offset);
+		if (pointer == nullptr) {
+			return false;
+		}
+		if (size > 0) {
+			std::memcpy(pointer, lightTexels.data(), size);
+		}
+		lightStream.Unmap();
+		lightBase = (int)(offset / texelSize);
+		return true;
+	}
+};
+
+#endif // !OBJECTLIGHTS_H
\ No newline at end of file
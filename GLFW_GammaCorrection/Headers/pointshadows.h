@@ -0,0 +1,347 @@
+#ifndef POINTSHADOWS_H
+#define POINTSHADOWS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+#include "material.h"
+#include "frustum.h"
+#include "light.h"
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Must match POINT_SHADOW_SLOTS in Shaders/gamma.fs and Shaders/deferred_light.fs
+const unsigned int POINT_SHADOW_SLOTS = 8;
+const unsigned int POINT_SHADOW_SIZE = 512;
+// Texture unit of the atlas, after the cascaded shadow map
+const unsigned int POINT_SHADOW_UNIT = 9;
+// Most cubes drawn in one frame, each one has its own render queue.
+const unsigned int POINT_SHADOW_MAX_UPDATES = 8;
+const float POINT_SHADOW_NEAR = 0.05f;
+
+// Shadows of point lights, an atlas of POINT_SHADOW_SLOTS cubes in one depth texture array with
+// 6 layers per cube (GL 3.3 has no cube map arrays). A cube is drawn in a single pass: the geometry
+// shader (Shaders/pointshadow.gs) sends each triangle to the faces it touches through gl_Layer.
+// The stored depth is the distance to the light over its range, Light::GetRadius().
+// The slots go to the lights in view closest to the camera. The casters never move, so a cube is
+// only drawn again when its light moved, and at most Budget cubes are drawn per frame: new slots
+// first, then the lights that waited longest and are closest. A light whose new cube is still
+// waiting keeps its old one, sampled from where it was drawn; a light without a drawn cube has
+// ShadowSlot -1.
+class PointShadows {
+public:
+	bool Enabled;
+	int Budget;
+
+	// Statistics of the last Update()
+	unsigned int Candidates;
+	unsigned int Updates;
+	unsigned int Pending;
+	unsigned int DrawCalls;
+
+	PointShadows() : Enabled(true), Budget(2), Candidates(0), Updates(0), Pending(0), DrawCalls(0), atlas(0), layeredFBO(0), clearFBO(0), casterShader(nullptr), frame(0) {
+		for (unsigned int i = 0; i < POINT_SHADOW_SLOTS; i++) {
+			slots[i].Owner = nullptr;
+			slots[i].Valid = false;
+			slots[i].Position = glm::vec3(0.0f);
+			slots[i].Range = 0.0f;
+			slots[i].Frame = 0;
+		}
+	}
+
+	// The caster shader is Shaders/pointshadow.vs + .gs + .fs.
+	void Initialize(Shader* shader) {
+		casterShader = shader;
+
+		glGenTextures(1, &atlas);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, atlas);
+		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, POINT_SHADOW_SIZE, POINT_SHADOW_SIZE, POINT_SHADOW_SLOTS * 6, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		// Drawn through all layers at once, cleared one layer at a time (a layered clear would wipe every slot).
+		glGenFramebuffers(1, &layeredFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, layeredFBO);
+		glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, atlas, 0);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::SHADOWS::Point shadow framebuffer is not complete!" << std::endl;
+		}
+		glGenFramebuffers(1, &clearFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, clearFBO);
+		glDrawBuffer(GL_NONE);
+		glReadBuffer(GL_NONE);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+		for (unsigned int i = 0; i < POINT_SHADOW_MAX_UPDATES; i++) {
+			queues[i].SetDepthProgram(casterShader);
+		}
+	}
+
+	// A VAO with only the positions, drawn in place of VAO (see RenderQueue::SetDepthVAO()).
+	void SetDepthVAO(unsigned int VAO, unsigned int depthVAO) {
+		for (unsigned int i = 0; i < POINT_SHADOW_MAX_UPDATES; i++) {
+			queues[i].SetDepthVAO(VAO, depthVAO);
+		}
+	}
+
+	// Casters never move, bounds are the local bounds of the mesh.
+	void AddStatic(unsigned int VAO, unsigned int indexCount, const glm::mat4& model, const AABB& bounds) {
+		Caster caster;
+		caster.VAO = VAO;
+		caster.IndexCount = indexCount;
+		caster.Model = model;
+		caster.Bounds = bounds;
+		casters.push_back(caster);
+		for (unsigned int i = 0; i < POINT_SHADOW_SLOTS; i++) {
+			slots[i].Valid = false;
+		}
+	}
+
+	// Every light of the frame goes through Add(), Update() sets their ShadowSlot.
+	void Begin() {
+		lights.clear();
+	}
+
+	void Add(Light& light) {
+		light.ShadowSlot = -1;
+		if (light.Enable && light.Caster == Light_Caster::POINT) {
+			lights.push_back(&light);
+		}
+	}
+
+	// Hand out the slots and draw the cubes of this frame.
+	void Update(const glm::mat4& viewProjection, glm::vec3 cameraPosition) {
+		frame++;
+		Candidates = 0;
+		Updates = 0;
+		Pending = 0;
+		DrawCalls = 0;
+
+		if (!Enabled || casterShader == nullptr) {
+			for (unsigned int i = 0; i < POINT_SHADOW_SLOTS; i++) {
+				slots[i].Owner = nullptr;
+				slots[i].Valid = false;
+			}
+			return;
+		}
+
+		// Lights reaching into the view, closest first
+		viewFrustum.Update(viewProjection);
+		candidates.clear();
+		for (unsigned int i = 0; i < lights.size(); i++) {
+			float radius = lights[i]->GetRadius();
+			if (radius > 0.0f && viewFrustum.IsVisible(lights[i]->Position, radius)) {
+				candidates.push_back(std::make_pair(glm::length(lights[i]->Position - cameraPosition), i));
+			}
+		}
+		Candidates = candidates.size();
+		unsigned int count = std::min((unsigned int)candidates.size(), POINT_SHADOW_SLOTS);
+		std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+
+		// Lights that keep a slot keep the same one, the rest go to the freed slots.
+		int assigned[POINT_SHADOW_SLOTS];
+		bool kept[POINT_SHADOW_SLOTS];
+		for (unsigned int s = 0; s < POINT_SHADOW_SLOTS; s++) {
+			kept[s] = false;
+		}
+		for (unsigned int k = 0; k < count; k++) {
+			Light* light = lights[candidates[k].second];
+			assigned[k] = -1;
+			for (unsigned int s = 0; s < POINT_SHADOW_SLOTS; s++) {
+				if (slots[s].Owner == light) {
+					assigned[k] = s;
+					kept[s] = true;
+					break;
+				}
+			}
+		}
+		for (unsigned int s = 0; s < POINT_SHADOW_SLOTS; s++) {
+			if (!kept[s]) {
+				slots[s].Owner = nullptr;
+				slots[s].Valid = false;
+			}
+		}
+		for (unsigned int k = 0; k < count; k++) {
+			if (assigned[k] >= 0) {
+				continue;
+			}
+			for (unsigned int s = 0; s < POINT_SHADOW_SLOTS; s++) {
+				if (slots[s].Owner == nullptr) {
+					slots[s].Owner = lights[candidates[k].second];
+					assigned[k] = s;
+					break;
+				}
+			}
+		}
+
+		// Cubes to draw, by priority
+		requests.clear();
+		for (unsigned int k = 0; k < count; k++) {
+			Slot& slot = slots[assigned[k]];
+			float range = slot.Owner->GetRadius();
+			if (slot.Valid && slot.Position == slot.Owner->Position && slot.Range == range) {
+				continue;
+			}
+			float priority = (float)(frame - slot.Frame) / (candidates[k].first + 1.0f);
+			if (!slot.Valid) {
+				priority += 1e6f;
+			}
+			requests.push_back(std::make_pair(priority, (unsigned int)assigned[k]));
+		}
+		std::sort(requests.begin(), requests.end(), [](const std::pair<float, unsigned int>& a, const std::pair<float, unsigned int>& b) {
+			return a.first > b.first;
+		});
+		unsigned int budget = std::min((unsigned int)std::max(Budget, 0), POINT_SHADOW_MAX_UPDATES);
+		unsigned int updates = std::min((unsigned int)requests.size(), budget);
+		Pending = requests.size() - updates;
+
+		if (updates > 0) {
+			GLint viewport[4];
+			glGetIntegerv(GL_VIEWPORT, viewport);
+			glViewport(0, 0, POINT_SHADOW_SIZE, POINT_SHADOW_SIZE);
+			for (unsigned int i = 0; i < updates; i++) {
+				Slot& slot = slots[requests[i].second];
+				slot.Position = slot.Owner->Position;
+				slot.Range = slot.Owner->GetRadius();
+				slot.Frame = frame;
+				slot.Valid = true;
+				drawCube(requests[i].second, queues[i]);
+			}
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			Updates = updates;
+		}
+
+		for (unsigned int s = 0; s < POINT_SHADOW_SLOTS; s++) {
+			if (slots[s].Owner != nullptr && slots[s].Valid) {
+				slots[s].Owner->ShadowSlot = s;
+			}
+		}
+	}
+
+	// Bind the atlas and set where each cube was drawn, the shader decides with usePointShadows.
+	void Bind(Shader& shader) {
+		glActiveTexture(GL_TEXTURE0 + POINT_SHADOW_UNIT);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, atlas);
+		glActiveTexture(GL_TEXTURE0);
+
+		shader.use();
+		shader.setInt("pointShadowMap", POINT_SHADOW_UNIT);
+		for (unsigned int s = 0; s < POINT_SHADOW_SLOTS; s++) {
+			shader.setVec4("pointShadowSpheres[" + std::to_string(s) + "]", glm::vec4(slots[s].Position, slots[s].Range));
+		}
+	}
+
+	void Release() {
+		for (unsigned int i = 0; i < POINT_SHADOW_MAX_UPDATES; i++) {
+			queues[i].Release();
+		}
+		if (atlas != 0) {
+			glDeleteFramebuffers(1, &layeredFBO);
+			glDeleteFramebuffers(1, &clearFBO);
+			glDeleteTextures(1, &atlas);
+			atlas = 0;
+			layeredFBO = 0;
+			clearFBO = 0;
+		}
+		for (unsigned int i = 0; i < POINT_SHADOW_SLOTS; i++) {
+			slots[i].Owner = nullptr;
+			slots[i].Valid = false;
+		}
+	}
+
+private:
+	struct Caster {
+		unsigned int VAO;
+		unsigned int IndexCount;
+		glm::mat4 Model;
+		AABB Bounds;
+	};
+
+	// Where and for whom a cube was drawn
+	struct Slot {
+		Light* Owner;
+		bool Valid;
+		glm::vec3 Position;
+		float Range;
+		unsigned int Frame;
+	};
+
+	Slot slots[POINT_SHADOW_SLOTS];
+	RenderQueue queues[POINT_SHADOW_MAX_UPDATES];
+	unsigned int atlas;
+	unsigned int layeredFBO;
+	unsigned int clearFBO;
+	Shader* casterShader;
+	// The render queue wants a material, casters only need their depth.
+	Material casterMaterial;
+	unsigned int frame;
+
+	std::vector<Caster> casters;
+	std::vector<Light*> lights;
+	std::vector<std::pair<float, unsigned int>> candidates;
+	std::vector<std::pair<float, unsigned int>> requests;
+	Frustum viewFrustum;
+
+	void drawCube(unsigned int slot, RenderQueue& queue) {
+		glm::vec3 position = slots[slot].Position;
+		float range = slots[slot].Range;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, clearFBO);
+		for (unsigned int face = 0; face < 6; face++) {
+			glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, atlas, 0, slot * 6 + face);
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, layeredFBO);
+
+		// Casters within reach of the light, tested against the box around its sphere
+		Frustum reach;
+		reach.Update(glm::ortho(-range, range, -range, range, -range, range) * glm::translate(glm::mat4(1.0f), -position));
+		queue.Begin(position, glm::vec3(0.0f, -1.0f, 0.0f));
+		for (unsigned int i = 0; i < casters.size(); i++) {
+			queue.Submit(casters[i].VAO, casters[i].IndexCount, *casterShader, casterMaterial, casters[i].Model, casters[i].Bounds);
+		}
+		queue.Cull(reach);
+		queue.Sort();
+
+		// The faces in the order of the layers: +X, -X, +Y, -Y, +Z, -Z (see CalcPointShadow() in gamma.fs)
+		static const glm::vec3 directions[6] = {
+			glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f),
+			glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+		};
+		static const glm::vec3 ups[6] = {
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+			glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+			glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+		};
+		glm::mat4 projection = glm::perspective(glm::radians(90.0f), 1.0f, POINT_SHADOW_NEAR, range);
+
+		casterShader->use();
+		for (unsigned int face = 0; face < 6; face++) {
+			glm::mat4 view = glm::lookAt(position, position + directions[face], ups[face]);
+			casterShader->setMat4("faceMatrices[" + std::to_string(face) + "]", projection * view);
+		}
+		casterShader->setInt("firstLayer", slot * 6);
+		casterShader->setVec3("lightPosition", position);
+		casterShader->setFloat("range", range);
+		queue.FlushDepth();
+		DrawCalls += queue.DepthDrawCalls;
+	}
+};
+
+#endif // !POINTSHADOWS_H
\ No newline at end of file
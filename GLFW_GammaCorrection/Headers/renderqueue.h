@@ -0,0 +1,421 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+#include "material.h"
+#include "frustum.h"
+#include "streambuffer.h"
+#include "objectlights.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <set>
+
+// Per-instance attributes, kept clear of the Tangent/Bitangent locations used by Mesh.
+const unsigned int INSTANCE_MODEL_LOCATION = 5;
+const unsigned int INSTANCE_COLOR_LOCATION = 9;
+const unsigned int INSTANCE_LAYERS_LOCATION = 10;
+const unsigned int INSTANCE_LIGHTS_LOCATION = 11;
+const unsigned int INSTANCE_SPECULAR_LOCATION = 12;
+
+enum Render_Pass {
+	OPAQUE_PASS,
+	TRANSLUCENT_PASS
+};
+
+struct DrawPacket {
+	unsigned int VAO;
+	unsigned int IndexCount;
+	Shader* Program;
+	Material* Surface;
+	glm::mat4 Model;
+	glm::vec4 Color;
+	glm::vec4 Specular;
+	glm::vec4 Lights;
+	AABB Bounds;
+	float Depth;
+	bool Translucent;
+};
+
+struct InstanceData {
+	glm::mat4 Model;
+	glm::vec4 Color;
+	glm::vec4 Layers;
+	glm::vec4 Lights;
+	glm::vec4 Specular;
+};
+
+// Sort key layout (most significant bit first):
+//   Opaque:      pass(2) | program(8) | material(12) | mesh(10) | depth(32), front to back
+//   Translucent: pass(2) | depth(32) inverted, back to front | program(8) | material(12) | mesh(10)
+// The material field is the texture binding id, so materials sharing texture arrays end up next to each other.
+// Adjacent packets sharing program, texture binding and mesh are merged into one instanced draw, what
+// may still differ between them (model, color, specular, layers, lights) travels per instance.
+// Packets outside the view frustum are dropped by Cull(), which tests all world bounds in one batch.
+// AssignLights() gives every packet left its own short list of point lights (see ObjectLights).
+// With DepthPrepass on, the opaque packets are first drawn depth-only with the position-only VAOs
+// given to SetDepthVAO(), then shaded with GL_EQUAL so every covered pixel is shaded exactly once.
+class RenderQueue {
+public:
+	std::vector<DrawPacket> Packets;
+	bool DepthPrepass;
+
+	// Statistics of the last Flush()
+	unsigned int DrawCalls;
+	unsigned int DepthDrawCalls;
+	unsigned int Instances;
+	unsigned int ProgramChanges;
+	unsigned int MaterialChanges;
+	unsigned int MeshChanges;
+
+	RenderQueue() : DepthPrepass(false), DrawCalls(0), DepthDrawCalls(0), Instances(0), ProgramChanges(0), MaterialChanges(0), MeshChanges(0), depthProgram(nullptr), instanceStream(GL_ARRAY_BUFFER), instanceOffset(0), viewPosition(0.0f), viewDirection(0.0f, 0.0f, -1.0f) {
+
+	}
+
+	void Release() {
+		instanceStream.Release();
+		instancedVAOs.clear();
+		depthVAOs.clear();
+	}
+
+	// The shader of the depth pre-pass, it only reads the position and the instance model matrix
+	// and must compute gl_Position exactly like the shading programs (see Shaders/depth.vs).
+	void SetDepthProgram(Shader* shader) {
+		depthProgram = shader;
+	}
+
+	// A VAO with only the positions (and the same index buffer) drawn in place of VAO in the pre-pass.
+	// Packets without one are drawn with their full VAO.
+	void SetDepthVAO(unsigned int VAO, unsigned int depthVAO) {
+		depthVAOs[VAO] = depthVAO;
+	}
+
+	unsigned int GetStreamStalls() {
+		return instanceStream.Stalls;
+	}
+
+	void Begin(glm::vec3 position, glm::vec3 direction) {
+		Packets.clear();
+		keys.clear();
+		boundsCenterX.clear();
+		boundsCenterY.clear();
+		boundsCenterZ.clear();
+		boundsExtentX.clear();
+		boundsExtentY.clear();
+		boundsExtentZ.clear();
+		viewPosition = position;
+		viewDirection = glm::normalize(direction);
+	}
+
+	// bounds are the local bounds of the mesh, they are moved to world space with the model matrix.
+	// color and specular are per instance, used instead of the material's with Material::PerDrawColor.
+	void Submit(unsigned int VAO, unsigned int indexCount, Shader& shader, Material& material, glm::mat4 model, const AABB& bounds, glm::vec4 color = glm::vec4(1.0f), glm::vec4 specular = MATERIAL_SPECULAR) {
+		DrawPacket packet;
+		packet.VAO = VAO;
+		packet.IndexCount = indexCount;
+		packet.Program = &shader;
+		packet.Surface = &material;
+		packet.Model = model;
+		packet.Color = color;
+		packet.Specular = specular;
+		packet.Lights = glm::vec4(-1.0f);
+		packet.Bounds = bounds.Transform(model);
+		packet.Translucent = material.Translucent;
+
+		// View space depth of the bounds center, the origin of pre-transformed batches is meaningless.
+		glm::vec3 center = packet.Bounds.Center();
+		glm::vec3 extents = packet.Bounds.Extents();
+		packet.Depth = std::max(glm::dot(center - viewPosition, viewDirection), 0.0f);
+
+		boundsCenterX.push_back(center.x);
+		boundsCenterY.push_back(center.y);
+		boundsCenterZ.push_back(center.z);
+		boundsExtentX.push_back(extents.x);
+		boundsExtentY.push_back(extents.y);
+		boundsExtentZ.push_back(extents.z);
+
+		keys.push_back(std::make_pair(makeKey(packet), (unsigned int)Packets.size()));
+		Packets.push_back(packet);
+	}
+
+	// Drop the packets outside the frustum, call before Sort().
+	void Cull(Frustum& frustum) {
+		if (Packets.empty()) {
+			return;
+		}
+
+		visibility.resize(Packets.size());
+		frustum.CullBoxes(boundsCenterX.data(), boundsCenterY.data(), boundsCenterZ.data(), boundsExtentX.data(), boundsExtentY.data(), boundsExtentZ.data(), Packets.size(), visibility.data());
+
+		const std::vector<unsigned char>& visible = visibility;
+		keys.erase(std::remove_if(keys.begin(), keys.end(), [&visible](const std::pair<uint64_t, unsigned int>& key) {
+			return visible[key.second] == 0;
+		}), keys.end());
+	}
+
+	// Pick the lights of the packets still queued, call after Cull() so hidden ones are skipped.
+	void AssignLights(ObjectLights& lights) {
+		for (unsigned int i = 0; i < keys.size(); i++) {
+			DrawPacket& packet = Packets[keys[i].second];
+			packet.Lights = lights.Select(packet.Bounds);
+		}
+	}
+
+	void Sort() {
+		std::sort(keys.begin(), keys.end(), [](const std::pair<uint64_t, unsigned int>& a, const std::pair<uint64_t, unsigned int>& b) {
+			return a.first < b.first;
+		});
+	}
+
+	void Flush() {
+		DrawCalls = 0;
+		DepthDrawCalls = 0;
+		Instances = 0;
+		ProgramChanges = 0;
+		MaterialChanges = 0;
+		MeshChanges = 0;
+
+		if (keys.empty() || !uploadInstances()) {
+			return;
+		}
+
+		bool prepass = DepthPrepass && depthProgram != nullptr;
+		if (prepass) {
+			flushDepth();
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+		}
+
+		Shader* currentProgram = nullptr;
+		Material* currentMaterial = nullptr;
+		unsigned int currentVAO = 0;
+		bool translucent = false;
+
+		unsigned int first = 0;
+		while (first < keys.size()) {
+			DrawPacket& packet = Packets[keys[first].second];
+
+			// Find the end of the group
+			unsigned int last = first + 1;
+			while (last < keys.size() && canInstance(packet, Packets[keys[last].second])) {
+				last++;
+			}
+
+			if (packet.Translucent && !translucent) {
+				// Translucent packets aren't in the pre-pass, they blend over what is behind them.
+				if (prepass) {
+					glDepthFunc(GL_LESS);
+				}
+				glDepthMask(GL_FALSE);
+				translucent = true;
+			}
+
+			if (packet.Program != currentProgram) {
+				currentProgram = packet.Program;
+				currentProgram->use();
+				currentMaterial = nullptr;
+				ProgramChanges++;
+			}
+
+			if (currentMaterial == nullptr || !currentMaterial->SameBinding(*packet.Surface)) {
+				currentMaterial = packet.Surface;
+				currentMaterial->Bind(*currentProgram);
+				MaterialChanges++;
+			}
+
+			if (packet.VAO != currentVAO) {
+				currentVAO = packet.VAO;
+				glBindVertexArray(currentVAO);
+				MeshChanges++;
+			}
+
+			bindInstances(currentVAO, first);
+			glDrawElementsInstanced(GL_TRIANGLES, packet.IndexCount, GL_UNSIGNED_INT, 0, last - first);
+			DrawCalls++;
+			Instances += last - first;
+
+			first = last;
+		}
+
+		glBindVertexArray(0);
+		if (prepass) {
+			glDepthFunc(GL_LESS);
+		}
+		if (translucent || prepass) {
+			glDepthMask(GL_TRUE);
+		}
+
+		// Fence the instance data after the last draw using it.
+		instanceStream.EndFrame();
+	}
+
+	// Only the depth of the opaque packets, drawn with the depth program. This is how shadow
+	// maps are rendered, the program's view and projection must already be set.
+	void FlushDepth() {
+		DrawCalls = 0;
+		DepthDrawCalls = 0;
+		Instances = 0;
+		ProgramChanges = 0;
+		MaterialChanges = 0;
+		MeshChanges = 0;
+
+		if (keys.empty() || depthProgram == nullptr || !uploadInstances()) {
+			return;
+		}
+		flushDepth();
+		instanceStream.EndFrame();
+	}
+
+private:
+	std::vector<std::pair<uint64_t, unsigned int>> keys;
+	std::vector<InstanceData> instances;
+
+	// World bounds of the packets, separate arrays so they can be tested 4 at a time
+	std::vector<float> boundsCenterX;
+	std::vector<float> boundsCenterY;
+	std::vector<float> boundsCenterZ;
+	std::vector<float> boundsExtentX;
+	std::vector<float> boundsExtentY;
+	std::vector<float> boundsExtentZ;
+	std::vector<unsigned char> visibility;
+
+	std::set<unsigned int> instancedVAOs;
+	std::map<unsigned int, unsigned int> depthVAOs;
+	Shader* depthProgram;
+	StreamBuffer instanceStream;
+	size_t instanceOffset;
+	glm::vec3 viewPosition;
+	glm::vec3 viewDirection;
+
+	bool canInstance(const DrawPacket& a, const DrawPacket& b) {
+		return a.Program == b.Program && a.Surface->SameBinding(*b.Surface) && a.VAO == b.VAO && a.IndexCount == b.IndexCount && a.Translucent == b.Translucent;
+	}
+
+	// Depth-only draws of the opaque packets. Only the mesh matters here, so neighbouring groups
+	// that differ in program or material but share a mesh are drawn as one.
+	void flushDepth() {
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		depthProgram->use();
+
+		unsigned int currentVAO = 0;
+		unsigned int first = 0;
+		while (first < keys.size()) {
+			DrawPacket& packet = Packets[keys[first].second];
+			// Opaque packets are sorted first.
+			if (packet.Translucent) {
+				break;
+			}
+
+			unsigned int last = first + 1;
+			while (last < keys.size()) {
+				DrawPacket& next = Packets[keys[last].second];
+				if (next.Translucent || next.VAO != packet.VAO || next.IndexCount != packet.IndexCount) {
+					break;
+				}
+				last++;
+			}
+
+			auto it = depthVAOs.find(packet.VAO);
+			unsigned int VAO = it != depthVAOs.end() ? it->second : packet.VAO;
+			if (VAO != currentVAO) {
+				currentVAO = VAO;
+				glBindVertexArray(currentVAO);
+			}
+
+			bindInstances(currentVAO, first);
+			glDrawElementsInstanced(GL_TRIANGLES, packet.IndexCount, GL_UNSIGNED_INT, 0, last - first);
+			DepthDrawCalls++;
+
+			first = last;
+		}
+
+		glBindVertexArray(0);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	}
+
+	bool uploadInstances() {
+		// Gather the instance data in sorted order, so every group is a contiguous range.
+		instances.resize(keys.size());
+		for (unsigned int i = 0; i < keys.size(); i++) {
+			DrawPacket& packet = Packets[keys[i].second];
+			instances[i].Model = packet.Model;
+			instances[i].Color = packet.Color;
+			instances[i].Layers = glm::vec4((float)packet.Surface->DiffuseLayer.Layer, (float)packet.Surface->SpecularLayer.Layer, 0.0f, 0.0f);
+			instances[i].Lights = packet.Lights;
+			instances[i].Specular = packet.Specular;
+		}
+
+		// Grow with some headroom, so the ring isn't recreated every time a few packets are added.
+		size_t size = instances.size() * sizeof(InstanceData);
+		if (size > instanceStream.GetFrameSize()) {
+			instanceStream.Reserve(size * 2);
+		}
+
+		instanceStream.BeginFrame();
+		void* data = instanceStream.Map(size, sizeof(InstanceData), &instanceOffset);
+		if (data == nullptr) {
+			instanceStream.EndFrame();
+			return false;
+		}
+		std::memcpy(data, instances.data(), size);
+		instanceStream.Unmap();
+		return true;
+	}
+
+	void bindInstances(unsigned int VAO, unsigned int firstInstance) {
+		// The VAO must be bound.
+		if (instancedVAOs.find(VAO) == instancedVAOs.end()) {
+			for (unsigned int i = 0; i < 4; i++) {
+				glEnableVertexAttribArray(INSTANCE_MODEL_LOCATION + i);
+				glVertexAttribDivisor(INSTANCE_MODEL_LOCATION + i, 1);
+			}
+			glEnableVertexAttribArray(INSTANCE_COLOR_LOCATION);
+			glVertexAttribDivisor(INSTANCE_COLOR_LOCATION, 1);
+			glEnableVertexAttribArray(INSTANCE_LAYERS_LOCATION);
+			glVertexAttribDivisor(INSTANCE_LAYERS_LOCATION, 1);
+			glEnableVertexAttribArray(INSTANCE_LIGHTS_LOCATION);
+			glVertexAttribDivisor(INSTANCE_LIGHTS_LOCATION, 1);
+			glEnableVertexAttribArray(INSTANCE_SPECULAR_LOCATION);
+			glVertexAttribDivisor(INSTANCE_SPECULAR_LOCATION, 1);
+			instancedVAOs.insert(VAO);
+		}
+
+		// No base instance in GL 3.3, so offset the attribute pointers instead.
+		size_t offset = instanceOffset + firstInstance * sizeof(InstanceData);
+		GLsizei vec4Size = sizeof(glm::vec4);
+		glBindBuffer(GL_ARRAY_BUFFER, instanceStream.GetBuffer());
+		for (unsigned int i = 0; i < 4; i++) {
+			glVertexAttribPointer(INSTANCE_MODEL_LOCATION + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + i * vec4Size));
+		}
+		glVertexAttribPointer(INSTANCE_COLOR_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, Color)));
+		glVertexAttribPointer(INSTANCE_LAYERS_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, Layers)));
+		glVertexAttribPointer(INSTANCE_LIGHTS_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, Lights)));
+		glVertexAttribPointer(INSTANCE_SPECULAR_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offset + offsetof(InstanceData, Specular)));
+	}
+
+	uint64_t makeKey(const DrawPacket& packet) {
+		// Positive floats keep their order when compared as unsigned integers.
+		uint32_t depth;
+		std::memcpy(&depth, &packet.Depth, sizeof(float));
+
+		uint64_t pass = packet.Translucent ? TRANSLUCENT_PASS : OPAQUE_PASS;
+		uint64_t program = packet.Program->ID & 0xFF;
+		uint64_t material = packet.Surface->BindingID() & 0xFFF;
+		uint64_t mesh = packet.VAO & 0x3FF;
+
+		if (packet.Translucent) {
+			return (pass << 62) | ((uint64_t)(~depth) << 30) | (program << 22) | (material << 10) | mesh;
+		}
+		return (pass << 62) | (program << 54) | (material << 42) | (mesh << 32) | depth;
+	}
+};
+
+#endif // !RENDERQUEUE_H
\ No newline at end of file
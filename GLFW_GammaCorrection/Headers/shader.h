@@ -12,15 +12,18 @@ class Shader {
 public:
 	unsigned int ID;
 
-	Shader(const char* vertexPath, const char* fragmentPath) {
+	Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) {
 		std::string vertexCode;
 		std::string fragmentCode;
+		std::string geometryCode;
 
 		std::ifstream vShaderFile;
 		std::ifstream fShaderFile;
+		std::ifstream gShaderFile;
 
 		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 		fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 		try
 		{
 			// Open files
@@ -36,6 +39,14 @@ public:
 
 			vertexCode = vShaderStream.str();
 			fragmentCode = fShaderStream.str();
+
+			if (geometryPath != nullptr) {
+				gShaderFile.open(geometryPath);
+				std::stringstream gShaderStream;
+				gShaderStream << gShaderFile.rdbuf();
+				gShaderFile.close();
+				geometryCode = gShaderStream.str();
+			}
 		}
 		catch (std::ifstream::failure& e)
 		{
@@ -56,14 +67,29 @@ public:
 		glCompileShader(fragment);
 		checkCompileErrors(fragment, "Fragment", fragmentPath);
 
+		unsigned int geometry = 0;
+		if (geometryPath != nullptr) {
+			const char* gShaderCode = geometryCode.c_str();
+			geometry = glCreateShader(GL_GEOMETRY_SHADER);
+			glShaderSource(geometry, 1, &gShaderCode, NULL);
+			glCompileShader(geometry);
+			checkCompileErrors(geometry, "Geometry", geometryPath);
+		}
+
 		ID = glCreateProgram();
 		glAttachShader(ID, vertex);
 		glAttachShader(ID, fragment);
+		if (geometryPath != nullptr) {
+			glAttachShader(ID, geometry);
+		}
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "Program", NULL);
 
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
+		if (geometryPath != nullptr) {
+			glDeleteShader(geometry);
+		}
 	};
 
 	void use() {
@@ -82,6 +108,10 @@ public:
 		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
 	};
 
+	void setVec2(const std::string& name, glm::vec2 vector) const {
+		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &vector[0]);
+	};
+
 	void setVec3(const std::string& name, glm::vec3 vector) const {
 		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &vector[0]);
 	};
@@ -0,0 +1,193 @@
+#ifndef STATICBATCH_H
+#define STATICBATCH_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+#include "material.h"
+#include "renderqueue.h"
+
+#include <cmath>
+#include <map>
+#include <vector>
+
+// Vertex layout of the source objects and of the batches: position(3), normal(3), texture coords(2)
+const unsigned int STATIC_VERTEX_SIZE = 8;
+const float CHUNK_SIZE = 32.0f;
+
+struct StaticChunk {
+	unsigned int VAO;
+	unsigned int VBO;
+	unsigned int EBO;
+	// Positions only, sharing EBO, for the depth pre-pass
+	unsigned int DepthVAO;
+	unsigned int DepthVBO;
+	unsigned int IndexCount;
+	Material* Surface;
+
+	// World space bounds of everything merged into the chunk
+	glm::vec3 Min;
+	glm::vec3 Max;
+};
+
+// Pre-transforms never-moving objects into one vertex/index buffer per (material, chunk),
+// so the static scenery costs a handful of draws regardless of object count.
+class StaticBatcher {
+public:
+	std::vector<StaticChunk> Chunks;
+	float ChunkSize;
+	unsigned int ObjectCount;
+
+	StaticBatcher(float chunkSize = CHUNK_SIZE) : ChunkSize(chunkSize), ObjectCount(0) {
+
+	}
+
+	void Add(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, glm::mat4 model, Material& material) {
+		glm::mat3 normalModel = glm::mat3(glm::transpose(glm::inverse(model)));
+
+		// Transform the vertices first, the chunk is picked by the center of the world bounds.
+		std::vector<float> transformed(vertices.size());
+		glm::vec3 minPoint(INFINITY);
+		glm::vec3 maxPoint(-INFINITY);
+		for (unsigned int i = 0; i + STATIC_VERTEX_SIZE <= vertices.size(); i += STATIC_VERTEX_SIZE) {
+			glm::vec3 position = glm::vec3(model * glm::vec4(vertices[i], vertices[i + 1], vertices[i + 2], 1.0f));
+			glm::vec3 normal = glm::normalize(normalModel * glm::vec3(vertices[i + 3], vertices[i + 4], vertices[i + 5]));
+
+			transformed[i] = position.x;
+			transformed[i + 1] = position.y;
+			transformed[i + 2] = position.z;
+			transformed[i + 3] = normal.x;
+			transformed[i + 4] = normal.y;
+			transformed[i + 5] = normal.z;
+			transformed[i + 6] = vertices[i + 6];
+			transformed[i + 7] = vertices[i + 7];
+
+			minPoint = glm::min(minPoint, position);
+			maxPoint = glm::max(maxPoint, position);
+		}
+
+		glm::vec3 center = (minPoint + maxPoint) * 0.5f;
+		ChunkKey key;
+		key.MaterialID = material.ID;
+		key.X = (int)std::floor(center.x / ChunkSize);
+		key.Z = (int)std::floor(center.z / ChunkSize);
+
+		auto it = pending.find(key);
+		if (it == pending.end()) {
+			PendingChunk chunk;
+			chunk.Surface = &material;
+			chunk.Min = minPoint;
+			chunk.Max = maxPoint;
+			it = pending.insert(std::make_pair(key, chunk)).first;
+		}
+
+		PendingChunk& chunk = it->second;
+		unsigned int baseVertex = chunk.Vertices.size() / STATIC_VERTEX_SIZE;
+		chunk.Vertices.insert(chunk.Vertices.end(), transformed.begin(), transformed.end());
+		for (unsigned int i = 0; i < indices.size(); i++) {
+			chunk.Indices.push_back(baseVertex + indices[i]);
+		}
+		chunk.Min = glm::min(chunk.Min, minPoint);
+		chunk.Max = glm::max(chunk.Max, maxPoint);
+		ObjectCount++;
+	}
+
+	// Upload every pending chunk, call once after all static objects were added.
+	void Build() {
+		for (auto it = pending.begin(); it != pending.end(); ++it) {
+			PendingChunk& source = it->second;
+
+			StaticChunk chunk;
+			chunk.IndexCount = source.Indices.size();
+			chunk.Surface = source.Surface;
+			chunk.Min = source.Min;
+			chunk.Max = source.Max;
+
+			glGenVertexArrays(1, &chunk.VAO);
+			glGenBuffers(1, &chunk.VBO);
+			glGenBuffers(1, &chunk.EBO);
+			glBindVertexArray(chunk.VAO);
+				glBindBuffer(GL_ARRAY_BUFFER, chunk.VBO);
+				glBufferData(GL_ARRAY_BUFFER, source.Vertices.size() * sizeof(float), source.Vertices.data(), GL_STATIC_DRAW);
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.EBO);
+				glBufferData(GL_ELEMENT_ARRAY_BUFFER, source.Indices.size() * sizeof(unsigned int), source.Indices.data(), GL_STATIC_DRAW);
+				glEnableVertexAttribArray(0);
+				glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, STATIC_VERTEX_SIZE * sizeof(float), (void*)0);
+				glEnableVertexAttribArray(1);
+				glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, STATIC_VERTEX_SIZE * sizeof(float), (void*)(3 * sizeof(float)));
+				glEnableVertexAttribArray(2);
+				glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, STATIC_VERTEX_SIZE * sizeof(float), (void*)(6 * sizeof(float)));
+			glBindVertexArray(0);
+
+			std::vector<float> positions;
+			positions.reserve(source.Vertices.size() / STATIC_VERTEX_SIZE * 3);
+			for (unsigned int i = 0; i + STATIC_VERTEX_SIZE <= source.Vertices.size(); i += STATIC_VERTEX_SIZE) {
+				positions.insert(positions.end(), source.Vertices.begin() + i, source.Vertices.begin() + i + 3);
+			}
+			glGenVertexArrays(1, &chunk.DepthVAO);
+			glGenBuffers(1, &chunk.DepthVBO);
+			glBindVertexArray(chunk.DepthVAO);
+				glBindBuffer(GL_ARRAY_BUFFER, chunk.DepthVBO);
+				glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+				glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, chunk.EBO);
+				glEnableVertexAttribArray(0);
+				glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+			glBindVertexArray(0);
+
+			Chunks.push_back(chunk);
+		}
+		pending.clear();
+	}
+
+	// The vertices are already in world space, so every chunk is drawn with an identity transform.
+	void Submit(RenderQueue& queue, Shader& shader) {
+		for (unsigned int i = 0; i < Chunks.size(); i++) {
+			queue.SetDepthVAO(Chunks[i].VAO, Chunks[i].DepthVAO);
+			queue.Submit(Chunks[i].VAO, Chunks[i].IndexCount, shader, *Chunks[i].Surface, glm::mat4(1.0f), AABB(Chunks[i].Min, Chunks[i].Max));
+		}
+	}
+
+	void Clear() {
+		for (unsigned int i = 0; i < Chunks.size(); i++) {
+			glDeleteVertexArrays(1, &Chunks[i].VAO);
+			glDeleteBuffers(1, &Chunks[i].VBO);
+			glDeleteBuffers(1, &Chunks[i].EBO);
+			glDeleteVertexArrays(1, &Chunks[i].DepthVAO);
+			glDeleteBuffers(1, &Chunks[i].DepthVBO);
+		}
+		Chunks.clear();
+		pending.clear();
+		ObjectCount = 0;
+	}
+
+private:
+	struct ChunkKey {
+		unsigned int MaterialID;
+		int X;
+		int Z;
+
+		bool operator<(const ChunkKey& other) const {
+			if (MaterialID != other.MaterialID) {
+				return MaterialID < other.MaterialID;
+			}
+			if (X != other.X) {
+				return X < other.X;
+			}
+			return Z < other.Z;
+		}
+	};
+
+	struct PendingChunk {
+		std::vector<float> Vertices;
+		std::vector<unsigned int> Indices;
+		Material* Surface;
+		glm::vec3 Min;
+		glm::vec3 Max;
+	};
+
+	std::map<ChunkKey, PendingChunk> pending;
+};
+
+#endif // !STATICBATCH_H
\ No newline at end of file
@@ -0,0 +1,185 @@
+#ifndef STREAMBUFFER_H
+#define STREAMBUFFER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <cstddef>
+
+// Not part of the GL 3.3 headers, glBufferStorage is loaded at runtime when the driver has it.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRY *BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// Frames the CPU may run ahead of the GPU, every frame writes its own region of the ring.
+const unsigned int STREAM_FRAMES = 3;
+
+// Ring buffer for data written every frame (instances, uniform blocks).
+// With GL_ARB_buffer_storage the whole ring stays persistently mapped (coherent), otherwise
+// every Map() maps its range with GL_MAP_UNSYNCHRONIZED_BIT. Either way the driver never
+// synchronizes: each region is fenced at EndFrame() and only waited on when the ring comes
+// back to it STREAM_FRAMES frames later, which normally has long passed.
+class StreamBuffer {
+public:
+	// Statistics
+	unsigned int Stalls;
+	size_t Used;
+
+	StreamBuffer(GLenum target = GL_ARRAY_BUFFER) : Stalls(0), Used(0), target(target), buffer(0), frameSize(0), frame(0), head(0), persistent(nullptr), mapped(false), inFrame(false) {
+		for (unsigned int i = 0; i < STREAM_FRAMES; i++) {
+			fences[i] = 0;
+		}
+	}
+
+	unsigned int GetBuffer() {
+		return buffer;
+	}
+
+	size_t GetFrameSize() {
+		return frameSize;
+	}
+
+	bool IsPersistent() {
+		return persistent != nullptr;
+	}
+
+	// Make every region hold at least size bytes, the buffer is recreated if it has to grow.
+	// Call it outside of BeginFrame() / EndFrame().
+	void Reserve(size_t size) {
+		if (size <= frameSize) {
+			return;
+		}
+		Release();
+
+		frameSize = size;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+
+		BufferStorageProc bufferStorage = loadBufferStorage();
+		if (bufferStorage != nullptr) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			bufferStorage(target, frameSize * STREAM_FRAMES, NULL, flags);
+			persistent = (unsigned char*)glMapBufferRange(target, 0, frameSize * STREAM_FRAMES, flags);
+		}
+		if (persistent == nullptr) {
+			// Immutable storage can't be respecified, start over with a new buffer.
+			if (bufferStorage != nullptr) {
+				glDeleteBuffers(1, &buffer);
+				glGenBuffers(1, &buffer);
+				glBindBuffer(target, buffer);
+			}
+			glBufferData(target, frameSize * STREAM_FRAMES, NULL, GL_STREAM_DRAW);
+		}
+		glBindBuffer(target, 0);
+	}
+
+	// Move to the next region, waits only if the GPU still reads it.
+	void BeginFrame() {
+		if (inFrame) {
+			return;
+		}
+		frame = (frame + 1) % STREAM_FRAMES;
+		waitFence(frame);
+		head = 0;
+		Used = 0;
+		inFrame = true;
+	}
+
+	// Reserve size bytes in the current region, offset receives their offset in the buffer.
+	// Returns where to write them, nullptr if the region is full. Unmap() before drawing.
+	void* Map(size_t size, size_t alignment, size_t* offset) {
+		size_t start = (head + alignment - 1) / alignment * alignment;
+		if (!inFrame || buffer == 0 || start + size > frameSize) {
+			return nullptr;
+		}
+		head = start + size;
+		Used = head;
+		*offset = frame * frameSize + start;
+
+		if (persistent != nullptr) {
+			return persistent + *offset;
+		}
+
+		// Nobody reads this range, the fence of the region guarantees it.
+		glBindBuffer(target, buffer);
+		void* pointer = glMapBufferRange(target, *offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		mapped = (pointer != nullptr);
+		return pointer;
+	}
+
+	void Unmap() {
+		if (mapped) {
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+			mapped = false;
+		}
+	}
+
+	// Fence the region after the last draw reading from it.
+	void EndFrame() {
+		if (!inFrame) {
+			return;
+		}
+		Unmap();
+		fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		inFrame = false;
+	}
+
+	void Release() {
+		for (unsigned int i = 0; i < STREAM_FRAMES; i++) {
+			waitFence(i);
+		}
+		if (buffer != 0) {
+			if (persistent != nullptr || mapped) {
+				glBindBuffer(target, buffer);
+				glUnmapBuffer(target);
+				glBindBuffer(target, 0);
+			}
+			glDeleteBuffers(1, &buffer);
+		}
+		buffer = 0;
+		frameSize = 0;
+		persistent = nullptr;
+		mapped = false;
+		inFrame = false;
+	}
+
+private:
+	GLenum target;
+	unsigned int buffer;
+	size_t frameSize;
+	unsigned int frame;
+	size_t head;
+	unsigned char* persistent;
+	bool mapped;
+	bool inFrame;
+	GLsync fences[STREAM_FRAMES];
+
+	void waitFence(unsigned int index) {
+		if (fences[index] == 0) {
+			return;
+		}
+		GLenum result = glClientWaitSync(fences[index], 0, 0);
+		if (result == GL_TIMEOUT_EXPIRED) {
+			Stalls++;
+			while (result == GL_TIMEOUT_EXPIRED) {
+				result = glClientWaitSync(fences[index], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			}
+		}
+		glDeleteSync(fences[index]);
+		fences[index] = 0;
+	}
+
+	static BufferStorageProc loadBufferStorage() {
+		if (!glfwExtensionSupported("GL_ARB_buffer_storage")) {
+			return nullptr;
+		}
+		return (BufferStorageProc)glfwGetProcAddress("glBufferStorage");
+	}
+};
+
+#endif // !STREAMBUFFER_H
\ No newline at end of file
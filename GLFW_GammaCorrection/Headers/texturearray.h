@@ -0,0 +1,146 @@
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+
+#include <glad/glad.h>
+#include "stb_image.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A texture inside a GL_TEXTURE_2D_ARRAY
+struct TextureLayer {
+	unsigned int Array;
+	int Layer;
+
+	TextureLayer() : Array(0), Layer(0) {
+
+	}
+};
+
+// Groups textures of the same size and format into texture arrays, so draws using
+// different textures can share the binding and only differ in the layer index.
+// Color textures are added as sRGB and sampled as linear colors, data like specular
+// masks stays linear. The two never share an array.
+class TextureArrayManager {
+public:
+	TextureLayer Add(const char* path, bool srgb = false) {
+		TextureLayer result;
+
+		int width, height, nrComponents;
+		unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
+		if (!data) {
+			std::cout << "Failed to load texture at path:" << path << std::endl;
+			return result;
+		}
+
+		Group* group = nullptr;
+		for (unsigned int i = 0; i < groups.size(); i++) {
+			if (groups[i].Width == width && groups[i].Height == height && groups[i].Components == nrComponents && groups[i].Srgb == srgb) {
+				group = &groups[i];
+				break;
+			}
+		}
+		if (group == nullptr) {
+			Group newGroup;
+			newGroup.Width = width;
+			newGroup.Height = height;
+			newGroup.Components = nrComponents;
+			newGroup.Srgb = srgb;
+			glGenTextures(1, &newGroup.ID);
+			groups.push_back(newGroup);
+			group = &groups.back();
+		}
+
+		result.Array = group->ID;
+		result.Layer = group->Layers.size();
+		group->Layers.push_back(data);
+		return result;
+	}
+
+	// Upload every group, call once after all textures were added.
+	void Build() {
+		for (unsigned int i = 0; i < groups.size(); i++) {
+			Group& group = groups[i];
+
+			GLenum format = getFormat(group.Components);
+			GLenum internalFormat = getInternalFormat(group.Components, group.Srgb);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, group.ID);
+			glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormat, group.Width, group.Height, group.Layers.size(), 0, format, GL_UNSIGNED_BYTE, NULL);
+			for (unsigned int layer = 0; layer < group.Layers.size(); layer++) {
+				glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, group.Width, group.Height, 1, format, GL_UNSIGNED_BYTE, group.Layers[layer]);
+				stbi_image_free(group.Layers[layer]);
+			}
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+			group.LayerCount = group.Layers.size();
+			group.Layers.clear();
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	unsigned int GetArrayCount() {
+		return groups.size();
+	}
+
+	unsigned int GetLayerCount() {
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < groups.size(); i++) {
+			count += groups[i].LayerCount;
+		}
+		return count;
+	}
+
+	void Clear() {
+		for (unsigned int i = 0; i < groups.size(); i++) {
+			glDeleteTextures(1, &groups[i].ID);
+			for (unsigned int layer = 0; layer < groups[i].Layers.size(); layer++) {
+				stbi_image_free(groups[i].Layers[layer]);
+			}
+		}
+		groups.clear();
+	}
+
+private:
+	struct Group {
+		unsigned int ID;
+		int Width;
+		int Height;
+		int Components;
+		bool Srgb;
+		unsigned int LayerCount;
+		std::vector<unsigned char*> Layers;
+
+		Group() : ID(0), Width(0), Height(0), Components(0), Srgb(false), LayerCount(0) {
+
+		}
+	};
+
+	std::vector<Group> groups;
+
+	GLenum getFormat(int nrComponents) {
+		if (nrComponents == 1) {
+			return GL_RED;
+		} else if (nrComponents == 3) {
+			return GL_RGB;
+		}
+		return GL_RGBA;
+	}
+
+	// Single channel textures are never colors.
+	GLenum getInternalFormat(int nrComponents, bool srgb) {
+		if (nrComponents == 1) {
+			return GL_RED;
+		} else if (nrComponents == 3) {
+			return srgb ? GL_SRGB8 : GL_RGB;
+		}
+		return srgb ? GL_SRGB8_ALPHA8 : GL_RGBA;
+	}
+};
+
+#endif // !TEXTUREARRAY_H
\ No newline at end of file
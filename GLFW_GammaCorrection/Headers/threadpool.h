@@ -0,0 +1,120 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads for data parallel loops. The calling thread works too,
+// so a pool of N threads keeps N - 1 workers.
+class ThreadPool {
+public:
+	ThreadPool(unsigned int threadCount = 0) : job(nullptr), jobCount(0), jobGrain(1), generation(0), active(0), stopping(false) {
+		if (threadCount == 0) {
+			threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+		for (unsigned int i = 1; i < threadCount; i++) {
+			workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+		}
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (unsigned int i = 0; i < workers.size(); i++) {
+			workers[i].join();
+		}
+	}
+
+	unsigned int GetThreadCount() {
+		return workers.size() + 1;
+	}
+
+	// Call func(begin, end) for every range of grain elements in [0, count), returns when all are done.
+	// Ranges always start at a multiple of grain, so begin / grain can index per-range results.
+	void ParallelFor(unsigned int count, unsigned int grain, const std::function<void(unsigned int, unsigned int)>& func) {
+		if (count == 0) {
+			return;
+		}
+		grain = std::max(grain, 1u);
+
+		if (workers.empty() || count <= grain) {
+			for (unsigned int begin = 0; begin < count; begin += grain) {
+				func(begin, std::min(begin + grain, count));
+			}
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &func;
+			jobCount = count;
+			jobGrain = grain;
+			next = 0;
+			active = workers.size();
+			generation++;
+		}
+		wake.notify_all();
+
+		runJobs();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this]() { return active == 0; });
+		job = nullptr;
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	const std::function<void(unsigned int, unsigned int)>* job;
+	unsigned int jobCount;
+	unsigned int jobGrain;
+	std::atomic<unsigned int> next;
+	unsigned int generation;
+	unsigned int active;
+	bool stopping;
+
+	void workerLoop() {
+		unsigned int seen = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+				if (stopping) {
+					return;
+				}
+				seen = generation;
+			}
+
+			runJobs();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			active--;
+			if (active == 0) {
+				done.notify_one();
+			}
+		}
+	}
+
+	void runJobs() {
+		while (true) {
+			unsigned int begin = next.fetch_add(jobGrain);
+			if (begin >= jobCount) {
+				break;
+			}
+			(*job)(begin, std::min(begin + jobGrain, jobCount));
+		}
+	}
+};
+
+#endif // !THREADPOOL_H
\ No newline at end of file
@@ -0,0 +1,54 @@
+#version 330 core
+out vec3 FragColor;
+
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+uniform vec2 targetSize;
+// Only for the first level, from the scene
+uniform bool karisAverage;
+
+float KarisWeight(vec3 color) {
+	float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
+	return 1.0 / (1.0 + luma);
+}
+
+// 13 bilinear taps, four overlapping 2x2 boxes around the center and one box inside them. Together
+// they cover 6x6 source texels, a wider footprint than a plain 2x2 box with far less aliasing.
+void main() {
+	vec2 uv = gl_FragCoord.xy / targetSize;
+	vec2 t = sourceTexelSize;
+
+	vec3 a = texture(source, uv + t * vec2(-2.0, 2.0)).rgb;
+	vec3 b = texture(source, uv + t * vec2(0.0, 2.0)).rgb;
+	vec3 c = texture(source, uv + t * vec2(2.0, 2.0)).rgb;
+	vec3 d = texture(source, uv + t * vec2(-2.0, 0.0)).rgb;
+	vec3 e = texture(source, uv).rgb;
+	vec3 f = texture(source, uv + t * vec2(2.0, 0.0)).rgb;
+	vec3 g = texture(source, uv + t * vec2(-2.0, -2.0)).rgb;
+	vec3 h = texture(source, uv + t * vec2(0.0, -2.0)).rgb;
+	vec3 i = texture(source, uv + t * vec2(2.0, -2.0)).rgb;
+	vec3 j = texture(source, uv + t * vec2(-1.0, 1.0)).rgb;
+	vec3 k = texture(source, uv + t * vec2(1.0, 1.0)).rgb;
+	vec3 l = texture(source, uv + t * vec2(-1.0, -1.0)).rgb;
+	vec3 m = texture(source, uv + t * vec2(1.0, -1.0)).rgb;
+
+	// The inner box counts half, the four outer ones an eighth each.
+	vec3 boxes[5] = vec3[](
+		(j + k + l + m) * 0.25,
+		(a + b + d + e) * 0.25,
+		(b + c + e + f) * 0.25,
+		(d + e + g + h) * 0.25,
+		(e + f + h + i) * 0.25
+	);
+	float weights[5] = float[](0.5, 0.125, 0.125, 0.125, 0.125);
+
+	vec3 result = vec3(0.0);
+	float total = 0.0;
+	for (int n = 0; n < 5; n++) {
+		// Boxes weighted down by their brightness, so a single very bright texel can't flicker.
+		float weight = karisAverage ? weights[n] * KarisWeight(boxes[n]) : weights[n];
+		result += boxes[n] * weight;
+		total += weight;
+	}
+	FragColor = result / total;
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#version 330 core
+out vec3 FragColor;
+
+uniform sampler2D source;
+uniform vec2 sourceTexelSize;
+uniform vec2 targetSize;
+uniform float filterRadius;
+
+// 3x3 tent filter over the smaller level, added onto the larger one by blending.
+void main() {
+	vec2 uv = gl_FragCoord.xy / targetSize;
+	vec2 t = sourceTexelSize * filterRadius;
+
+	vec3 result = texture(source, uv).rgb * 4.0;
+	result += texture(source, uv + t * vec2(0.0, 1.0)).rgb * 2.0;
+	result += texture(source, uv + t * vec2(-1.0, 0.0)).rgb * 2.0;
+	result += texture(source, uv + t * vec2(1.0, 0.0)).rgb * 2.0;
+	result += texture(source, uv + t * vec2(0.0, -1.0)).rgb * 2.0;
+	result += texture(source, uv + t * vec2(-1.0, 1.0)).rgb;
+	result += texture(source, uv + t * vec2(1.0, 1.0)).rgb;
+	result += texture(source, uv + t * vec2(-1.0, -1.0)).rgb;
+	result += texture(source, uv + t * vec2(1.0, -1.0)).rgb;
+
+	FragColor = result / 16.0;
+}
\ No newline at end of file
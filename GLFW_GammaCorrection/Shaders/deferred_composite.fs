@@ -0,0 +1,29 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D lightAccumulation;
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gDepth;
+uniform vec2 screenSize;
+
+uniform bool useLighting;
+
+void main() {
+	vec2 uv = gl_FragCoord.xy / screenSize;
+
+	// Nothing was drawn here, keep the clear color.
+	float depth = texture(gDepth, uv).r;
+	if (depth == 1.0) {
+		discard;
+	}
+
+	vec3 color = vec3(0.0);
+	if (!useLighting) {
+		color = texture(gAlbedoSpecular, uv).rgb;
+	} else {
+		color = texture(lightAccumulation, uv).rgb;
+	}
+
+	FragColor = vec4(max(color, 0.0), 1.0);
+	gl_FragDepth = depth;
+}
\ No newline at end of file
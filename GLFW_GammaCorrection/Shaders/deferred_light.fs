@@ -0,0 +1,226 @@
+#version 330 core
+out vec4 FragColor;
+
+struct Light {
+	vec3 position;
+	vec3 direction;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	float constant;
+	float linear;
+	float quadratic;
+
+	float cutoff;
+	float outerCutoff;
+
+	int caster;
+	int shadow;
+};
+
+// Must match DEFERRED_SCREEN_LIGHTS in deferred.h
+#define NUM_LIGHTS 4
+
+// The point light of this volume
+flat in vec4 LightPositionRadius;
+flat in vec4 LightDiffuseLinear;
+flat in vec4 LightSpecularQuadratic;
+flat in vec4 LightAmbientConstant;
+flat in int LightShadow;
+
+uniform sampler2D gAlbedoSpecular;
+uniform sampler2D gNormalMaterial;
+uniform sampler2D gDepth;
+uniform mat4 inverseViewProjection;
+uniform vec2 screenSize;
+
+uniform vec3 viewPos;
+uniform bool useBlinnPhong;
+uniform bool volumePass;
+
+// Direction and spot lights of the full screen pass
+uniform int lightCount;
+uniform Light lights[NUM_LIGHTS];
+
+// Shadows of the direction light, see CascadedShadows
+#define NUM_CASCADES 4
+uniform bool useShadows;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 cascadeMatrices[NUM_CASCADES];
+uniform vec4 cascadeSpheres[NUM_CASCADES];
+uniform float cascadeTexelSizes[NUM_CASCADES];
+
+// Shadows of point lights, see PointShadows
+#define POINT_SHADOW_SLOTS 8
+uniform bool usePointShadows;
+uniform sampler2DArrayShadow pointShadowMap;
+uniform vec4 pointShadowSpheres[POINT_SHADOW_SLOTS];
+
+vec3 OctDecode(vec2 p) {
+	vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
+
+// Same as CalcShadow() in gamma.fs
+float CalcShadow(vec3 fragPos, vec3 normal, vec3 lightDir) {
+	if (!useShadows) {
+		return 1.0;
+	}
+	int cascade = 0;
+	while (cascade < NUM_CASCADES) {
+		vec3 offset = fragPos - cascadeSpheres[cascade].xyz;
+		if (dot(offset, offset) < cascadeSpheres[cascade].w * cascadeSpheres[cascade].w) {
+			break;
+		}
+		cascade++;
+	}
+	if (cascade == NUM_CASCADES) {
+		return 1.0;
+	}
+
+	float slope = 1.0 - max(dot(normal, lightDir), 0.0);
+	vec3 position = fragPos + normal * cascadeTexelSizes[cascade] * (0.5 + 1.5 * slope);
+	vec3 coords = (cascadeMatrices[cascade] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+
+	vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+			lit += texture(shadowMap, vec4(coords.xy + vec2(x, y) * texel, float(cascade), coords.z));
+		}
+	}
+	return lit / 9.0;
+}
+
+// Same as CalcPointShadow() in gamma.fs
+float CalcPointShadow(int slot, vec3 fragPos, vec3 normal) {
+	if (!usePointShadows || slot < 0) {
+		return 1.0;
+	}
+	vec4 sphere = pointShadowSpheres[slot];
+	vec3 v = fragPos + normal * 0.02 - sphere.xyz;
+
+	vec3 a = abs(v);
+	int face = 0;
+	vec2 uv = vec2(0.0);
+	if (a.x >= a.y && a.x >= a.z) {
+		face = v.x > 0.0 ? 0 : 1;
+		uv = vec2(v.x > 0.0 ? -v.z : v.z, -v.y) / a.x;
+	} else if (a.y >= a.z) {
+		face = v.y > 0.0 ? 2 : 3;
+		uv = vec2(v.x, v.y > 0.0 ? v.z : -v.z) / a.y;
+	} else {
+		face = v.z > 0.0 ? 4 : 5;
+		uv = vec2(v.z > 0.0 ? v.x : -v.x, -v.y) / a.z;
+	}
+
+	float depth = length(v) / sphere.w - 0.005;
+	return texture(pointShadowMap, vec4(uv * 0.5 + 0.5, float(slot * 6 + face), depth));
+}
+
+// The lighting of gamma.fs, with the surface read from the G-buffer.
+vec3 CalcLight(Light light, vec3 fragPos, vec3 normal, vec3 viewDir, vec3 albedo, float specularIntensity, float shininess) {
+	vec3 lightDir = vec3(0.0);
+	if (light.caster == 0) {
+		// Direction Light
+		lightDir = normalize(-light.direction);
+	} else {
+		lightDir = normalize(light.position - fragPos);
+	}
+
+	float diff = max(dot(normal, lightDir), 0.0);
+
+	float spec = 0.0;
+	if (useBlinnPhong) {
+		vec3 halfway = normalize(lightDir + viewDir);
+		spec = pow(max(dot(normal, halfway), 0.0), shininess);
+	} else {
+		vec3 reflectDir = reflect(-lightDir, normal);
+		spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+	}
+
+	vec3 ambient = light.ambient * albedo;
+	vec3 diffuse = light.diffuse * diff * albedo;
+	vec3 specular = light.specular * spec * specularIntensity;
+
+	if (light.caster == 0) {
+		float shadow = CalcShadow(fragPos, normal, lightDir);
+		diffuse *= shadow;
+		specular *= shadow;
+	} else if (light.caster == 1) {
+		float shadow = CalcPointShadow(light.shadow, fragPos, normal);
+		diffuse *= shadow;
+		specular *= shadow;
+	}
+
+	if (light.caster != 0) {
+		// Point Light or Spot Light
+		float distance = length(light.position - fragPos);
+		float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+		ambient *= attenuation;
+		diffuse *= attenuation;
+		specular *= attenuation;
+	}
+
+	if (light.caster == 2) {
+		// Spot Light
+		float theta = dot(lightDir, normalize(-light.direction));
+		float epsilon = light.cutoff - light.outerCutoff;
+		float intensity = clamp((theta - light.outerCutoff) / epsilon, 0.0, 1.0);
+
+		ambient *= intensity;
+		diffuse *= intensity;
+		specular *= intensity;
+	}
+
+	return ambient + diffuse + specular;
+}
+
+void main() {
+	vec2 uv = gl_FragCoord.xy / screenSize;
+
+	// World position back from the depth
+	float depth = texture(gDepth, uv).r;
+	vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+	vec3 fragPos = world.xyz / world.w;
+
+	vec4 albedoSpecular = texture(gAlbedoSpecular, uv);
+	vec4 normalMaterial = texture(gNormalMaterial, uv);
+	vec3 normal = OctDecode(normalMaterial.xy);
+	vec3 viewDir = normalize(viewPos - fragPos);
+
+	vec3 illumination = vec3(0.0);
+	if (volumePass) {
+		// The volume only bounds the light, the surface may still be out of reach.
+		if (distance(LightPositionRadius.xyz, fragPos) > LightPositionRadius.w) {
+			discard;
+		}
+		Light light;
+		light.position = LightPositionRadius.xyz;
+		light.direction = vec3(0.0);
+		light.ambient = LightAmbientConstant.rgb;
+		light.diffuse = LightDiffuseLinear.rgb;
+		light.specular = LightSpecularQuadratic.rgb;
+		light.constant = LightAmbientConstant.w;
+		light.linear = LightDiffuseLinear.w;
+		light.quadratic = LightSpecularQuadratic.w;
+		light.cutoff = 0.0;
+		light.outerCutoff = 0.0;
+		light.caster = 1;
+		light.shadow = LightShadow;
+		illumination = CalcLight(light, fragPos, normal, viewDir, albedoSpecular.rgb, albedoSpecular.a, normalMaterial.z);
+	} else {
+		for (int i = 0; i < lightCount; i++) {
+			illumination += CalcLight(lights[i], fragPos, normal, viewDir, albedoSpecular.rgb, albedoSpecular.a, normalMaterial.z);
+		}
+		illumination += albedoSpecular.rgb * normalMaterial.w;
+	}
+
+	FragColor = vec4(illumination, 1.0);
+}
\ No newline at end of file
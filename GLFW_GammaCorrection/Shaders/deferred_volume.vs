@@ -0,0 +1,29 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in vec4 aPositionRadius;
+layout (location = 6) in vec4 aDiffuseLinear;
+layout (location = 7) in vec4 aSpecularQuadratic;
+layout (location = 8) in vec4 aAmbientConstant;
+layout (location = 9) in vec4 aShadow;
+
+flat out vec4 LightPositionRadius;
+flat out vec4 LightDiffuseLinear;
+flat out vec4 LightSpecularQuadratic;
+flat out vec4 LightAmbientConstant;
+flat out int LightShadow;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float volumeMargin;
+
+// A unit sphere scaled to the reach of the light
+void main() {
+	LightPositionRadius = aPositionRadius;
+	LightDiffuseLinear = aDiffuseLinear;
+	LightSpecularQuadratic = aSpecularQuadratic;
+	LightAmbientConstant = aAmbientConstant;
+	LightShadow = int(aShadow.x);
+
+	vec3 position = aPositionRadius.xyz + aPos * aPositionRadius.w * volumeMargin;
+	gl_Position = projection * view * vec4(position, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aInstanceModel;
+
+uniform mat4 view;
+uniform mat4 projection;
+
+// Must compute gl_Position exactly like gamma.vs, so the GL_EQUAL pass matches.
+invariant gl_Position;
+
+void main () {
+	gl_Position = projection * view * aInstanceModel * vec4(aPos, 1.0);
+}
\ No newline at end of file
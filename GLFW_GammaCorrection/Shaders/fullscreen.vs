@@ -0,0 +1,20 @@
+#version 330 core
+
+// Unused by the full screen passes, written so deferred_light.fs links with either vertex shader.
+flat out vec4 LightPositionRadius;
+flat out vec4 LightDiffuseLinear;
+flat out vec4 LightSpecularQuadratic;
+flat out vec4 LightAmbientConstant;
+flat out int LightShadow;
+
+// One triangle covering the screen, drawn without vertex buffers.
+void main() {
+	LightPositionRadius = vec4(0.0);
+	LightDiffuseLinear = vec4(0.0);
+	LightSpecularQuadratic = vec4(0.0);
+	LightAmbientConstant = vec4(0.0);
+	LightShadow = -1;
+
+	vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
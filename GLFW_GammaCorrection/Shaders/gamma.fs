@@ -12,10 +12,16 @@ struct Material {
 	sampler2D specular_texture;
 	sampler2D emission_texture;
 
+	// Used instead of diffuse_texture/specular_texture, the layers come with the instance.
+	sampler2DArray diffuse_array;
+	sampler2DArray specular_array;
+	bool useTextureArray;
+
 	bool enableColorTexture;
     bool enableSpecularTexture;
 	bool enableEmission;
     bool enableEmissionTexture;
+	bool perDrawColor;
 };
 
 struct Light {
@@ -33,16 +39,36 @@ struct Light {
 	float cutoff;
 	float outerCutoff;
 
-	bool enable;
+	// Only read by the reference kernel, every array below holds a single type.
 	int caster;
+
+	// Slot in the point shadow atlas, -1 for none
+	int shadow;
 };
 
-#define NUM_LIGHTS 6
+// Enabled lights of each type, the counts come with them.
+#define MAX_DIR_LIGHTS 2
+#define MAX_POINT_LIGHTS 8
+#define MAX_SPOT_LIGHTS 2
+
+// Must match clusteredlights.h
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+#define CLUSTER_LIGHT_TEXELS 5
+
+// Must match objectlights.h
+#define OBJECT_LIGHTS 4
 
 in VS_OUT {
 	vec3 FragPos;
 	vec3 Normal;
 	vec2 TexCoords;
+	vec4 Color;
+	flat vec2 Layers;
+	flat vec4 Specular;
+	// Indices of the object's own point lights, -1 after the last
+	flat vec4 Lights;
 } fs_in;
 
 uniform vec3 viewPos;
@@ -51,12 +77,208 @@ uniform bool useLighting;
 uniform bool useDiffuseTexture;
 uniform bool useSpecularTexture;
 uniform bool useEmission;
-uniform bool useGamma;
-uniform float GammaValue;
 
 uniform Material material;
-uniform Light lights[NUM_LIGHTS];
+uniform Light dirLights[MAX_DIR_LIGHTS];
+uniform Light pointLights[MAX_POINT_LIGHTS];
+uniform Light spotLights[MAX_SPOT_LIGHTS];
+uniform int numDirLights;
+uniform int numPointLights;
+uniform int numSpotLights;
+
+// Shade with CalcLight() instead of the per-type kernels, see KernelComparison
+uniform bool useReferenceLighting;
+
+// Clustered point lights, see ClusteredLights
+uniform bool useClusters;
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterGrid;
+uniform usamplerBuffer clusterIndices;
+uniform int clusterLightBase;
+uniform int clusterGridBase;
+uniform int clusterIndexBase;
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepth;
+uniform vec2 clusterPlanes;
+
+// Point lights picked for each object, see ObjectLights
+uniform bool useObjectLights;
+uniform samplerBuffer objectLights;
+uniform int objectLightBase;
+
+// Shadows of the direction light, see CascadedShadows
+#define NUM_CASCADES 4
+uniform bool useShadows;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 cascadeMatrices[NUM_CASCADES];
+uniform vec4 cascadeSpheres[NUM_CASCADES];
+uniform float cascadeTexelSizes[NUM_CASCADES];
+
+// Shadows of point lights, see PointShadows
+#define POINT_SHADOW_SLOTS 8
+uniform bool usePointShadows;
+uniform sampler2DArrayShadow pointShadowMap;
+uniform vec4 pointShadowSpheres[POINT_SHADOW_SLOTS];
+
+// Diffuse and specular color of this draw, either from the material or from the instance.
+vec4 surfaceDiffuse;
+vec4 surfaceSpecular;
+
+vec4 SampleDiffuse() {
+	if (material.useTextureArray) {
+		return texture(material.diffuse_array, vec3(fs_in.TexCoords, fs_in.Layers.x));
+	}
+	return texture(material.diffuse_texture, fs_in.TexCoords);
+}
+
+vec4 SampleSpecular() {
+	if (material.useTextureArray) {
+		return texture(material.specular_array, vec3(fs_in.TexCoords, fs_in.Layers.y));
+	}
+	return texture(material.specular_texture, fs_in.TexCoords);
+}
+
+// The material of this fragment, sampled once in main() for all the lights.
+struct Surface {
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+	// Untextured surfaces without a specular map reflect at any angle
+	bool specularAlways;
+};
+Surface surface;
+
+// Ambient, diffuse and specular of a light coming from lightDir, before attenuation and shadows.
+void Reflect(Light light, vec3 lightDir, vec3 normal, vec3 viewDir, out vec3 ambient, out vec3 diffuse, out vec3 specular) {
+	float diff = max(dot(normal, lightDir), 0.0);
+
+	float spec = 0.0;
+	if (surface.specularAlways) {
+		spec = 1.0;
+	} else if (useBlinnPhong) {
+		vec3 halfway = normalize(lightDir + viewDir);
+		spec = pow(max(dot(normal, halfway), 0.0), material.shininess);
+	} else {
+		vec3 reflectDir = reflect(-lightDir, normal);
+		spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+	}
+
+	ambient = light.ambient * surface.ambient;
+	diffuse = light.diffuse * diff * surface.diffuse;
+	specular = light.specular * spec * surface.specular;
+}
+
+// How much of the direction light reaches fragPos, from the first cascade whose sphere holds it.
+float CalcShadow(vec3 fragPos, vec3 normal, vec3 lightDir) {
+	if (!useShadows) {
+		return 1.0;
+	}
+	int cascade = 0;
+	while (cascade < NUM_CASCADES) {
+		vec3 offset = fragPos - cascadeSpheres[cascade].xyz;
+		if (dot(offset, offset) < cascadeSpheres[cascade].w * cascadeSpheres[cascade].w) {
+			break;
+		}
+		cascade++;
+	}
+	if (cascade == NUM_CASCADES) {
+		return 1.0;
+	}
+
+	// Move off the surface by about a texel, more where the light grazes it.
+	float slope = 1.0 - max(dot(normal, lightDir), 0.0);
+	vec3 position = fragPos + normal * cascadeTexelSizes[cascade] * (0.5 + 1.5 * slope);
+	vec3 coords = (cascadeMatrices[cascade] * vec4(position, 1.0)).xyz * 0.5 + 0.5;
+
+	// 3x3 taps, each one filtered 2x2 by the depth comparison
+	vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+	float lit = 0.0;
+	for (int x = -1; x <= 1; x++) {
+		for (int y = -1; y <= 1; y++) {
+			lit += texture(shadowMap, vec4(coords.xy + vec2(x, y) * texel, float(cascade), coords.z));
+		}
+	}
+	return lit / 9.0;
+}
+
+// How much of a point light reaches fragPos, from the cube in its atlas slot.
+float CalcPointShadow(int slot, vec3 fragPos, vec3 normal) {
+	if (!usePointShadows || slot < 0) {
+		return 1.0;
+	}
+	// From where the cube was drawn, the light may have moved on since.
+	vec4 sphere = pointShadowSpheres[slot];
+	vec3 v = fragPos + normal * 0.02 - sphere.xyz;
+
+	// The face the vector leaves through, with the orientation of PointShadows::drawCube()
+	vec3 a = abs(v);
+	int face = 0;
+	vec2 uv = vec2(0.0);
+	if (a.x >= a.y && a.x >= a.z) {
+		face = v.x > 0.0 ? 0 : 1;
+		uv = vec2(v.x > 0.0 ? -v.z : v.z, -v.y) / a.x;
+	} else if (a.y >= a.z) {
+		face = v.y > 0.0 ? 2 : 3;
+		uv = vec2(v.x, v.y > 0.0 ? v.z : -v.z) / a.y;
+	} else {
+		face = v.z > 0.0 ? 4 : 5;
+		uv = vec2(v.z > 0.0 ? v.x : -v.x, -v.y) / a.z;
+	}
+
+	float depth = length(v) / sphere.w - 0.005;
+	return texture(pointShadowMap, vec4(uv * 0.5 + 0.5, float(slot * 6 + face), depth));
+}
+
+vec3 CalcDirLight(Light light, vec3 normal, vec3 viewDir) {
+	vec3 ambient, diffuse, specular;
+	vec3 lightDir = normalize(-light.direction);
+	Reflect(light, lightDir, normal, viewDir, ambient, diffuse, specular);
+
+	float shadow = CalcShadow(fs_in.FragPos, normal, lightDir);
+	diffuse *= shadow;
+	specular *= shadow;
+	return ambient + diffuse + specular;
+}
+
+vec3 CalcPointLight(Light light, vec3 normal, vec3 viewDir) {
+	vec3 ambient, diffuse, specular;
+	vec3 lightDir = normalize(light.position - fs_in.FragPos);
+	Reflect(light, lightDir, normal, viewDir, ambient, diffuse, specular);
 
+	float distance = length(light.position - fs_in.FragPos);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	ambient *= attenuation;
+	diffuse *= attenuation;
+	specular *= attenuation;
+
+	float shadow = CalcPointShadow(light.shadow, fs_in.FragPos, normal);
+	diffuse *= shadow;
+	specular *= shadow;
+	return ambient + diffuse + specular;
+}
+
+vec3 CalcSpotLight(Light light, vec3 normal, vec3 viewDir) {
+	vec3 ambient, diffuse, specular;
+	vec3 lightDir = normalize(light.position - fs_in.FragPos);
+	Reflect(light, lightDir, normal, viewDir, ambient, diffuse, specular);
+
+	float distance = length(light.position - fs_in.FragPos);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+	ambient *= attenuation;
+	diffuse *= attenuation;
+	specular *= attenuation;
+
+	float theta = dot(lightDir, normalize(-light.direction));
+	float epsilon = light.cutoff - light.outerCutoff;
+	float intensity = clamp((theta - light.outerCutoff) / epsilon, 0.0, 1.0);
+	ambient *= intensity;
+	diffuse *= intensity;
+	specular *= intensity;
+	return ambient + diffuse + specular;
+}
+
+// Reference kernel for any type of light, branching on the caster and sampling the material
+// for every light. The per-type kernels above must give the same image.
 vec3 CalcLight(Light light, vec3 normal, vec3 viewDir) {
 
 	vec3 ambient = vec3(0.0);
@@ -83,20 +305,20 @@ vec3 CalcLight(Light light, vec3 normal, vec3 viewDir) {
 	}
 
 	if (useDiffuseTexture && material.enableColorTexture) {
-		ambient = light.ambient * texture(material.diffuse_texture, fs_in.TexCoords).rgb;
-		diffuse = light.diffuse * diff * texture(material.diffuse_texture, fs_in.TexCoords).rgb;
+		ambient = light.ambient * SampleDiffuse().rgb;
+		diffuse = light.diffuse * diff * SampleDiffuse().rgb;
 		if (useSpecularTexture && material.enableSpecularTexture) {
-			specular = light.specular * spec * texture(material.specular_texture, fs_in.TexCoords).rgb;
+			specular = light.specular * spec * SampleSpecular().rgb;
 		} else {
-			specular = light.specular * spec * texture(material.diffuse_texture, fs_in.TexCoords).rgb;
+			specular = light.specular * spec * SampleDiffuse().rgb;
 		}
 	} else {
 		ambient = light.ambient * material.ambient.rgb;
-		diffuse = light.diffuse * diff * material.diffuse.rgb;
+		diffuse = light.diffuse * diff * surfaceDiffuse.rgb;
 		if (useSpecularTexture && material.enableSpecularTexture) {
-			specular = light.specular * spec * texture(material.specular_texture, fs_in.TexCoords).rgb;
+			specular = light.specular * spec * SampleSpecular().rgb;
 		} else {
-			specular = light.specular * material.specular.rgb;
+			specular = light.specular * surfaceSpecular.rgb;
 		}
 	}
 
@@ -110,6 +332,16 @@ vec3 CalcLight(Light light, vec3 normal, vec3 viewDir) {
 		specular *= attenuation;
 	}
 
+	if (light.caster == 0) {
+		float shadow = CalcShadow(fs_in.FragPos, normal, lightDir);
+		diffuse *= shadow;
+		specular *= shadow;
+	} else if (light.caster == 1) {
+		float shadow = CalcPointShadow(light.shadow, fs_in.FragPos, normal);
+		diffuse *= shadow;
+		specular *= shadow;
+	}
+
 	if (light.caster == 2) {
 		// Spot Light
 		float theta = dot(lightDir, normalize(-light.direction));
@@ -124,16 +356,97 @@ vec3 CalcLight(Light light, vec3 normal, vec3 viewDir) {
 	return ambient + diffuse + specular;
 }
 
+// Cluster of this fragment, the same slicing as ClusteredLights::Update().
+int ClusterIndex() {
+	// Linear depth back from the depth buffer
+	float ndc = gl_FragCoord.z * 2.0 - 1.0;
+	float depth = 2.0 * clusterPlanes.x * clusterPlanes.y / (clusterPlanes.y + clusterPlanes.x - ndc * (clusterPlanes.y - clusterPlanes.x));
+	int slice = clamp(int(floor(log(depth) * clusterDepth.x + clusterDepth.y)), 0, CLUSTER_Z - 1);
+	ivec2 tile = clamp(ivec2(gl_FragCoord.xy / clusterTileSize), ivec2(0), ivec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+	return (slice * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x;
+}
+
+// A point light from a light buffer, CLUSTER_LIGHT_TEXELS texels starting at base.
+Light FetchLight(samplerBuffer buffer, int base) {
+	vec4 positionLinear = texelFetch(buffer, base);
+	vec4 diffuseQuadratic = texelFetch(buffer, base + 1);
+	vec4 specularConstant = texelFetch(buffer, base + 2);
+	vec4 ambientRadius = texelFetch(buffer, base + 3);
+
+	Light light;
+	light.position = positionLinear.xyz;
+	light.direction = vec3(0.0);
+	light.ambient = ambientRadius.rgb;
+	light.diffuse = diffuseQuadratic.rgb;
+	light.specular = specularConstant.rgb;
+	light.constant = specularConstant.w;
+	light.linear = positionLinear.w;
+	light.quadratic = diffuseQuadratic.w;
+	light.cutoff = 0.0;
+	light.outerCutoff = 0.0;
+	light.caster = 1;
+	light.shadow = int(texelFetch(buffer, base + 4).r);
+	return light;
+}
+
+vec3 CalcClusterLights(vec3 normal, vec3 viewDir) {
+	vec3 result = vec3(0.0);
+	uvec2 cell = texelFetch(clusterGrid, clusterGridBase + ClusterIndex()).rg;
+	for (uint i = 0u; i < cell.y; i++) {
+		int index = int(texelFetch(clusterIndices, clusterIndexBase + int(cell.x + i)).r);
+		int base = clusterLightBase + index * CLUSTER_LIGHT_TEXELS;
+
+		// The clusters are boxes, the light may still be out of reach.
+		vec4 positionLinear = texelFetch(clusterLights, base);
+		vec4 ambientRadius = texelFetch(clusterLights, base + 3);
+		if (distance(positionLinear.xyz, fs_in.FragPos) > ambientRadius.w) {
+			continue;
+		}
+		Light light = FetchLight(clusterLights, base);
+		result += useReferenceLighting ? CalcLight(light, normal, viewDir) : CalcPointLight(light, normal, viewDir);
+	}
+	return result;
+}
+
+vec3 CalcObjectLights(vec3 normal, vec3 viewDir) {
+	vec3 result = vec3(0.0);
+	for (int i = 0; i < OBJECT_LIGHTS; i++) {
+		int index = int(fs_in.Lights[i]);
+		if (index < 0) {
+			break;
+		}
+		Light light = FetchLight(objectLights, objectLightBase + index * CLUSTER_LIGHT_TEXELS);
+		result += useReferenceLighting ? CalcLight(light, normal, viewDir) : CalcPointLight(light, normal, viewDir);
+	}
+	return result;
+}
+
 void main() {
 
 	vec3 norm = normalize(fs_in.Normal);
 	vec3 viewDir = normalize(viewPos - fs_in.FragPos);
 	
+	surfaceDiffuse = material.perDrawColor ? fs_in.Color : material.diffuse;
+	surfaceSpecular = material.perDrawColor ? fs_in.Specular : material.specular;
+
 	vec4 texel_diffuse = vec4(0.0);
+	bool useSpecularMap = useSpecularTexture && material.enableSpecularTexture;
+	vec4 texel_specular = vec4(0.0);
+	if (useSpecularMap && !useReferenceLighting) {
+		texel_specular = SampleSpecular();
+	}
 	if (useDiffuseTexture && material.enableColorTexture) {
-		texel_diffuse = texture(material.diffuse_texture, fs_in.TexCoords);
+		texel_diffuse = SampleDiffuse();
+		surface.ambient = texel_diffuse.rgb;
+		surface.diffuse = texel_diffuse.rgb;
+		surface.specular = useSpecularMap ? texel_specular.rgb : texel_diffuse.rgb;
+		surface.specularAlways = false;
 	} else {
-		texel_diffuse = material.diffuse;
+		texel_diffuse = surfaceDiffuse;
+		surface.ambient = material.ambient.rgb;
+		surface.diffuse = surfaceDiffuse.rgb;
+		surface.specular = useSpecularMap ? texel_specular.rgb : surfaceSpecular.rgb;
+		surface.specularAlways = !useSpecularMap;
 	}
 
 	// O_}ҥ
@@ -143,11 +456,32 @@ void main() {
 		// p
 		vec3 illumination = vec3(0.0f);
 
-		for (int i = 0; i < NUM_LIGHTS; i++) {
-			if (!lights[i].enable) {
-				continue;
+		// With clusters or object lists numPointLights is 0, the point lights come from those.
+		if (useReferenceLighting) {
+			for (int i = 0; i < numDirLights; i++) {
+				illumination += CalcLight(dirLights[i], norm, viewDir);
+			}
+			for (int i = 0; i < numPointLights; i++) {
+				illumination += CalcLight(pointLights[i], norm, viewDir);
+			}
+			for (int i = 0; i < numSpotLights; i++) {
+				illumination += CalcLight(spotLights[i], norm, viewDir);
+			}
+		} else {
+			for (int i = 0; i < numDirLights; i++) {
+				illumination += CalcDirLight(dirLights[i], norm, viewDir);
 			}
-			illumination += CalcLight(lights[i], norm, viewDir);
+			for (int i = 0; i < numPointLights; i++) {
+				illumination += CalcPointLight(pointLights[i], norm, viewDir);
+			}
+			for (int i = 0; i < numSpotLights; i++) {
+				illumination += CalcSpotLight(spotLights[i], norm, viewDir);
+			}
+		}
+		if (useClusters) {
+			illumination += CalcClusterLights(norm, viewDir);
+		} else if (useObjectLights) {
+			illumination += CalcObjectLights(norm, viewDir);
 		}
 
 		// }Ҧ۵o
@@ -159,10 +493,7 @@ void main() {
 			}
 		}
 
-		if (useGamma) {
-			illumination = pow(illumination, vec3(GammaValue));
-		}
-
-		FragColor = vec4(clamp(illumination, 0.0, 1.0), texel_diffuse.a);
+		// Linear and not clamped, an HDR target keeps what is over 1 for the tone mapping.
+		FragColor = vec4(max(illumination, 0.0), texel_diffuse.a);
 	}
 }
\ No newline at end of file
@@ -2,20 +2,35 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aInstanceModel;
+layout (location = 9) in vec4 aInstanceColor;
+layout (location = 10) in vec4 aInstanceLayers;
+layout (location = 11) in vec4 aInstanceLights;
+layout (location = 12) in vec4 aInstanceSpecular;
 
 out VS_OUT {
 	vec3 FragPos;
 	vec3 Normal;
 	vec2 TexCoords;
+	vec4 Color;
+	flat vec2 Layers;
+	flat vec4 Specular;
+	flat vec4 Lights;
 } vs_out;
 
-uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// Same position as Shaders/depth.vs, the depth pre-pass relies on it.
+invariant gl_Position;
+
 void main () {
-	vs_out.FragPos = vec3(model * vec4(aPos, 1.0));
-	vs_out.Normal = mat3(transpose(inverse(model))) * aNormal;
+	vs_out.FragPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+	vs_out.Normal = mat3(transpose(inverse(aInstanceModel))) * aNormal;
 	vs_out.TexCoords = aTexCoords;
-	gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
+	vs_out.Color = aInstanceColor;
+	vs_out.Layers = aInstanceLayers.xy;
+	vs_out.Specular = aInstanceSpecular;
+	vs_out.Lights = aInstanceLights;
+	gl_Position = projection * view * aInstanceModel * vec4(aPos, 1.0);
+}
\ No newline at end of file
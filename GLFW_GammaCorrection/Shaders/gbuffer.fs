@@ -0,0 +1,86 @@
+#version 330 core
+layout (location = 0) out vec4 gAlbedoSpecular;
+layout (location = 1) out vec4 gNormalMaterial;
+
+struct Material {
+	vec4 ambient;
+	vec4 diffuse;
+	vec4 specular;
+	vec4 emission;
+	float shininess;
+
+	sampler2D diffuse_texture;
+	sampler2D specular_texture;
+	sampler2D emission_texture;
+
+	// Used instead of diffuse_texture/specular_texture, the layers come with the instance.
+	sampler2DArray diffuse_array;
+	sampler2DArray specular_array;
+	bool useTextureArray;
+
+	bool enableColorTexture;
+	bool enableSpecularTexture;
+	bool enableEmission;
+	bool enableEmissionTexture;
+	bool perDrawColor;
+};
+
+in VS_OUT {
+	vec3 FragPos;
+	vec3 Normal;
+	vec2 TexCoords;
+	vec4 Color;
+	flat vec2 Layers;
+	flat vec4 Specular;
+	flat vec4 Lights;
+} fs_in;
+
+uniform bool useDiffuseTexture;
+uniform bool useSpecularTexture;
+uniform bool useEmission;
+
+uniform Material material;
+
+vec4 SampleDiffuse() {
+	if (material.useTextureArray) {
+		return texture(material.diffuse_array, vec3(fs_in.TexCoords, fs_in.Layers.x));
+	}
+	return texture(material.diffuse_texture, fs_in.TexCoords);
+}
+
+vec4 SampleSpecular() {
+	if (material.useTextureArray) {
+		return texture(material.specular_array, vec3(fs_in.TexCoords, fs_in.Layers.y));
+	}
+	return texture(material.specular_texture, fs_in.TexCoords);
+}
+
+// Unit vector to [-1, 1]^2, the lower half folded onto the corners. See OctDecode() in deferred_light.fs.
+vec2 OctEncode(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	if (n.z < 0.0) {
+		return (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return n.xy;
+}
+
+void main() {
+	vec4 surfaceDiffuse = material.perDrawColor ? fs_in.Color : material.diffuse;
+	vec4 surfaceSpecular = material.perDrawColor ? fs_in.Specular : material.specular;
+
+	bool textured = useDiffuseTexture && material.enableColorTexture;
+	vec3 albedo = textured ? SampleDiffuse().rgb : surfaceDiffuse.rgb;
+
+	// Same choice as CalcLight() in gamma.fs, kept as one intensity
+	vec3 specular = surfaceSpecular.rgb;
+	if (useSpecularTexture && material.enableSpecularTexture) {
+		specular = SampleSpecular().rgb;
+	} else if (textured) {
+		specular = albedo;
+	}
+
+	float emission = (material.enableEmission && useEmission) ? 1.5 : 0.0;
+
+	gAlbedoSpecular = vec4(albedo, dot(specular, vec3(1.0 / 3.0)));
+	gNormalMaterial = vec4(OctEncode(normalize(fs_in.Normal)), material.shininess, emission);
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+out float LogLuminance;
+
+// Must match hdr.h
+#define LUMINANCE_SIZE 256.0
+
+uniform sampler2D hdrScene;
+
+// Drawn into the square target of HdrRenderer, whose mip chain then averages the logs.
+void main() {
+	vec3 color = texture(hdrScene, gl_FragCoord.xy / LUMINANCE_SIZE).rgb;
+	float luminance = dot(color, vec3(0.2126, 0.7152, 0.0722));
+	LogLuminance = log(max(luminance, 1e-4));
+}
\ No newline at end of file
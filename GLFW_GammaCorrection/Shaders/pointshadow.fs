@@ -0,0 +1,10 @@
+#version 330 core
+in vec3 FragPos;
+
+uniform vec3 lightPosition;
+uniform float range;
+
+// Distance to the light instead of the projected depth, the same for every face.
+void main() {
+	gl_FragDepth = length(FragPos - lightPosition) / range;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#version 330 core
+layout (triangles) in;
+layout (triangle_strip, max_vertices = 18) out;
+
+in vec3 WorldPos[];
+
+out vec3 FragPos;
+
+// The 6 faces of the cube, drawn to layers firstLayer to firstLayer + 5
+uniform mat4 faceMatrices[6];
+uniform int firstLayer;
+
+void main() {
+	for (int face = 0; face < 6; face++) {
+		vec4 clip[3];
+		for (int i = 0; i < 3; i++) {
+			clip[i] = faceMatrices[face] * vec4(WorldPos[i], 1.0);
+		}
+
+		// Skip the faces the triangle lies entirely outside of.
+		vec3 left = vec3(clip[0].x + clip[0].w, clip[1].x + clip[1].w, clip[2].x + clip[2].w);
+		vec3 right = vec3(clip[0].w - clip[0].x, clip[1].w - clip[1].x, clip[2].w - clip[2].x);
+		vec3 bottom = vec3(clip[0].y + clip[0].w, clip[1].y + clip[1].w, clip[2].y + clip[2].w);
+		vec3 top = vec3(clip[0].w - clip[0].y, clip[1].w - clip[1].y, clip[2].w - clip[2].y);
+		vec3 nearPlane = vec3(clip[0].z + clip[0].w, clip[1].z + clip[1].w, clip[2].z + clip[2].w);
+		if (all(lessThan(left, vec3(0.0))) || all(lessThan(right, vec3(0.0))) || all(lessThan(bottom, vec3(0.0))) || all(lessThan(top, vec3(0.0))) || all(lessThan(nearPlane, vec3(0.0)))) {
+			continue;
+		}
+
+		for (int i = 0; i < 3; i++) {
+			FragPos = WorldPos[i];
+			gl_Position = clip[i];
+			gl_Layer = firstLayer + face;
+			EmitVertex();
+		}
+		EndPrimitive();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 5) in mat4 aInstanceModel;
+
+out vec3 WorldPos;
+
+// Projected per face in pointshadow.gs
+void main() {
+	WorldPos = vec3(aInstanceModel * vec4(aPos, 1.0));
+	gl_Position = vec4(WorldPos, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#version 330 core
+out vec4 FragColor;
+
+uniform sampler2D hdrScene;
+uniform float exposure;
+
+// Sum of the bloom chain at half resolution, divided by its levels
+uniform bool useBloom;
+uniform sampler2D bloom;
+uniform float bloomStrength;
+uniform float bloomMips;
+
+// Filmic curve fitted to the ACES reference transform (Krzysztof Narkowicz)
+vec3 ToneMapACES(vec3 x) {
+	return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main() {
+	vec3 color = texelFetch(hdrScene, ivec2(gl_FragCoord.xy), 0).rgb;
+	if (useBloom) {
+		vec2 uv = gl_FragCoord.xy / vec2(textureSize(hdrScene, 0));
+		color = mix(color, texture(bloom, uv).rgb / bloomMips, bloomStrength);
+	}
+
+	// Linear, the sRGB framebuffer encodes it.
+	FragColor = vec4(ToneMapACES(color * exposure), 1.0);
+}
\ No newline at end of file
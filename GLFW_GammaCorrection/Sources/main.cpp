@@ -16,6 +16,22 @@
 #include "../Headers/camera.h"
 #include "../Headers/model.h"
 #include "../Headers/light.h"
+#include "../Headers/material.h"
+#include "../Headers/renderqueue.h"
+#include "../Headers/staticbatch.h"
+#include "../Headers/texturearray.h"
+#include "../Headers/frustum.h"
+#include "../Headers/clusteredlights.h"
+#include "../Headers/objectlights.h"
+#include "../Headers/threadpool.h"
+#include "../Headers/deferred.h"
+#include "../Headers/gputimer.h"
+#include "../Headers/lightbenchmark.h"
+#include "../Headers/kernelcomparison.h"
+#include "../Headers/hdr.h"
+#include "../Headers/bloom.h"
+#include "../Headers/cascadedshadows.h"
+#include "../Headers/pointshadows.h"
 
 #include <vector>
 #include <iostream>
@@ -27,17 +43,14 @@
 void showUI();
 void geneObejectData();
 void geneSphereData();
-void drawFloor();
-void drawCube();
-void drawSphere();
-void drawBox();
+void geneExtraLights(unsigned int count);
+unsigned int genePositionVAO(const std::vector<float>& vertices, unsigned int stride, unsigned int EBO, unsigned int& VBO);
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 void mouseCallback(GLFWwindow* window, double xpos, double ypos);
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void proceessInput(GLFWwindow* window);
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void scrollCallback(GLFWwindow* window, double xpos, double ypos);
-unsigned int loadTexture(char const* path);
 
 // ========== Global Variable ==========
 
@@ -80,24 +93,81 @@ static bool useLighting = true;
 static bool useDiffuseTexture = true;
 static bool useSpecularTexture = true;
 static bool useEmission = true;
-static bool useGamma = false;
-static float GammaValue = 1.0f / 2.2f;
+// The textures are decoded to linear, so the output must be encoded to sRGB. Off only to compare.
+static bool useGamma = true;
+static bool useHDR = true;
+static bool useStaticBatching = true;
+static bool useFrustumCulling = true;
+static bool useDepthPrepass = true;
+static bool useClusteredLighting = false;
+static bool useObjectLights = true;
+static int extraLightCount = 0;
+static bool useDeferred = false;
+static bool useShadows = true;
+
+// Many small point lights, only shaded by the clustered lighting and the per-object light lists
+std::vector<Light> extraLights;
 
 // Object Data
 std::vector<float> cubeVertices;
-std::vector<int> cubeIndices;
+std::vector<unsigned int> cubeIndices;
 unsigned int cubeVAO, cubeVBO, cubeEBO;
+unsigned int cubeDepthVAO, cubeDepthVBO;
+AABB cubeBounds;
 
 std::vector<float> floorVertices;
 std::vector<unsigned int> floorIndices;
 unsigned int floorVAO, floorVBO, floorEBO;
+unsigned int floorDepthVAO, floorDepthVBO;
+AABB floorBounds;
 
 std::vector<float> sphereVertices;
 std::vector<unsigned int> sphereIndices;
 unsigned int sphereVAO, sphereVBO, sphereEBO;
+unsigned int sphereDepthVAO, sphereDepthVBO;
+AABB sphereBounds;
 
 // Texture parameter
-unsigned int boxTexture, boxSpecularTexture, floorTexture;
+TextureArrayManager textureArrays;
+TextureLayer boxTexture, boxSpecularTexture, floorTexture;
+
+// Render queue
+RenderQueue renderQueue;
+StaticBatcher staticBatcher;
+Frustum frustum;
+
+// Clustered lighting
+ThreadPool threadPool;
+ClusteredLights clusteredLights;
+
+// Per-object light lists, when the lights aren't clustered
+ObjectLights objectLights;
+
+// Deferred shading, and the forward/deferred comparison
+DeferredRenderer deferredRenderer;
+GpuTimer gpuTimer;
+LightBenchmark lightBenchmark;
+
+// What the user had selected before the benchmark took over, restored when it is done
+static int benchmarkExtraLightCount = 0;
+static bool benchmarkDeferred = false;
+static bool benchmarkClustered = false;
+
+// HDR target, tone mapping and auto exposure
+HdrRenderer hdrRenderer;
+
+// Bloom on the HDR scene, and its cost at fixed resolutions
+Bloom bloom;
+BloomBenchmark bloomBenchmark;
+
+// The per-type lighting loops checked against the reference kernel. The reference kernel stays the
+// default until the comparison has shown the per-type loops to be identical and faster.
+KernelComparison kernelComparison;
+static bool useReferenceLighting = true;
+
+// Shadows of the direction light
+CascadedShadows cascadedShadows;
+PointShadows pointShadows;
 
 int main(int argc, char* argv[]) {
 
@@ -106,6 +176,7 @@ int main(int argc, char* argv[]) {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	glfwWindowHint(GLFW_SAMPLES, 32);
+	glfwWindowHint(GLFW_SRGB_CAPABLE, GL_TRUE);
 
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, WINDOW_TITLE.c_str(), NULL, NULL);
 	if (!window) {
@@ -141,6 +212,43 @@ int main(int argc, char* argv[]) {
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	Shader myShader("Shaders/gamma.vs", "Shaders/gamma.fs");
+	Shader depthShader("Shaders/depth.vs", "Shaders/depth.fs");
+	Shader gbufferShader("Shaders/gamma.vs", "Shaders/gbuffer.fs");
+	Shader screenLightShader("Shaders/fullscreen.vs", "Shaders/deferred_light.fs");
+	Shader volumeLightShader("Shaders/deferred_volume.vs", "Shaders/deferred_light.fs");
+	Shader compositeShader("Shaders/fullscreen.vs", "Shaders/deferred_composite.fs");
+	Shader luminanceShader("Shaders/fullscreen.vs", "Shaders/luminance.fs");
+	Shader tonemapShader("Shaders/fullscreen.vs", "Shaders/tonemap.fs");
+	Shader bloomDownsampleShader("Shaders/fullscreen.vs", "Shaders/bloom_downsample.fs");
+	Shader bloomUpsampleShader("Shaders/fullscreen.vs", "Shaders/bloom_upsample.fs");
+	Shader shadowShader("Shaders/depth.vs", "Shaders/depth.fs");
+	Shader pointShadowShader("Shaders/pointshadow.vs", "Shaders/pointshadow.fs", "Shaders/pointshadow.gs");
+
+	// Every sampler gets its own unit once, a sampler2D and a sampler2DArray may not share one.
+	myShader.use();
+	myShader.setInt("material.diffuse_texture", 0);
+	myShader.setInt("material.specular_texture", 1);
+	myShader.setInt("material.emission_texture", 2);
+	myShader.setInt("material.diffuse_array", 3);
+	myShader.setInt("material.specular_array", 4);
+	myShader.setInt("clusterLights", CLUSTER_LIGHTS_UNIT);
+	myShader.setInt("clusterGrid", CLUSTER_GRID_UNIT);
+	myShader.setInt("clusterIndices", CLUSTER_INDICES_UNIT);
+	myShader.setInt("objectLights", OBJECT_LIGHTS_UNIT);
+	myShader.setInt("shadowMap", SHADOW_MAP_UNIT);
+	myShader.setInt("pointShadowMap", POINT_SHADOW_UNIT);
+	screenLightShader.use();
+	screenLightShader.setInt("shadowMap", SHADOW_MAP_UNIT);
+	screenLightShader.setInt("pointShadowMap", POINT_SHADOW_UNIT);
+	volumeLightShader.use();
+	volumeLightShader.setInt("shadowMap", SHADOW_MAP_UNIT);
+	volumeLightShader.setInt("pointShadowMap", POINT_SHADOW_UNIT);
+	gbufferShader.use();
+	gbufferShader.setInt("material.diffuse_texture", 0);
+	gbufferShader.setInt("material.specular_texture", 1);
+	gbufferShader.setInt("material.emission_texture", 2);
+	gbufferShader.setInt("material.diffuse_array", 3);
+	gbufferShader.setInt("material.specular_array", 4);
 
 	// Setting amount of boxes.
 	std::default_random_engine generator(time(NULL));
@@ -154,33 +262,54 @@ int main(int argc, char* argv[]) {
 	// Create object data
 	geneObejectData();
 
-	// Loading textures
-	floorTexture = loadTexture("Resources/Textures/wood.png");
-	boxTexture = loadTexture("Resources/Textures/container2.png");
-	boxSpecularTexture = loadTexture("Resources/Textures/container2_specular.png");
+	// The depth pre-pass only fetches the positions
+	renderQueue.SetDepthProgram(&depthShader);
+	renderQueue.SetDepthVAO(cubeVAO, cubeDepthVAO);
+	renderQueue.SetDepthVAO(floorVAO, floorDepthVAO);
+	renderQueue.SetDepthVAO(sphereVAO, sphereDepthVAO);
+
+	clusteredLights.Initialize();
+	objectLights.Initialize();
+	deferredRenderer.Initialize(SCR_WIDTH, SCR_HEIGHT, &screenLightShader, &volumeLightShader, &compositeShader, sphereVertices, 8, sphereIndices);
+	hdrRenderer.Initialize(SCR_WIDTH, SCR_HEIGHT, &luminanceShader, &tonemapShader);
+	bloom.Initialize(SCR_WIDTH, SCR_HEIGHT, &bloomDownsampleShader, &bloomUpsampleShader);
+	bloomBenchmark.Initialize(&bloomDownsampleShader, &bloomUpsampleShader);
+	hdrRenderer.SetBloom(&bloom, &bloomBenchmark);
+	gpuTimer.Initialize();
+
+	// The boxes never move, their shadows are cached. The floor only receives shadows.
+	cascadedShadows.Initialize(&shadowShader);
+	cascadedShadows.SetDepthVAO(cubeVAO, cubeDepthVAO);
+	cascadedShadows.SetDepthVAO(sphereVAO, sphereDepthVAO);
+	pointShadows.Initialize(&pointShadowShader);
+	pointShadows.SetDepthVAO(cubeVAO, cubeDepthVAO);
+	for (unsigned int i = 0; i < boxposition.size(); i++) {
+		cascadedShadows.AddStatic(cubeVAO, cubeIndices.size(), glm::translate(glm::mat4(1.0f), glm::vec3(boxposition[i].x, 0.5f, boxposition[i].z)), cubeBounds);
+		pointShadows.AddStatic(cubeVAO, cubeIndices.size(), glm::translate(glm::mat4(1.0f), glm::vec3(boxposition[i].x, 0.5f, boxposition[i].z)), cubeBounds);
+	}
+
+	// Loading textures, same size and format textures share a texture array.
+	// The color textures are sRGB, the specular map is linear.
+	floorTexture = textureArrays.Add("Resources/Textures/wood.png", true);
+	boxTexture = textureArrays.Add("Resources/Textures/container2.png", true);
+	boxSpecularTexture = textureArrays.Add("Resources/Textures/container2_specular.png");
+	textureArrays.Build();
+
+	// Create materials
+	Material floorMaterial(floorTexture);
+	Material boxMaterial(boxTexture, boxSpecularTexture);
+	Material lightBallMaterial;
+	lightBallMaterial.EnableEmission = true;
+	lightBallMaterial.PerDrawColor = true;
+	lightBallMaterial.Shininess = 32.0f;
+
+	// Merge the never-moving floor and boxes into static batches
+	staticBatcher.Add(floorVertices, floorIndices, glm::mat4(1.0f), floorMaterial);
+	for (unsigned int i = 0; i < boxposition.size(); i++) {
+		staticBatcher.Add(cubeVertices, cubeIndices, glm::translate(glm::mat4(1.0f), glm::vec3(boxposition[i].x, 0.5f, boxposition[i].z)), boxMaterial);
+	}
+	staticBatcher.Build();
 
-	// 1. Generate Frame buffer
-	GLuint depthMapFBO;
-	glGenFramebuffers(1, &depthMapFBO);
-	
-	// 2. Generate Depth Texture
-	const GLuint SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
-	GLuint depthMap;
-	glGenFramebuffers(1, &depthMap);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-	// 3. Bind to the Frame buffer
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	
 	// The main loop
 	while (!glfwWindowShouldClose(window)) {
 
@@ -192,6 +321,13 @@ int main(int argc, char* argv[]) {
 		// Process Input (Moving camera)
 		proceessInput(window);
 
+		// Shading happens in linear space, with gamma correction the framebuffer encodes the result to sRGB.
+		if (useGamma) {
+			glEnable(GL_FRAMEBUFFER_SRGB);
+		} else {
+			glDisable(GL_FRAMEBUFFER_SRGB);
+		}
+
 		// Clear the buffer
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -206,95 +342,172 @@ int main(int argc, char* argv[]) {
 		view = camera.GetViewMatrix();
 		projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 250.0f);
 
+		// The benchmark takes over the settings until it is done.
+		if (lightBenchmark.Running) {
+			extraLightCount = lightBenchmark.GetLightCount();
+			useDeferred = lightBenchmark.IsDeferred();
+			useClusteredLighting = true;
+		}
+		if (extraLights.size() != (unsigned int)extraLightCount) {
+			geneExtraLights(extraLightCount);
+		}
+
+		// Point shadows come first, they decide the ShadowSlot of every light.
+		pointShadows.Begin();
+		for (unsigned int i = 0; i < pointLights.size(); i++) {
+			pointShadows.Add(pointLights[i]);
+		}
+		for (unsigned int i = 0; i < extraLights.size(); i++) {
+			pointShadows.Add(extraLights[i]);
+		}
+		pointShadows.Update(projection * view, camera.Position);
+		pointShadows.Bind(myShader);
+		myShader.setBool("usePointShadows", pointShadows.Enabled);
+		pointShadows.Bind(volumeLightShader);
+		volumeLightShader.setBool("usePointShadows", pointShadows.Enabled);
+
 		// Enable Shader and setting view & projection matrix
 		myShader.use();
 		myShader.setMat4("view", view);
 		myShader.setMat4("projection", projection);
 		myShader.setVec3("viewPos", camera.Position);
+		gbufferShader.use();
+		gbufferShader.setMat4("view", view);
+		gbufferShader.setMat4("projection", projection);
+		gbufferShader.setBool("useDiffuseTexture", useDiffuseTexture);
+		gbufferShader.setBool("useSpecularTexture", useSpecularTexture);
+		gbufferShader.setBool("useEmission", useEmission);
+		depthShader.use();
+		depthShader.setMat4("view", view);
+		depthShader.setMat4("projection", projection);
+		myShader.use();
 		myShader.setBool("useBlinnPhong", useBlinnPhong);
 		myShader.setBool("useLighting", useLighting);
 		myShader.setBool("useDiffuseTexture", useDiffuseTexture);
 		myShader.setBool("useSpecularTexture", useSpecularTexture);
 		myShader.setBool("useEmission", useEmission); 
-		myShader.setBool("useGamma", useGamma);
-		myShader.setFloat("GammaValue", GammaValue);
-		
-		myShader.setInt("material.diffuse_texture", 0);
-		myShader.setInt("material.specular_texture", 1);
-		myShader.setInt("material.emission_texture", 2);
-
-		myShader.setVec4("material.ambient", glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
-		myShader.setVec4("material.diffuse", glm::vec4(0.7f, 0.7f, 0.7f, 1.0f));
-		myShader.setVec4("material.specular", glm::vec4(0.4f, 0.4f, 0.4f, 1.0f));
-		myShader.setFloat("material.shininess", 64.0f);
-
-		myShader.setVec3("lights[0].direction", dirLight.Direction);
-		myShader.setVec3("lights[0].ambient", dirLight.Ambient);
-		myShader.setVec3("lights[0].diffuse", dirLight.Diffuse);
-		myShader.setVec3("lights[0].specular", dirLight.Specular);
-		myShader.setBool("lights[0].enable", dirLight.Enable);
-		myShader.setInt("lights[0].caster", dirLight.Caster);
-		
+
+
+		// Every type of light has its own array and loop in the shader, only the enabled lights are sent.
+		myShader.setVec3("dirLights[0].direction", dirLight.Direction);
+		myShader.setVec3("dirLights[0].ambient", dirLight.Ambient);
+		myShader.setVec3("dirLights[0].diffuse", dirLight.Diffuse);
+		myShader.setVec3("dirLights[0].specular", dirLight.Specular);
+		myShader.setInt("dirLights[0].caster", dirLight.Caster);
+		myShader.setInt("numDirLights", dirLight.Enable ? 1 : 0);
+
+		int pointLightCount = 0;
 		for (unsigned int i = 0; i < pointLights.size(); i++) {
-			myShader.setVec3("lights[" + to_string(i) + "].position", pointLights[i].Position);
-			myShader.setVec3("lights[" + to_string(i) + "].ambient", pointLights[i].Ambient);
-			myShader.setVec3("lights[" + to_string(i) + "].diffuse", pointLights[i].Diffuse);
-			myShader.setVec3("lights[" + to_string(i) + "].specular", pointLights[i].Specular);
-			myShader.setFloat("lights[" + to_string(i) + "].constant", pointLights[i].Constant);
-			myShader.setFloat("lights[" + to_string(i) + "].linear", pointLights[i].Linear);
-			myShader.setFloat("lights[" + to_string(i) + "].quadratic", pointLights[i].Quadratic);
-			myShader.setFloat("lights[" + to_string(i) + "].enable", pointLights[i].Enable);
-			myShader.setInt("lights[" + to_string(i) + "].caster", pointLights[i].Caster);
+			if (!pointLights[i].Enable) {
+				continue;
+			}
+			std::string name = "pointLights[" + to_string(pointLightCount) + "]";
+			myShader.setVec3(name + ".position", pointLights[i].Position);
+			myShader.setVec3(name + ".ambient", pointLights[i].Ambient);
+			myShader.setVec3(name + ".diffuse", pointLights[i].Diffuse);
+			myShader.setVec3(name + ".specular", pointLights[i].Specular);
+			myShader.setFloat(name + ".constant", pointLights[i].Constant);
+			myShader.setFloat(name + ".linear", pointLights[i].Linear);
+			myShader.setFloat(name + ".quadratic", pointLights[i].Quadratic);
+			myShader.setInt(name + ".caster", pointLights[i].Caster);
+			myShader.setInt(name + ".shadow", pointLights[i].ShadowSlot);
+			pointLightCount++;
 		}
 
 		spotLight.Position = camera.Position;
 		spotLight.Direction = camera.Front;
 
-		myShader.setVec3("lights[5].position", spotLight.Position);
-		myShader.setVec3("lights[5].direction", spotLight.Direction);
-		myShader.setVec3("lights[5].ambient", spotLight.Ambient);
-		myShader.setVec3("lights[5].diffuse", spotLight.Diffuse);
-		myShader.setVec3("lights[5].specular", spotLight.Specular);
-		myShader.setFloat("lights[5].cutoff", glm::cos(glm::radians(spotLight.Cutoff)));
-		myShader.setFloat("lights[5].outerCutoff", glm::cos(glm::radians(spotLight.OuterCutoff)));
-		myShader.setFloat("lights[5].constant", spotLight.Constant);
-		myShader.setFloat("lights[5].linear", spotLight.Linear);
-		myShader.setFloat("lights[5].quadratic", spotLight.Quadratic);
-		myShader.setBool("lights[5].enable", spotLight.Enable);
-		myShader.setInt("lights[5].caster", spotLight.Caster);
-
-		// Draw Floor
-		myShader.setBool("material.enableColorTexture", true);
-		myShader.setBool("material.enableSpecularTexture", false);
-		myShader.setBool("material.enableEmission", false);
-		myShader.setBool("material.enableEmissionTexture", false);
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, floorTexture);
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, NULL);
-		myShader.setFloat("material.shininess", 64.0f);
-		myShader.setMat4("model", modelMatrix.top());
-		drawFloor();
-
-		// Draw boxes
-		myShader.setBool("material.enableColorTexture", true);
-		myShader.setBool("material.enableSpecularTexture", true);
-		myShader.setBool("material.enableEmission", false);
-		myShader.setBool("material.enableEmissionTexture", false);
-		modelMatrix.push();
-			for (unsigned int i = 0; i < boxposition.size(); i++) {
-				modelMatrix.push();
-					modelMatrix.save(glm::translate(modelMatrix.top(), glm::vec3(boxposition[i].x, 0.5f, boxposition[i].z)));
-					myShader.setFloat("material.shininess", 64.0f);
-					myShader.setMat4("model", modelMatrix.top());
-					drawBox();
-				modelMatrix.pop();
+		myShader.setVec3("spotLights[0].position", spotLight.Position);
+		myShader.setVec3("spotLights[0].direction", spotLight.Direction);
+		myShader.setVec3("spotLights[0].ambient", spotLight.Ambient);
+		myShader.setVec3("spotLights[0].diffuse", spotLight.Diffuse);
+		myShader.setVec3("spotLights[0].specular", spotLight.Specular);
+		myShader.setFloat("spotLights[0].cutoff", glm::cos(glm::radians(spotLight.Cutoff)));
+		myShader.setFloat("spotLights[0].outerCutoff", glm::cos(glm::radians(spotLight.OuterCutoff)));
+		myShader.setFloat("spotLights[0].constant", spotLight.Constant);
+		myShader.setFloat("spotLights[0].linear", spotLight.Linear);
+		myShader.setFloat("spotLights[0].quadratic", spotLight.Quadratic);
+		myShader.setInt("spotLights[0].caster", spotLight.Caster);
+		myShader.setInt("numSpotLights", spotLight.Enable ? 1 : 0);
+
+		// Clustered lighting takes over all point lights, the extra ones included.
+		bool clustersBound = false;
+		if (useClusteredLighting && !useDeferred) {
+			clusteredLights.Begin();
+			for (unsigned int i = 0; i < pointLights.size(); i++) {
+				clusteredLights.Add(pointLights[i]);
+			}
+			for (unsigned int i = 0; i < extraLights.size(); i++) {
+				clusteredLights.Add(extraLights[i]);
 			}
-		modelMatrix.pop();
+			clusteredLights.Update(view, projection, 0.1f, 250.0f, &threadPool);
+			clustersBound = clusteredLights.Bind(myShader, SCR_WIDTH, SCR_HEIGHT);
+		}
+		// Otherwise each object gets the few point lights reaching it, picked after culling.
+		bool objectLightsBound = false;
+		if (useObjectLights && !clustersBound && !useDeferred) {
+			objectLights.Begin();
+			for (unsigned int i = 0; i < pointLights.size(); i++) {
+				objectLights.Add(pointLights[i]);
+			}
+			for (unsigned int i = 0; i < extraLights.size(); i++) {
+				objectLights.Add(extraLights[i]);
+			}
+			objectLights.Upload();
+			objectLightsBound = objectLights.Bind(myShader);
+		}
+		// Shadows of the direction light, the light balls are the moving casters.
+		bool shadowsBound = useShadows && dirLight.Enable;
+		if (shadowsBound) {
+			cascadedShadows.Update(camera.Position, camera.Front, camera.Zoom, (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, dirLight.Direction);
+			cascadedShadows.Begin();
+			for (unsigned int i = 0; i < pointLights.size(); i++) {
+				if (!pointLights[i].Enable) {
+					continue;
+				}
+				glm::mat4 ball = glm::scale(glm::translate(glm::mat4(1.0f), pointLights[i].Position), glm::vec3(0.5f));
+				cascadedShadows.Add(sphereVAO, sphereIndices.size(), ball, sphereBounds);
+			}
+			cascadedShadows.Render();
+			cascadedShadows.Bind(myShader);
+			cascadedShadows.Bind(screenLightShader);
+		}
+		screenLightShader.use();
+		screenLightShader.setBool("useShadows", shadowsBound);
 
-		// draw light ball
-		myShader.setBool("material.enableColorTexture", false);
-		myShader.setBool("material.enableEmission", true);
+		myShader.use();
+		myShader.setBool("useClusters", clustersBound);
+		myShader.setBool("useObjectLights", objectLightsBound);
+		myShader.setInt("numPointLights", clustersBound || objectLightsBound ? 0 : pointLightCount);
+		myShader.setBool("useReferenceLighting", kernelComparison.Running ? kernelComparison.UseReference() : useReferenceLighting);
+		myShader.setBool("useShadows", shadowsBound);
+
+		// The scene is drawn with the G-buffer shader instead, the lights come after.
+		Shader& sceneShader = useDeferred ? gbufferShader : myShader;
+
+		// Submit draws to the render queue, they will be culled and sorted before drawing.
+		frustum.Update(projection * view);
+		frustum.ResetStats();
+		renderQueue.Begin(camera.Position, camera.Front);
+
+		if (useStaticBatching) {
+			staticBatcher.Submit(renderQueue, sceneShader);
+		} else {
+			// Floor
+			renderQueue.Submit(floorVAO, floorIndices.size(), sceneShader, floorMaterial, modelMatrix.top(), floorBounds);
+
+			// Boxes
+			modelMatrix.push();
+				for (unsigned int i = 0; i < boxposition.size(); i++) {
+					modelMatrix.push();
+						modelMatrix.save(glm::translate(modelMatrix.top(), glm::vec3(boxposition[i].x, 0.5f, boxposition[i].z)));
+						renderQueue.Submit(cubeVAO, cubeIndices.size(), sceneShader, boxMaterial, modelMatrix.top(), cubeBounds);
+					modelMatrix.pop();
+				}
+			modelMatrix.pop();
+		}
+
+		// Light balls
 		for (unsigned int i = 0; i < pointLights.size(); i++) {
 			if (!pointLights[i].Enable) {
 				continue;
@@ -302,33 +515,117 @@ int main(int argc, char* argv[]) {
 			modelMatrix.push();
 				modelMatrix.save(glm::translate(modelMatrix.top(), pointLights[i].Position));
 				modelMatrix.save(glm::scale(modelMatrix.top(), glm::vec3(0.5f)));
-				myShader.setVec4("material.diffuse", glm::vec4(pointLights[i].Diffuse.x, pointLights[i].Diffuse.y, pointLights[i].Diffuse.z, 1.0f));
-				myShader.setVec4("material.specular", glm::vec4(pointLights[i].Specular.x, pointLights[i].Specular.y, pointLights[i].Specular.z, 1.0f));
-				myShader.setFloat("material.shininess", 32.0f);
-				myShader.setMat4("model", modelMatrix.top());
-				drawSphere();
+				renderQueue.Submit(sphereVAO, sphereIndices.size(), sceneShader, lightBallMaterial, modelMatrix.top(), sphereBounds, glm::vec4(pointLights[i].Diffuse, 1.0f), glm::vec4(pointLights[i].Specular, 1.0f));
 			modelMatrix.pop();
 		}
-		myShader.setBool("material.enableEmission", false);
+		if (clustersBound || objectLightsBound || useDeferred) {
+			for (unsigned int i = 0; i < extraLights.size(); i++) {
+				modelMatrix.push();
+					modelMatrix.save(glm::translate(modelMatrix.top(), extraLights[i].Position));
+					modelMatrix.save(glm::scale(modelMatrix.top(), glm::vec3(0.1f)));
+					renderQueue.Submit(sphereVAO, sphereIndices.size(), sceneShader, lightBallMaterial, modelMatrix.top(), sphereBounds, glm::vec4(extraLights[i].Diffuse, 1.0f), glm::vec4(extraLights[i].Specular, 1.0f));
+				modelMatrix.pop();
+			}
+		}
+
+		if (useFrustumCulling) {
+			renderQueue.Cull(frustum);
+		}
+		if (objectLightsBound) {
+			renderQueue.AssignLights(objectLights);
+		}
+		renderQueue.Sort();
+		renderQueue.DepthPrepass = useDepthPrepass;
+		// The shadow maps are done, the scene itself goes into the HDR target.
+		if (useHDR) {
+			hdrRenderer.Begin(glm::vec4(0.1f, 0.1f, 0.1f, 1.0f));
+		}
+		gpuTimer.Begin();
+		if (useDeferred) {
+			deferredRenderer.BeginGeometry();
+			renderQueue.Flush();
+			deferredRenderer.EndGeometry();
+
+			deferredRenderer.BeginLights();
+			deferredRenderer.Add(dirLight);
+			deferredRenderer.Add(spotLight);
+			for (unsigned int i = 0; i < pointLights.size(); i++) {
+				deferredRenderer.Add(pointLights[i]);
+			}
+			for (unsigned int i = 0; i < extraLights.size(); i++) {
+				deferredRenderer.Add(extraLights[i]);
+			}
+			screenLightShader.use();
+			screenLightShader.setBool("useBlinnPhong", useBlinnPhong);
+			volumeLightShader.use();
+			volumeLightShader.setBool("useBlinnPhong", useBlinnPhong);
+			deferredRenderer.Shade(view, projection, camera.Position);
+
+			compositeShader.use();
+			compositeShader.setBool("useLighting", useLighting);
 
-		// render on the screen
+			deferredRenderer.Composite();
+		} else {
+			renderQueue.Flush();
+		}
+		gpuTimer.End();
+		if (useHDR) {
+			// The exposure holds still while the kernels are compared, or the images would differ.
+			hdrRenderer.End(kernelComparison.Running ? 0.0f : deltaTime);
+		}
+		// Before the UI is drawn over the scene
+		kernelComparison.Capture(SCR_WIDTH, SCR_HEIGHT);
+		clusteredLights.EndFrame();
+		objectLights.EndFrame();
+		if (gpuTimer.Poll()) {
+			bool benchmarking = lightBenchmark.Running;
+			lightBenchmark.AddSample(gpuTimer.Milliseconds);
+			kernelComparison.AddSample(gpuTimer.Milliseconds);
+			if (benchmarking && !lightBenchmark.Running) {
+				extraLightCount = benchmarkExtraLightCount;
+				useDeferred = benchmarkDeferred;
+				useClusteredLighting = benchmarkClustered;
+			}
+		}
+
+		// render on the screen, the UI colors are already sRGB
+		glDisable(GL_FRAMEBUFFER_SRGB);
 		ImGui::Render();
 		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
+	staticBatcher.Clear();
+	clusteredLights.Release();
+	objectLights.Release();
+	deferredRenderer.Release();
+	hdrRenderer.Release();
+	bloom.Release();
+	bloomBenchmark.Release();
+	cascadedShadows.Release();
+	pointShadows.Release();
+	gpuTimer.Release();
+	renderQueue.Release();
+	textureArrays.Clear();
+
 	glDeleteVertexArrays(1, &cubeVAO);
 	glDeleteBuffers(1, &cubeVBO);
 	glDeleteBuffers(1, &cubeEBO);
+	glDeleteVertexArrays(1, &cubeDepthVAO);
+	glDeleteBuffers(1, &cubeDepthVBO);
 
 	glDeleteVertexArrays(1, &floorVAO);
 	glDeleteBuffers(1, &floorVBO);
 	glDeleteBuffers(1, &floorEBO);
+	glDeleteVertexArrays(1, &floorDepthVAO);
+	glDeleteBuffers(1, &floorDepthVBO);
 	
 	glDeleteVertexArrays(1, &sphereVAO);
 	glDeleteBuffers(1, &sphereVBO);
 	glDeleteBuffers(1, &sphereEBO);
+	glDeleteVertexArrays(1, &sphereDepthVAO);
+	glDeleteBuffers(1, &sphereDepthVBO);
 
 	// clean up
 	ImGui_ImplOpenGL3_Shutdown();
@@ -381,8 +678,47 @@ void showUI() {
 			ImGui::Checkbox("DiffuseTexture", &useDiffuseTexture);
 			ImGui::Checkbox("SpecularTexture", &useSpecularTexture);
 			ImGui::Checkbox("Emission", &useEmission);
-			ImGui::Checkbox("Gamma Correction", &useGamma);
-			ImGui::SliderFloat("Gamma Value", &GammaValue, 1.0f / 2.2f, 2.2f);
+			ImGui::Checkbox("Gamma Correction (sRGB)", &useGamma);
+			ImGui::Checkbox("HDR", &useHDR);
+			if (useHDR) {
+				ImGui::Checkbox("Auto Exposure", &hdrRenderer.AutoExposure);
+				ImGui::SliderFloat("Exposure Bias (EV)", &hdrRenderer.ExposureBias, -4.0f, 4.0f);
+				ImGui::SliderFloat("Adaptation Speed", &hdrRenderer.AdaptationSpeed, 0.1f, 10.0f);
+				ImGui::Text("Exposure: %.3f", hdrRenderer.Exposure);
+				ImGui::Text("Average luminance: %.4f (%d frames old)", hdrRenderer.AverageLuminance, hdrRenderer.ReadbackLatency);
+				ImGui::Checkbox("Bloom", &bloom.Enabled);
+				if (bloom.Enabled) {
+					ImGui::SliderInt("Bloom Mips", &bloom.Mips, 1, BLOOM_MAX_MIPS);
+					ImGui::SliderFloat("Bloom Strength", &bloom.Strength, 0.0f, 0.5f);
+					ImGui::SliderFloat("Bloom Filter Radius", &bloom.FilterRadius, 0.5f, 3.0f);
+					ImGui::Text("Bloom GPU time: %.3f ms (%d levels)", bloom.Timer.Milliseconds, bloom.GetMipCount());
+				}
+
+				// The chain at 1080p and 4K for every number of mips, whatever the window size
+				if (bloomBenchmark.Running) {
+					ImGui::ProgressBar(bloomBenchmark.GetProgress());
+				} else if (ImGui::Button("Measure Bloom")) {
+					std::vector<glm::uvec2> sizes = { glm::uvec2(1920, 1080), glm::uvec2(3840, 2160) };
+					bloomBenchmark.Start(sizes);
+				}
+				for (unsigned int i = 0; i < bloomBenchmark.Results.size(); i++) {
+					const BloomResult& result = bloomBenchmark.Results[i];
+					ImGui::Text("%dx%d, %d mips: %.3f ms%s", result.Width, result.Height, result.Mips, result.Milliseconds, result.Mips == bloom.Mips ? " (current)" : "");
+				}
+			}
+			ImGui::Spacing();
+
+			// The per-type loops against the reference kernel, forward shading only
+			ImGui::Checkbox("Reference Lighting Kernel", &useReferenceLighting);
+			if (kernelComparison.Running) {
+				ImGui::ProgressBar(kernelComparison.GetProgress());
+			} else if (ImGui::Button("Compare Kernels")) {
+				kernelComparison.Start();
+			}
+			if (kernelComparison.HasResult) {
+				ImGui::Text("Image difference: %d at most, %d of %d pixels", kernelComparison.MaxDifference, kernelComparison.DifferentPixels, kernelComparison.Pixels);
+				ImGui::Text("Reference: %.3f ms, per-type: %.3f ms", kernelComparison.ReferenceMs, kernelComparison.TypedMs);
+			}
 			ImGui::Spacing();
 
 			if (ImGui::TreeNode("Direction Light")) {
@@ -441,6 +777,82 @@ void showUI() {
 
 			ImGui::EndTabItem();
 		}
+		if (ImGui::BeginTabItem("Render Queue")) {
+			ImGui::Checkbox("Static Batching", &useStaticBatching);
+			ImGui::Text("Static objects: %d in %d chunks", staticBatcher.ObjectCount, (int)staticBatcher.Chunks.size());
+			ImGui::Text("Textures: %d in %d texture arrays", textureArrays.GetLayerCount(), textureArrays.GetArrayCount());
+			ImGui::Text("Packets: %d", (int)renderQueue.Packets.size());
+			ImGui::Checkbox("Frustum Culling", &useFrustumCulling);
+			ImGui::Text("Culling: %d tested, %d visible", frustum.Tested, frustum.Visible);
+			ImGui::Checkbox("Depth Pre-pass", &useDepthPrepass);
+			ImGui::Text("Draw calls: %d (%d instances)", renderQueue.DrawCalls, renderQueue.Instances);
+			ImGui::Text("Depth draw calls: %d", renderQueue.DepthDrawCalls);
+			ImGui::Text("Program changes: %d", renderQueue.ProgramChanges);
+			ImGui::Text("Material changes: %d", renderQueue.MaterialChanges);
+			ImGui::Text("Mesh changes: %d", renderQueue.MeshChanges);
+			ImGui::Text("Instance stream stalls: %d", renderQueue.GetStreamStalls());
+			ImGui::EndTabItem();
+		}
+		if (ImGui::BeginTabItem("Clustered Lights")) {
+			ImGui::Checkbox("Clustered Lighting", &useClusteredLighting);
+			ImGui::SliderInt("Extra lights", &extraLightCount, 0, 2048);
+			ImGui::Text("Clusters: %d x %d x %d", CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+			ImGui::Text("Point lights: %d", clusteredLights.LightCount);
+			ImGui::Text("Light indices: %d (max %d per cluster)", clusteredLights.IndexCount, clusteredLights.MaxPerCluster);
+			ImGui::Text("Assignment: %.3f ms on %d threads", clusteredLights.AssignTime, threadPool.GetThreadCount());
+			ImGui::Spacing();
+
+			// Used when clustered lighting is off
+			ImGui::Checkbox("Per-Object Light Lists", &useObjectLights);
+			ImGui::Text("Lights per object: %d at most", OBJECT_LIGHTS);
+			if (objectLights.Objects > 0) {
+				ImGui::Text("Objects: %d, %.2f lights each", objectLights.Objects, (float)objectLights.Assigned / objectLights.Objects);
+				ImGui::Text("Lights tested: %.1f per object, %d left out", (float)objectLights.Tested / objectLights.Objects, objectLights.Dropped);
+			}
+			ImGui::Text("Selection: %.3f ms", objectLights.SelectTime);
+			ImGui::EndTabItem();
+		}
+		if (ImGui::BeginTabItem("Shadows")) {
+			ImGui::Checkbox("Shadows", &useShadows);
+			ImGui::Checkbox("Cache Static Casters", &cascadedShadows.CacheStatic);
+			ImGui::SliderFloat("Distance", &cascadedShadows.Distance, 10.0f, 250.0f);
+			ImGui::SliderFloat("Split Lambda", &cascadedShadows.SplitLambda, 0.0f, 1.0f);
+			for (unsigned int i = 0; i < CASCADE_COUNT; i++) {
+				ImGui::Text("Cascade %d: radius %.2f, %d casters", i, cascadedShadows.GetRadius(i), cascadedShadows.GetCasters(i));
+			}
+			ImGui::Text("Static re-renders: %d", cascadedShadows.StaticRenders);
+			ImGui::Text("Draw calls: %d", cascadedShadows.DrawCalls);
+			ImGui::Spacing();
+
+			ImGui::Checkbox("Point Shadows", &pointShadows.Enabled);
+			ImGui::SliderInt("Cubes per frame", &pointShadows.Budget, 0, POINT_SHADOW_MAX_UPDATES);
+			ImGui::Text("Lights in view: %d for %d slots", pointShadows.Candidates, POINT_SHADOW_SLOTS);
+			ImGui::Text("Cubes drawn: %d (%d waiting)", pointShadows.Updates, pointShadows.Pending);
+			ImGui::Text("Point shadow draw calls: %d", pointShadows.DrawCalls);
+			ImGui::EndTabItem();
+		}
+		if (ImGui::BeginTabItem("Deferred")) {
+			ImGui::Checkbox("Deferred Shading", &useDeferred);
+			ImGui::Text("Light volumes: %d", deferredRenderer.LightVolumes);
+			ImGui::Text("GPU time: %.3f ms", gpuTimer.Milliseconds);
+			ImGui::Spacing();
+
+			// Clustered forward against deferred, both with the extra lights
+			if (lightBenchmark.Running) {
+				ImGui::ProgressBar(lightBenchmark.GetProgress());
+			} else if (ImGui::Button("Run Benchmark")) {
+				std::vector<unsigned int> counts = { 0, 64, 128, 256, 512, 1024, 2048 };
+				benchmarkExtraLightCount = extraLightCount;
+				benchmarkDeferred = useDeferred;
+				benchmarkClustered = useClusteredLighting;
+				lightBenchmark.Start(counts);
+			}
+			for (unsigned int i = 0; i < lightBenchmark.Results.size(); i++) {
+				const BenchmarkResult& result = lightBenchmark.Results[i];
+				ImGui::Text("%4d lights: forward %.3f ms, deferred %.3f ms", result.Lights, result.ForwardMs, result.DeferredMs);
+			}
+			ImGui::EndTabItem();
+		}
 		ImGui::EndTabBar();
 	}
 	ImGui::Spacing();
@@ -501,6 +913,7 @@ void geneObejectData() {
 		20, 21, 23,
 		21, 22, 23,
 	};
+	cubeBounds = AABB::FromVertices(cubeVertices, 8);
 	glGenVertexArrays(1, &cubeVAO);
 	glGenBuffers(1, &cubeVBO);
 	glGenBuffers(1, &cubeEBO);
@@ -516,6 +929,7 @@ void geneObejectData() {
 		glEnableVertexAttribArray(2);
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 	glBindVertexArray(0);
+	cubeDepthVAO = genePositionVAO(cubeVertices, 8, cubeEBO, cubeDepthVBO);
 	// ==================================================
 
 
@@ -531,6 +945,7 @@ void geneObejectData() {
 		0, 1, 2,
 		0, 2, 3,
 	};
+	floorBounds = AABB::FromVertices(floorVertices, 8);
 	glGenVertexArrays(1, &floorVAO);
 	glGenBuffers(1, &floorVBO);
 	glGenBuffers(1, &floorEBO);
@@ -546,6 +961,7 @@ void geneObejectData() {
 		glEnableVertexAttribArray(2);
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 	glBindVertexArray(0);
+	floorDepthVAO = genePositionVAO(floorVertices, 8, floorEBO, floorDepthVBO);
 	// ==================================================
 
 	// ========== Generate sphere vertex data ==========
@@ -605,6 +1021,7 @@ void geneSphereData() {
 		}
 	}
 
+	sphereBounds = AABB::FromVertices(sphereVertices, 8);
 	glGenVertexArrays(1, &sphereVAO);
 	glGenBuffers(1, &sphereVBO);
 	glGenBuffers(1, &sphereEBO);
@@ -620,38 +1037,50 @@ void geneSphereData() {
 		glEnableVertexAttribArray(2);
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 	glBindVertexArray(0);
+	sphereDepthVAO = genePositionVAO(sphereVertices, 8, sphereEBO, sphereDepthVBO);
 }
 
-void drawFloor() {
-	modelMatrix.push();
-		glBindVertexArray(floorVAO);
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-	modelMatrix.pop();
-}
-
-void drawCube() {
-	modelMatrix.push();
-		glBindVertexArray(cubeVAO);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-	modelMatrix.pop();
-}
+// Copy the positions out of an interleaved vertex array into their own tightly packed buffer,
+// the VAO shares the index buffer of the full mesh.
+unsigned int genePositionVAO(const std::vector<float>& vertices, unsigned int stride, unsigned int EBO, unsigned int& VBO) {
+	std::vector<float> positions;
+	positions.reserve(vertices.size() / stride * 3);
+	for (unsigned int i = 0; i + stride <= vertices.size(); i += stride) {
+		positions.insert(positions.end(), vertices.begin() + i, vertices.begin() + i + 3);
+	}
 
-void drawSphere() {
-	modelMatrix.push();
-	glBindVertexArray(sphereVAO);
-	glDrawElements(GL_TRIANGLES, sphereIndices.size(), GL_UNSIGNED_INT, 0);
+	unsigned int VAO;
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glBindVertexArray(VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(float), positions.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 	glBindVertexArray(0);
-	modelMatrix.pop();
+	return VAO;
 }
 
-void drawBox() {
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, boxTexture);
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, boxSpecularTexture);
-	drawCube();
+// Scatter small colored point lights over the floor, always the same ones for the same count.
+void geneExtraLights(unsigned int count) {
+	std::default_random_engine generator(1);
+	std::uniform_real_distribution<float> unif_xz(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> unif_y(0.5f, 4.0f);
+	std::uniform_real_distribution<float> unif_color(0.2f, 1.0f);
+
+	extraLights.clear();
+	for (unsigned int i = 0; i < count; i++) {
+		Light light(glm::vec3(unif_xz(generator), unif_y(generator), unif_xz(generator)), true);
+		glm::vec3 color = glm::vec3(unif_color(generator), unif_color(generator), unif_color(generator));
+		light.Ambient = glm::vec3(0.0f);
+		light.Diffuse = color;
+		light.Specular = color * 0.5f;
+		// Reaches about 13 units
+		light.Linear = 0.35f;
+		light.Quadratic = 0.44f;
+		extraLights.push_back(light);
+	}
 }
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
@@ -663,6 +1092,9 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
 	// Reset projection matrix and viewport
 	projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 250.0f);
 	glViewport(0, 0, width, height);
+	deferredRenderer.Resize(width, height);
+	hdrRenderer.Resize(width, height);
+	bloom.Resize(width, height);
 }
 
 void proceessInput(GLFWwindow* window) {
@@ -754,42 +1186,4 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
 // Handle mouse scroll
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
 	camera.ProcessMouseScroll(yoffset);
-}
-
-// Loading Texture
-unsigned int loadTexture(char const* path) {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data) {
-		GLenum format;
-		if (nrComponents == 1) {
-			format = GL_RED;
-		}
-		else if (nrComponents == 3) {
-			format = GL_RGB;
-		}
-		else if (nrComponents == 4) {
-			format = GL_RGBA;
-		}
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_MIRRORED_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_MIRRORED_REPEAT);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else {
-		std::cout << "Failed to load texture at path:" << path << std::endl;
-		stbi_image_free(data);
-	}
-
-	return textureID;
 }
\ No newline at end of file
@@ -0,0 +1,355 @@
+#ifndef ASTEROIDFIELD_H
+#define ASTEROIDFIELD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "model.h"
+#include "frustum.h"
+#include "threadpool.h"
+#include "streambuffer.h"
+#include "impostor.h"
+#include "occlusion.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// Instance attributes of asteroid.vs, right after the Tangent/Bitangent locations of Mesh.
+const unsigned int ASTEROID_ORBIT_LOCATION = 5;
+const unsigned int ASTEROID_ROTATION_LOCATION = 6;
+
+// 32 bytes instead of a 64 bytes matrix, asteroid.vs rebuilds the model matrix.
+// Positions are polar in the belt's own frame, which rotates as a whole (see GetBeltMatrix()).
+struct AsteroidInstance {
+	glm::vec4 Orbit;    // orbit radius, orbit phase, height, scale
+	glm::vec4 Rotation; // rotation axis, rotation angle
+};
+
+// Instances tested by one job, also the granularity of the compaction.
+const unsigned int CULL_GRAIN = 16384;
+
+// Flags of a visible instance
+const unsigned char VISIBLE_MESH = 1;
+const unsigned char VISIBLE_IMPOSTOR = 2;
+
+enum Cull_Mode {
+	CULL_NONE,
+	CULL_SINGLE_THREAD,
+	CULL_MULTI_THREAD,
+	CULL_GPU
+};
+
+// Point the instance attributes of a VAO at buffer, starting offset bytes in.
+inline void BindInstanceAttributes(unsigned int VAO, unsigned int buffer, size_t offset = 0) {
+	glBindVertexArray(VAO);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glEnableVertexAttribArray(ASTEROID_ORBIT_LOCATION);
+	glVertexAttribPointer(ASTEROID_ORBIT_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(AsteroidInstance), (void*)(offset + offsetof(AsteroidInstance, Orbit)));
+	glVertexAttribDivisor(ASTEROID_ORBIT_LOCATION, 1);
+	glEnableVertexAttribArray(ASTEROID_ROTATION_LOCATION);
+	glVertexAttribPointer(ASTEROID_ROTATION_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(AsteroidInstance), (void*)(offset + offsetof(AsteroidInstance, Rotation)));
+	glVertexAttribDivisor(ASTEROID_ROTATION_LOCATION, 1);
+	glBindVertexArray(0);
+}
+
+// Point the instance attributes of every rock mesh at buffer, starting offset bytes in.
+inline void BindInstanceBuffer(Model& rock, unsigned int buffer, size_t offset = 0) {
+	for (unsigned int i = 0; i < rock.meshes.size(); i++) {
+		BindInstanceAttributes(rock.meshes[i].VAO, buffer, offset);
+	}
+}
+
+// Belt frame to world, the same rotation asteroid.vs applies with its time uniform.
+inline glm::mat4 GetBeltMatrix(float time, float orbitSpeed) {
+	return glm::rotate(glm::mat4(1.0f), time * orbitSpeed, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// The asteroid belt. The bounding spheres are kept in separate arrays (SoA) for SIMD tests,
+// the instances stay packed for the upload. Every frame the instances are frustum and
+// distance culled in ranges of CULL_GRAIN, each range counts its survivors, and after a
+// prefix sum the ranges copy their visible instances straight into the mapped stream buffer.
+// With impostors enabled the survivors are split by screen size: the meshes come first in the
+// stream, the impostors after them, and the ones in the cross-fade band are in both.
+// Everything is in the belt's frame, so the frustum and view position must be moved there.
+class AsteroidField {
+public:
+	std::vector<AsteroidInstance> Instances;
+	std::vector<float> CenterX;
+	std::vector<float> CenterY;
+	std::vector<float> CenterZ;
+	std::vector<float> Radius;
+
+	// Number of instances in the buffer, drawn by Draw()
+	unsigned int InstanceCount;
+	// Number of instances drawn by DrawImpostors()
+	unsigned int ImpostorCount;
+
+	// Statistics of the last Cull()
+	unsigned int Tested;
+	unsigned int Visible;
+	unsigned int Occluded;
+	float CullTime;
+
+	AsteroidField() : InstanceCount(0), ImpostorCount(0), Tested(0), Visible(0), Occluded(0), CullTime(0.0f), buffer(0), allUploaded(false), stream(GL_ARRAY_BUFFER), streamOffset(0) {
+
+	}
+
+	unsigned int GetCount() {
+		return Instances.size();
+	}
+
+	void Generate(unsigned int amount, float radius, float offset, const AABB& rockBounds) {
+		Instances.resize(amount);
+		CenterX.resize(amount);
+		CenterY.resize(amount);
+		CenterZ.resize(amount);
+		Radius.resize(amount);
+		visibility.resize(amount);
+
+		glm::vec3 rockCenter = rockBounds.Center();
+		float rockRadius = rockBounds.Radius();
+		glm::vec3 axis = glm::normalize(glm::vec3(0.4f, 0.6f, 0.8f));
+		for (unsigned int i = 0; i < amount; i++) {
+			float angle = (float)i / (float)amount * 360.0f;
+			float displancement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+			float x = sin(angle) * radius + displancement;
+			displancement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+			float y = displancement * 0.4f;
+			displancement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
+			float z = cos(angle) * radius + displancement;
+			float scale = (rand() % 20) / 100.0f + 0.05f;
+			float rotAngle = (rand() % 360);
+
+			Instances[i].Orbit = glm::vec4(std::sqrt(x * x + z * z), std::atan2(x, z), y, scale);
+			Instances[i].Rotation = glm::vec4(axis, rotAngle);
+
+			// Same matrix as asteroid.vs builds, for the bounding sphere
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, glm::vec3(x, y, z));
+			model = glm::scale(model, glm::vec3(scale));
+			model = glm::rotate(model, rotAngle, axis);
+			glm::vec3 center = glm::vec3(model * glm::vec4(rockCenter, 1.0f));
+			CenterX[i] = center.x;
+			CenterY[i] = center.y;
+			CenterZ[i] = center.z;
+			Radius[i] = rockRadius * scale;
+		}
+		allUploaded = false;
+	}
+
+	// Upload every instance once, nothing has to be done per frame afterwards.
+	void UploadAll() {
+		if (allUploaded) {
+			return;
+		}
+		if (buffer == 0) {
+			glGenBuffers(1, &buffer);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, Instances.size() * sizeof(AsteroidInstance), Instances.data(), GL_STATIC_DRAW);
+		InstanceCount = Instances.size();
+		ImpostorCount = 0;
+		Tested = 0;
+		Occluded = 0;
+		Visible = InstanceCount;
+		CullTime = 0.0f;
+		allUploaded = true;
+	}
+
+	// Cull against the frustum and drop the rocks further than maxDistance (0 keeps all) or
+	// hidden in the occlusion buffer, then stream the survivors. occlusionViewProjection maps the
+	// belt's frame to clip space. Without a pool everything runs on the calling thread.
+	void Cull(const Frustum& frustum, glm::vec3 viewPosition, float maxDistance, const LodSettings& lod, ThreadPool* pool, const OcclusionBuffer* occlusion = nullptr, const glm::mat4& occlusionViewProjection = glm::mat4(1.0f)) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		unsigned int count = Instances.size();
+		unsigned int rangeCount = (count + CULL_GRAIN - 1) / CULL_GRAIN;
+		rangeVisible.resize(rangeCount);
+		rangeOccluded.resize(rangeCount);
+		rangeMeshes.resize(rangeCount);
+		rangeImpostors.resize(rangeCount);
+		rangeMeshOffset.resize(rangeCount);
+		rangeImpostorOffset.resize(rangeCount);
+
+		// 1. Test the bounds, then flag each visible instance as mesh, impostor or both.
+		forEachRange(pool, count, [&](unsigned int begin, unsigned int end) {
+			Frustum local = frustum;
+			unsigned int visible = local.CullSpheres(&CenterX[begin], &CenterY[begin], &CenterZ[begin], &Radius[begin], end - begin, &visibility[begin]);
+			unsigned int occluded = 0;
+			unsigned int meshes = 0;
+			unsigned int impostors = 0;
+
+			if (maxDistance > 0.0f || lod.IsEnabled() || occlusion != nullptr) {
+				for (unsigned int i = begin; i < end; i++) {
+					if (!visibility[i]) {
+						continue;
+					}
+					float dx = CenterX[i] - viewPosition.x;
+					float dy = CenterY[i] - viewPosition.y;
+					float dz = CenterZ[i] - viewPosition.z;
+					float distance2 = dx * dx + dy * dy + dz * dz;
+					float limit = maxDistance + Radius[i];
+					if (maxDistance > 0.0f && distance2 > limit * limit) {
+						visibility[i] = 0;
+						visible--;
+						continue;
+					}
+					if (occlusion != nullptr) {
+						glm::vec3 center = glm::vec3(CenterX[i], CenterY[i], CenterZ[i]);
+						if (!occlusion->IsVisible(AABB(center - Radius[i], center + Radius[i]), occlusionViewProjection)) {
+							visibility[i] = 0;
+							visible--;
+							occluded++;
+							continue;
+						}
+					}
+					float screenSize = lod.ScreenSize(Radius[i], std::sqrt(distance2));
+					visibility[i] = (lod.NeedsMesh(screenSize) ? VISIBLE_MESH : 0) | (lod.NeedsImpostor(screenSize) ? VISIBLE_IMPOSTOR : 0);
+					meshes += (visibility[i] & VISIBLE_MESH) != 0;
+					impostors += (visibility[i] & VISIBLE_IMPOSTOR) != 0;
+				}
+			} else {
+				meshes = visible;
+			}
+			rangeVisible[begin / CULL_GRAIN] = visible;
+			rangeOccluded[begin / CULL_GRAIN] = occluded;
+			rangeMeshes[begin / CULL_GRAIN] = meshes;
+			rangeImpostors[begin / CULL_GRAIN] = impostors;
+		});
+
+		// 2. Prefix sums, where each range writes its meshes and its impostors
+		unsigned int visible = 0;
+		unsigned int occluded = 0;
+		unsigned int meshTotal = 0;
+		unsigned int impostorTotal = 0;
+		for (unsigned int i = 0; i < rangeCount; i++) {
+			rangeMeshOffset[i] = meshTotal;
+			rangeImpostorOffset[i] = impostorTotal;
+			visible += rangeVisible[i];
+			occluded += rangeOccluded[i];
+			meshTotal += rangeMeshes[i];
+			impostorTotal += rangeImpostors[i];
+		}
+		unsigned int total = meshTotal + impostorTotal;
+
+		// 3. Take this frame's range of the ring and let the ranges fill it in parallel.
+		// The ring grows with some headroom, so it is rarely recreated while flying around.
+		size_t size = total * sizeof(AsteroidInstance);
+		if (size > stream.GetFrameSize()) {
+			stream.Reserve(size + size / 2);
+		}
+		stream.BeginFrame();
+		if (total > 0) {
+			AsteroidInstance* mapped = (AsteroidInstance*)stream.Map(size, sizeof(AsteroidInstance), &streamOffset);
+			if (mapped != nullptr) {
+				forEachRange(pool, count, [&](unsigned int begin, unsigned int end) {
+					AsteroidInstance* meshOut = mapped + rangeMeshOffset[begin / CULL_GRAIN];
+					AsteroidInstance* impostorOut = mapped + meshTotal + rangeImpostorOffset[begin / CULL_GRAIN];
+					for (unsigned int i = begin; i < end; i++) {
+						if (visibility[i] & VISIBLE_MESH) {
+							*meshOut++ = Instances[i];
+						}
+						if (visibility[i] & VISIBLE_IMPOSTOR) {
+							*impostorOut++ = Instances[i];
+						}
+					}
+				});
+				stream.Unmap();
+			} else {
+				meshTotal = 0;
+				impostorTotal = 0;
+			}
+		}
+
+		InstanceCount = meshTotal;
+		ImpostorCount = impostorTotal;
+		Tested = count;
+		Visible = visible;
+		Occluded = occluded;
+		allUploaded = false;
+
+		auto stop = std::chrono::high_resolution_clock::now();
+		CullTime = std::chrono::duration<float, std::milli>(stop - start).count();
+	}
+
+	// Draw(), DrawImpostors() and then EndFrame() every frame.
+	void Draw(Model& rock) {
+		if (InstanceCount > 0) {
+			// The GPU culling path points the rocks at its own buffers.
+			if (allUploaded) {
+				BindInstanceBuffer(rock, buffer);
+			} else {
+				BindInstanceBuffer(rock, stream.GetBuffer(), streamOffset);
+			}
+			for (unsigned int i = 0; i < rock.meshes.size(); i++) {
+				glBindVertexArray(rock.meshes[i].VAO);
+				glDrawElementsInstanced(GL_TRIANGLES, rock.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, InstanceCount);
+				glBindVertexArray(0);
+			}
+		}
+	}
+
+	// The impostor shader must be in use, with the atlas bound.
+	void DrawImpostors(Impostor& impostor) {
+		if (ImpostorCount == 0 || allUploaded) {
+			return;
+		}
+		BindInstanceAttributes(impostor.GetVAO(), stream.GetBuffer(), streamOffset + InstanceCount * sizeof(AsteroidInstance));
+		impostor.Draw(ImpostorCount);
+	}
+
+	// Fence this frame's range of the ring after the last draw reading it.
+	void EndFrame() {
+		stream.EndFrame();
+	}
+
+	unsigned int GetStreamStalls() {
+		return stream.Stalls;
+	}
+
+	bool IsStreamPersistent() {
+		return stream.IsPersistent();
+	}
+
+	void Release() {
+		if (buffer != 0) {
+			glDeleteBuffers(1, &buffer);
+			buffer = 0;
+		}
+		stream.Release();
+	}
+
+private:
+	// Holds every instance when culling is off
+	unsigned int buffer;
+	bool allUploaded;
+
+	// The culled instances, a new range every frame
+	StreamBuffer stream;
+	size_t streamOffset;
+
+	// VISIBLE_MESH and / or VISIBLE_IMPOSTOR for every instance, 0 when culled
+	std::vector<unsigned char> visibility;
+	std::vector<unsigned int> rangeVisible;
+	std::vector<unsigned int> rangeOccluded;
+	std::vector<unsigned int> rangeMeshes;
+	std::vector<unsigned int> rangeImpostors;
+	std::vector<unsigned int> rangeMeshOffset;
+	std::vector<unsigned int> rangeImpostorOffset;
+
+	void forEachRange(ThreadPool* pool, unsigned int count, const std::function<void(unsigned int, unsigned int)>& func) {
+		if (pool != nullptr) {
+			pool->ParallelFor(count, CULL_GRAIN, func);
+			return;
+		}
+		for (unsigned int begin = 0; begin < count; begin += CULL_GRAIN) {
+			func(begin, std::min(begin + CULL_GRAIN, count));
+		}
+	}
+};
+
+#endif // !ASTEROIDFIELD_H
\ No newline at end of file
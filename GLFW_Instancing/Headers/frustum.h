@@ -0,0 +1,230 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+// Axis aligned bounding box
+struct AABB {
+	glm::vec3 Min;
+	glm::vec3 Max;
+
+	AABB() : Min(INFINITY), Max(-INFINITY) {
+
+	}
+
+	AABB(glm::vec3 min, glm::vec3 max) : Min(min), Max(max) {
+
+	}
+
+	// Bounds of interleaved vertex data, the position must be the first 3 floats of each vertex.
+	static AABB FromVertices(const std::vector<float>& vertices, unsigned int stride) {
+		AABB box;
+		for (unsigned int i = 0; i + 3 <= vertices.size(); i += stride) {
+			box.Expand(glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]));
+		}
+		return box;
+	}
+
+	bool IsValid() const {
+		return Min.x <= Max.x && Min.y <= Max.y && Min.z <= Max.z;
+	}
+
+	void Expand(glm::vec3 point) {
+		Min = glm::min(Min, point);
+		Max = glm::max(Max, point);
+	}
+
+	void Expand(const AABB& other) {
+		Min = glm::min(Min, other.Min);
+		Max = glm::max(Max, other.Max);
+	}
+
+	glm::vec3 Center() const {
+		return (Min + Max) * 0.5f;
+	}
+
+	glm::vec3 Extents() const {
+		return (Max - Min) * 0.5f;
+	}
+
+	// Radius of the sphere around Center() enclosing the box
+	float Radius() const {
+		return glm::length(Extents());
+	}
+
+	// Box enclosing the transformed box, without transforming its 8 corners.
+	AABB Transform(const glm::mat4& model) const {
+		glm::vec3 center = glm::vec3(model * glm::vec4(Center(), 1.0f));
+		glm::vec3 extents = Extents();
+		glm::vec3 worldExtents;
+		for (int i = 0; i < 3; i++) {
+			worldExtents[i] = std::fabs(model[0][i]) * extents.x + std::fabs(model[1][i]) * extents.y + std::fabs(model[2][i]) * extents.z;
+		}
+		return AABB(center - worldExtents, center + worldExtents);
+	}
+};
+
+// The 6 planes of a view frustum, normals point inwards.
+// Bounds are tested in batches of 4 with SSE, the last incomplete batch is tested one by one.
+class Frustum {
+public:
+	// left, right, bottom, top, near, far
+	glm::vec4 Planes[6];
+
+	// Statistics since the last ResetStats()
+	unsigned int Tested;
+	unsigned int Visible;
+
+	Frustum() : Tested(0), Visible(0) {
+		Update(glm::mat4(1.0f));
+	}
+
+	// Extract the planes from projection * view, the bounds must be in world space then.
+	void Update(const glm::mat4& viewProjection) {
+		glm::mat4 m = glm::transpose(viewProjection);
+		Planes[0] = m[3] + m[0];
+		Planes[1] = m[3] - m[0];
+		Planes[2] = m[3] + m[1];
+		Planes[3] = m[3] - m[1];
+		Planes[4] = m[3] + m[2];
+		Planes[5] = m[3] - m[2];
+		for (int i = 0; i < 6; i++) {
+			Planes[i] /= glm::length(glm::vec3(Planes[i]));
+		}
+	}
+
+	void ResetStats() {
+		Tested = 0;
+		Visible = 0;
+	}
+
+	bool IsVisible(glm::vec3 center, float radius) {
+		bool visible = testSphere(center.x, center.y, center.z, radius);
+		Tested++;
+		Visible += visible;
+		return visible;
+	}
+
+	bool IsVisible(const AABB& box) {
+		glm::vec3 center = box.Center();
+		glm::vec3 extents = box.Extents();
+		bool visible = testBox(center.x, center.y, center.z, extents.x, extents.y, extents.z);
+		Tested++;
+		Visible += visible;
+		return visible;
+	}
+
+	// Test count spheres given as separate arrays, visible[i] is set to 1 or 0.
+	// Returns the number of visible spheres.
+	unsigned int CullSpheres(const float* x, const float* y, const float* z, const float* radius, unsigned int count, unsigned char* visible) {
+		unsigned int i = 0;
+		unsigned int result = 0;
+#ifdef FRUSTUM_USE_SSE
+		for (; i + 4 <= count; i += 4) {
+			__m128 cx = _mm_loadu_ps(x + i);
+			__m128 cy = _mm_loadu_ps(y + i);
+			__m128 cz = _mm_loadu_ps(z + i);
+			__m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+			__m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+			for (int p = 0; p < 6; p++) {
+				__m128 distance = planeDistance(p, cx, cy, cz);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negRadius));
+			}
+			result += storeMask(_mm_movemask_ps(inside), visible + i);
+		}
+#endif
+		for (; i < count; i++) {
+			visible[i] = testSphere(x[i], y[i], z[i], radius[i]);
+			result += visible[i];
+		}
+
+		Tested += count;
+		Visible += result;
+		return result;
+	}
+
+	// Test count boxes given as centers and extents, visible[i] is set to 1 or 0.
+	// Returns the number of visible boxes.
+	unsigned int CullBoxes(const float* x, const float* y, const float* z, const float* ex, const float* ey, const float* ez, unsigned int count, unsigned char* visible) {
+		unsigned int i = 0;
+		unsigned int result = 0;
+#ifdef FRUSTUM_USE_SSE
+		for (; i + 4 <= count; i += 4) {
+			__m128 cx = _mm_loadu_ps(x + i);
+			__m128 cy = _mm_loadu_ps(y + i);
+			__m128 cz = _mm_loadu_ps(z + i);
+			__m128 extentX = _mm_loadu_ps(ex + i);
+			__m128 extentY = _mm_loadu_ps(ey + i);
+			__m128 extentZ = _mm_loadu_ps(ez + i);
+
+			__m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+			for (int p = 0; p < 6; p++) {
+				// Projected radius of the box onto the plane normal
+				__m128 radius = _mm_add_ps(_mm_add_ps(
+					_mm_mul_ps(extentX, _mm_set1_ps(std::fabs(Planes[p].x))),
+					_mm_mul_ps(extentY, _mm_set1_ps(std::fabs(Planes[p].y)))),
+					_mm_mul_ps(extentZ, _mm_set1_ps(std::fabs(Planes[p].z))));
+				__m128 distance = planeDistance(p, cx, cy, cz);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+			}
+			result += storeMask(_mm_movemask_ps(inside), visible + i);
+		}
+#endif
+		for (; i < count; i++) {
+			visible[i] = testBox(x[i], y[i], z[i], ex[i], ey[i], ez[i]);
+			result += visible[i];
+		}
+
+		Tested += count;
+		Visible += result;
+		return result;
+	}
+
+private:
+	bool testSphere(float x, float y, float z, float radius) const {
+		for (int p = 0; p < 6; p++) {
+			if (Planes[p].x * x + Planes[p].y * y + Planes[p].z * z + Planes[p].w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool testBox(float x, float y, float z, float ex, float ey, float ez) const {
+		for (int p = 0; p < 6; p++) {
+			float radius = std::fabs(Planes[p].x) * ex + std::fabs(Planes[p].y) * ey + std::fabs(Planes[p].z) * ez;
+			if (Planes[p].x * x + Planes[p].y * y + Planes[p].z * z + Planes[p].w + radius < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+#ifdef FRUSTUM_USE_SSE
+	__m128 planeDistance(int p, __m128 x, __m128 y, __m128 z) const {
+		__m128 distance = _mm_mul_ps(x, _mm_set1_ps(Planes[p].x));
+		distance = _mm_add_ps(distance, _mm_mul_ps(y, _mm_set1_ps(Planes[p].y)));
+		distance = _mm_add_ps(distance, _mm_mul_ps(z, _mm_set1_ps(Planes[p].z)));
+		return _mm_add_ps(distance, _mm_set1_ps(Planes[p].w));
+	}
+
+	unsigned int storeMask(int mask, unsigned char* visible) const {
+		visible[0] = (mask & 1) != 0;
+		visible[1] = (mask & 2) != 0;
+		visible[2] = (mask & 4) != 0;
+		visible[3] = (mask & 8) != 0;
+		return visible[0] + visible[1] + visible[2] + visible[3];
+	}
+#endif
+};
+
+#endif // !FRUSTUM_H
\ No newline at end of file
@@ -0,0 +1,200 @@
+#ifndef GPUCULLING_H
+#define GPUCULLING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+#include "model.h"
+#include "frustum.h"
+#include "asteroidfield.h"
+
+#include <vector>
+
+// Transform feedback outputs in the ring, one drawn, the others culled into and waiting for their query
+const unsigned int GPU_CULL_BUFFERS = 3;
+
+// Culls the asteroid instances on the GPU: a points draw with rasterization disabled runs
+// Shaders/cull.vs over every instance, and Shaders/cull.gs emits only the visible ones into
+// a transform feedback buffer, which is then used as the instance buffer of the rocks.
+//
+// GL 3.3 cannot draw with the transform feedback count (glDrawTransformFeedbackInstanced is 4.2),
+// so the count comes from a GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN query. To never wait on it
+// the output goes round GPU_CULL_BUFFERS buffers: the newest cull whose query result is available
+// is drawn, and the next cull goes into the oldest of the others, never into the one being drawn.
+// While no new result is available the last one is drawn again, a frame or two behind the view.
+class GpuCuller {
+public:
+	// Number of instances drawn by Draw()
+	unsigned int InstanceCount;
+
+	// Statistics of the last finished cull
+	unsigned int Tested;
+	unsigned int Visible;
+
+	GpuCuller() : InstanceCount(0), Tested(0), Visible(0), count(0), capacity(0), sourceBuffer(0), cullVAO(0), culls(0), drawn(-1) {
+		for (unsigned int i = 0; i < GPU_CULL_BUFFERS; i++) {
+			outputBuffers[i] = 0;
+			queries[i] = 0;
+			pending[i] = false;
+			tested[i] = 0;
+			serials[i] = 0;
+		}
+	}
+
+	// Upload the instances the culling reads from, call again after the field was regenerated.
+	void Upload(const std::vector<AsteroidInstance>& instances) {
+		if (sourceBuffer == 0) {
+			glGenBuffers(1, &sourceBuffer);
+			glGenBuffers(GPU_CULL_BUFFERS, outputBuffers);
+			glGenQueries(GPU_CULL_BUFFERS, queries);
+
+			glGenVertexArrays(1, &cullVAO);
+			glBindVertexArray(cullVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, sourceBuffer);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(AsteroidInstance), (void*)offsetof(AsteroidInstance, Orbit));
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(AsteroidInstance), (void*)offsetof(AsteroidInstance, Rotation));
+			glBindVertexArray(0);
+		}
+
+		count = instances.size();
+		glBindBuffer(GL_ARRAY_BUFFER, sourceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, count * sizeof(AsteroidInstance), instances.data(), GL_STATIC_DRAW);
+
+		// Written and read by the GPU only
+		if (capacity < count) {
+			capacity = count;
+			for (unsigned int i = 0; i < GPU_CULL_BUFFERS; i++) {
+				glBindBuffer(GL_ARRAY_BUFFER, outputBuffers[i]);
+				glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(AsteroidInstance), NULL, GL_DYNAMIC_COPY);
+			}
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		// Results culled from the old instances are meaningless now.
+		DiscardResults();
+	}
+
+	// The frustum and view position must be in the belt's frame, like for AsteroidField::Cull().
+	void Cull(Shader& cullShader, const Frustum& frustum, glm::vec3 viewPosition, float maxDistance, const AABB& rockBounds) {
+		if (count == 0) {
+			return;
+		}
+
+		poll();
+
+		// Into the oldest buffer that isn't drawn. Should its query still be pending the GPU is
+		// that far behind, its result is dropped.
+		int target = -1;
+		for (unsigned int i = 0; i < GPU_CULL_BUFFERS; i++) {
+			if ((int)i != drawn && (target < 0 || serials[i] < serials[target])) {
+				target = i;
+			}
+		}
+
+		cullShader.use();
+		glUniform4fv(glGetUniformLocation(cullShader.ID, "planes"), 6, &frustum.Planes[0][0]);
+		cullShader.setVec4("bounds", glm::vec4(rockBounds.Center(), rockBounds.Radius()));
+		cullShader.setVec3("viewPos", viewPosition);
+		cullShader.setFloat("maxDistance", maxDistance);
+
+		glEnable(GL_RASTERIZER_DISCARD);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, outputBuffers[target]);
+		glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, queries[target]);
+		glBeginTransformFeedback(GL_POINTS);
+			glBindVertexArray(cullVAO);
+			glDrawArrays(GL_POINTS, 0, count);
+			glBindVertexArray(0);
+		glEndTransformFeedback();
+		glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+		glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+		glDisable(GL_RASTERIZER_DISCARD);
+
+		pending[target] = true;
+		tested[target] = count;
+		serials[target] = ++culls;
+	}
+
+	void Draw(Model& rock) {
+		if (InstanceCount == 0 || drawn < 0) {
+			return;
+		}
+		BindInstanceBuffer(rock, outputBuffers[drawn]);
+		for (unsigned int i = 0; i < rock.meshes.size(); i++) {
+			glBindVertexArray(rock.meshes[i].VAO);
+			glDrawElementsInstanced(GL_TRIANGLES, rock.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, InstanceCount);
+			glBindVertexArray(0);
+		}
+	}
+
+	// Forget the culled results, e.g. after drawing with another path for a while. The queries
+	// still in flight are not read, they are simply begun again by later culls.
+	void DiscardResults() {
+		for (unsigned int i = 0; i < GPU_CULL_BUFFERS; i++) {
+			pending[i] = false;
+		}
+		InstanceCount = 0;
+		Tested = 0;
+		Visible = 0;
+		drawn = -1;
+	}
+
+	void Release() {
+		if (sourceBuffer != 0) {
+			glDeleteBuffers(1, &sourceBuffer);
+			glDeleteBuffers(GPU_CULL_BUFFERS, outputBuffers);
+			glDeleteQueries(GPU_CULL_BUFFERS, queries);
+			glDeleteVertexArrays(1, &cullVAO);
+			sourceBuffer = 0;
+		}
+	}
+
+private:
+	unsigned int count;
+	unsigned int capacity;
+	unsigned int sourceBuffer;
+	unsigned int outputBuffers[GPU_CULL_BUFFERS];
+	unsigned int queries[GPU_CULL_BUFFERS];
+	bool pending[GPU_CULL_BUFFERS];
+	unsigned int tested[GPU_CULL_BUFFERS];
+	// Order of the culls, the newest has the largest
+	unsigned int serials[GPU_CULL_BUFFERS];
+	unsigned int cullVAO;
+	unsigned int culls;
+	int drawn;
+
+	// Draw the newest cull whose count is available, without waiting for any.
+	void poll() {
+		int newest = -1;
+		for (unsigned int i = 0; i < GPU_CULL_BUFFERS; i++) {
+			if (!pending[i] || (newest >= 0 && serials[i] < serials[newest])) {
+				continue;
+			}
+			GLuint available = GL_FALSE;
+			glGetQueryObjectuiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (available == GL_TRUE) {
+				newest = i;
+			}
+		}
+		if (newest < 0) {
+			return;
+		}
+
+		GLuint written = 0;
+		glGetQueryObjectuiv(queries[newest], GL_QUERY_RESULT, &written);
+		// Older culls are superseded, they are never drawn.
+		for (unsigned int i = 0; i < GPU_CULL_BUFFERS; i++) {
+			if (pending[i] && serials[i] <= serials[newest]) {
+				pending[i] = false;
+			}
+		}
+		InstanceCount = written;
+		Tested = tested[newest];
+		Visible = written;
+		drawn = newest;
+	}
+};
+
+#endif // !GPUCULLING_H
\ No newline at end of file
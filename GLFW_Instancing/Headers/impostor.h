@@ -0,0 +1,216 @@
+#ifndef IMPOSTOR_H
+#define IMPOSTOR_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "model.h"
+#include "shader.h"
+#include "frustum.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// Direction to a point in [0, 1]^2 of the octahedral map (y is up, the lower half is folded
+// onto the corners). Must match octDecode() in Shaders/impostor.vs.
+inline glm::vec3 OctahedronDecode(glm::vec2 uv) {
+	glm::vec2 p = uv * 2.0f - 1.0f;
+	glm::vec3 n = glm::vec3(p.x, 1.0f - std::fabs(p.x) - std::fabs(p.y), p.y);
+	if (n.y < 0.0f) {
+		float x = (1.0f - std::fabs(n.z)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+		float z = (1.0f - std::fabs(n.x)) * (n.z >= 0.0f ? 1.0f : -1.0f);
+		n.x = x;
+		n.z = z;
+	}
+	return glm::normalize(n);
+}
+
+// When distant instances switch to impostors. The screen size of an instance is the radius
+// of its bounding sphere in pixels; below Threshold it is an impostor, above
+// Threshold * (1 + Band) a mesh, and in between both are drawn and cross-faded.
+struct LodSettings {
+	// Pixels covered by one unit at a distance of one unit
+	float Scale;
+	// Pixels, 0 disables the impostors
+	float Threshold;
+	// Width of the cross-fade as a fraction of Threshold
+	float Band;
+
+	LodSettings() : Scale(1.0f), Threshold(0.0f), Band(0.5f) {
+
+	}
+
+	static float ScaleFor(float fovY, float screenHeight) {
+		return screenHeight / (2.0f * std::tan(fovY * 0.5f));
+	}
+
+	bool IsEnabled() const {
+		return Threshold > 0.0f;
+	}
+
+	float ScreenSize(float radius, float distance) const {
+		return radius * Scale / std::max(distance, 0.0001f);
+	}
+
+	bool NeedsMesh(float screenSize) const {
+		return !IsEnabled() || screenSize >= Threshold;
+	}
+
+	bool NeedsImpostor(float screenSize) const {
+		return IsEnabled() && screenSize < Threshold * (1.0f + Band);
+	}
+};
+
+// Octahedral impostor of a model: at load time the model is rendered from Frames x Frames
+// directions spread over the sphere into one atlas. Far away an instance becomes a single quad
+// facing the camera, textured with the capture taken closest to the direction it is seen from.
+// Every capture is drawn inside a transparent gutter of its cell, and the mipmaps stop at the
+// last level where the filter of a capture still only reaches into its own gutter, so distant
+// impostors never pick up the neighboring views.
+class Impostor {
+public:
+	unsigned int Atlas;
+	unsigned int Frames;
+	unsigned int FrameSize;
+	// Texels of gutter on every side of a capture, inside its cell of FrameSize
+	unsigned int Padding;
+	unsigned int MaxLevel;
+	// Center and radius of the bounding sphere the captures are framed on
+	glm::vec4 Bounds;
+
+	Impostor() : Atlas(0), Frames(0), FrameSize(0), Padding(0), MaxLevel(0), Bounds(0.0f), quadVAO(0), quadVBO(0) {
+
+	}
+
+	// Render the captures with a shader taking model, view and projection (e.g. planet.vs/.fs).
+	void Capture(Model& model, Shader& shader, const AABB& bounds, unsigned int frames = 8, unsigned int frameSize = 128, unsigned int padding = 4) {
+		Release();
+		Frames = frames;
+		FrameSize = frameSize;
+		Padding = std::min(padding, frameSize / 4);
+		// Level n + 1 averages blocks of 2^(n + 1) texels, which must not straddle two cells, and
+		// its bilinear filter reaches 2^n texels past the edge of a capture, which must stay in the gutter.
+		MaxLevel = 0;
+		while ((1u << MaxLevel) <= Padding && frameSize % (2u << MaxLevel) == 0) {
+			MaxLevel++;
+		}
+		glm::vec3 center = bounds.Center();
+		float radius = bounds.Radius();
+		Bounds = glm::vec4(center, radius);
+		unsigned int size = frames * frameSize;
+
+		glGenTextures(1, &Atlas);
+		glBindTexture(GL_TEXTURE_2D, Atlas);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MaxLevel);
+
+		unsigned int depthRBO, captureFBO;
+		glGenRenderbuffers(1, &depthRBO);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+		glGenFramebuffers(1, &captureFBO);
+		glBindFramebuffer(GL_FRAMEBUFFER, captureFBO);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, Atlas, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "ERROR::IMPOSTOR::Framebuffer is not complete!" << std::endl;
+		}
+
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT, viewport);
+		glViewport(0, 0, size, size);
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// Orthographic, so every capture frames the bounding sphere the same way.
+		shader.use();
+		shader.setMat4("model", glm::mat4(1.0f));
+		shader.setMat4("projection", glm::ortho(-radius, radius, -radius, radius, 0.5f * radius, 3.5f * radius));
+		for (unsigned int y = 0; y < frames; y++) {
+			for (unsigned int x = 0; x < frames; x++) {
+				glm::vec3 direction = OctahedronDecode((glm::vec2(x, y) + 0.5f) / (float)frames);
+				shader.setMat4("view", glm::lookAt(center + direction * 2.0f * radius, center, upFor(direction)));
+				glViewport(x * frameSize + Padding, y * frameSize + Padding, frameSize - 2 * Padding, frameSize - 2 * Padding);
+				model.Draw(shader);
+			}
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+		glDeleteFramebuffers(1, &captureFBO);
+		glDeleteRenderbuffers(1, &depthRBO);
+
+		glBindTexture(GL_TEXTURE_2D, Atlas);
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		// One quad, its corners go from -1 to 1.
+		float corners[] = {
+			-1.0f, -1.0f,
+			 1.0f, -1.0f,
+			-1.0f,  1.0f,
+			 1.0f,  1.0f
+		};
+		glGenVertexArrays(1, &quadVAO);
+		glGenBuffers(1, &quadVBO);
+		glBindVertexArray(quadVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+		glBindVertexArray(0);
+	}
+
+	unsigned int GetVAO() {
+		return quadVAO;
+	}
+
+	// Set the atlas uniforms of Shaders/impostor.vs/.fs, the atlas is bound to unit 0.
+	void Bind(Shader& shader) {
+		shader.setInt("atlas", 0);
+		shader.setFloat("frames", (float)Frames);
+		shader.setFloat("framePadding", (float)Padding / FrameSize);
+		shader.setVec4("bounds", Bounds);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, Atlas);
+	}
+
+	// One quad per instance, the instance attributes must already point at the instances.
+	void Draw(unsigned int count) {
+		if (count == 0) {
+			return;
+		}
+		glBindVertexArray(quadVAO);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+		glBindVertexArray(0);
+	}
+
+	void Release() {
+		if (Atlas != 0) {
+			glDeleteTextures(1, &Atlas);
+			Atlas = 0;
+		}
+		if (quadVAO != 0) {
+			glDeleteVertexArrays(1, &quadVAO);
+			glDeleteBuffers(1, &quadVBO);
+			quadVAO = 0;
+		}
+	}
+
+private:
+	unsigned int quadVAO;
+	unsigned int quadVBO;
+
+	// Must match the capture basis in Shaders/impostor.vs.
+	static glm::vec3 upFor(glm::vec3 direction) {
+		return std::fabs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+};
+
+#endif // !IMPOSTOR_H
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef INSTANCEPOOL_H
+#define INSTANCEPOOL_H
+
+#include <glad/glad.h>
+
+#include <cstddef>
+#include <vector>
+
+// One instance buffer cut into blocks of equal size, handed out and taken back with a free list.
+// The buffer is allocated once, so streaming chunks in and out never reallocates GPU memory.
+class InstancePool {
+public:
+	InstancePool() : buffer(0), blockSize(0), blockCount(0) {
+
+	}
+
+	// Allocate blockCount blocks of blockSize bytes, every block handed out before is lost.
+	void Create(size_t blockSize, unsigned int blockCount) {
+		Release();
+		this->blockSize = blockSize;
+		this->blockCount = blockCount;
+
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferData(GL_ARRAY_BUFFER, blockSize * blockCount, NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+		// Hand out the low blocks first
+		freeBlocks.clear();
+		for (unsigned int i = blockCount; i > 0; i--) {
+			freeBlocks.push_back(i - 1);
+		}
+	}
+
+	unsigned int GetBuffer() {
+		return buffer;
+	}
+
+	size_t GetBlockSize() {
+		return blockSize;
+	}
+
+	unsigned int GetBlockCount() {
+		return blockCount;
+	}
+
+	unsigned int GetFreeCount() {
+		return freeBlocks.size();
+	}
+
+	// Offset of a block in the buffer in bytes
+	size_t GetOffset(unsigned int block) {
+		return block * blockSize;
+	}
+
+	// Returns false when every block is in use.
+	bool Allocate(unsigned int& block) {
+		if (freeBlocks.empty()) {
+			return false;
+		}
+		block = freeBlocks.back();
+		freeBlocks.pop_back();
+		return true;
+	}
+
+	void Free(unsigned int block) {
+		freeBlocks.push_back(block);
+	}
+
+	// Write size bytes (at most one block) to the start of a block.
+	void Upload(unsigned int block, const void* data, size_t size) {
+		if (size > blockSize) {
+			size = blockSize;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, GetOffset(block), size, data);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	void Release() {
+		if (buffer != 0) {
+			glDeleteBuffers(1, &buffer);
+			buffer = 0;
+		}
+		freeBlocks.clear();
+		blockSize = 0;
+		blockCount = 0;
+	}
+
+private:
+	unsigned int buffer;
+	size_t blockSize;
+	unsigned int blockCount;
+	std::vector<unsigned int> freeBlocks;
+};
+
+#endif // !INSTANCEPOOL_H
\ No newline at end of file
@@ -12,6 +12,7 @@
 
 #include "mesh.h"
 #include "shader.h"
+#include "occlusion.h"
 
 #include <string>
 #include <fstream>
@@ -29,6 +30,10 @@ class Model {
 public:
 	vector<Texture> textures_loaded;
 	vector<Mesh> meshes;
+	AABB Bounds;
+	// Simplified mesh for the software occlusion culling
+	vector<glm::vec3> OccluderVertices;
+	vector<unsigned int> OccluderIndices;
 	string directory;
 	bool gammaCorrection;
 
@@ -53,12 +58,29 @@ private:
 		}
 		directory = path.substr(0, path.find_last_of('\\'));
 		processNode(scene->mRootNode, scene);
+		buildOccluder(8);
+	}
+
+	void buildOccluder(unsigned int resolution) {
+		vector<glm::vec3> positions;
+		vector<unsigned int> indices;
+		for (unsigned int i = 0; i < meshes.size(); i++) {
+			unsigned int first = positions.size();
+			for (unsigned int j = 0; j < meshes[i].vertices.size(); j++) {
+				positions.push_back(meshes[i].vertices[j].Position);
+			}
+			for (unsigned int j = 0; j < meshes[i].indices.size(); j++) {
+				indices.push_back(first + meshes[i].indices[j]);
+			}
+		}
+		BuildOccluder(positions, indices, resolution, OccluderVertices, OccluderIndices);
 	}
 
 	void processNode(aiNode* node, const aiScene* scene) {
 		for (unsigned int i = 0; i < node->mNumMeshes; i++) {
 			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
 			meshes.push_back(processMesh(mesh, scene));
+			Bounds.Expand(meshes.back().Bounds);
 		}
 
 		for (unsigned int i = 0; i < node->mNumChildren; i++) {
@@ -70,6 +92,7 @@ private:
 		vector<Vertex> vertices;
 		vector<unsigned int> indices;
 		vector<Texture> textures;
+		AABB bounds;
 
 		for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
 			Vertex vertex;
@@ -80,6 +103,7 @@ private:
 			vector.y = mesh->mVertices[i].y;
 			vector.z = mesh->mVertices[i].z;
 			vertex.Position = vector;
+			bounds.Expand(vector);
 
 			if (mesh->HasNormals()) {
 				vector.x = mesh->mNormals[i].x;
@@ -132,7 +156,9 @@ private:
 		vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
 		textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-		return Mesh(vertices, indices, textures);
+		Mesh result(vertices, indices, textures);
+		result.Bounds = bounds;
+		return result;
 	}
 	
 	vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName) {
@@ -0,0 +1,335 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include "frustum.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Resolution of the software depth buffer, tiles and blocks must divide it.
+const unsigned int OCCLUSION_WIDTH = 256;
+const unsigned int OCCLUSION_HEIGHT = 128;
+// Pixels rasterized by one job
+const unsigned int OCCLUSION_TILE_WIDTH = 64;
+const unsigned int OCCLUSION_TILE_HEIGHT = 32;
+// Pixels summarized by one entry of the fine max-depth level, the coarse one has an entry per tile
+const unsigned int OCCLUSION_BLOCK = 8;
+
+// Simplify a mesh into an occluder by vertex clustering: the vertices are snapped to a
+// resolution^3 grid over the bounds, each cell becomes the average of its vertices and the
+// triangles that collapse are dropped. The averages lie inside a convex surface, so the
+// occluder hardly ever covers more than the mesh itself.
+inline void BuildOccluder(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, unsigned int resolution, std::vector<glm::vec3>& outVertices, std::vector<unsigned int>& outIndices) {
+	outVertices.clear();
+	outIndices.clear();
+	if (positions.empty() || resolution == 0) {
+		return;
+	}
+
+	AABB bounds;
+	for (unsigned int i = 0; i < positions.size(); i++) {
+		bounds.Expand(positions[i]);
+	}
+	glm::vec3 cellSize = glm::max((bounds.Max - bounds.Min) / (float)resolution, glm::vec3(0.0001f));
+
+	std::unordered_map<unsigned int, unsigned int> cells;
+	std::vector<unsigned int> counts;
+	std::vector<unsigned int> remap(positions.size());
+	for (unsigned int i = 0; i < positions.size(); i++) {
+		glm::uvec3 cell = glm::uvec3(glm::clamp((positions[i] - bounds.Min) / cellSize, glm::vec3(0.0f), glm::vec3(resolution - 1.0f)));
+		unsigned int key = (cell.z * resolution + cell.y) * resolution + cell.x;
+		auto found = cells.find(key);
+		if (found == cells.end()) {
+			found = cells.insert(std::make_pair(key, (unsigned int)outVertices.size())).first;
+			outVertices.push_back(glm::vec3(0.0f));
+			counts.push_back(0);
+		}
+		outVertices[found->second] += positions[i];
+		counts[found->second]++;
+		remap[i] = found->second;
+	}
+	for (unsigned int i = 0; i < outVertices.size(); i++) {
+		outVertices[i] /= (float)counts[i];
+	}
+
+	std::unordered_set<uint64_t> triangles;
+	for (unsigned int i = 0; i + 2 < indices.size(); i += 3) {
+		unsigned int a = remap[indices[i]];
+		unsigned int b = remap[indices[i + 1]];
+		unsigned int c = remap[indices[i + 2]];
+		if (a == b || b == c || c == a) {
+			continue;
+		}
+		// Many triangles collapse onto the same cells, keep one of them.
+		uint64_t sorted[3] = { a, b, c };
+		std::sort(sorted, sorted + 3);
+		if (!triangles.insert((sorted[0] << 42) | (sorted[1] << 21) | sorted[2]).second) {
+			continue;
+		}
+		outIndices.push_back(a);
+		outIndices.push_back(b);
+		outIndices.push_back(c);
+	}
+}
+
+// Low resolution depth buffer rendered on the CPU from a few marked occluders, used to skip
+// objects hidden behind them before they are submitted. The screen is split into tiles, each
+// rasterized by its own job on the thread pool, 4 pixels at a time with SSE. Afterwards every
+// block of OCCLUSION_BLOCK^2 pixels and every tile keep their farthest depth, and a box is hidden
+// when its nearest depth lies behind that of every block it covers. The tiles are tested first,
+// the blocks of a tile only when the box is not already behind the whole tile.
+class OcclusionBuffer {
+public:
+	// Statistics
+	unsigned int TriangleCount;
+	float RasterTime;
+
+	OcclusionBuffer() : TriangleCount(0), RasterTime(0.0f), viewProjection(1.0f) {
+		depth.resize(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f);
+		blockDepth.resize((OCCLUSION_WIDTH / OCCLUSION_BLOCK) * (OCCLUSION_HEIGHT / OCCLUSION_BLOCK), 1.0f);
+		tileDepth.resize((OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH) * (OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT), 1.0f);
+	}
+
+	// Start a frame, the occluders are given in world space to projection * view.
+	void Begin(const glm::mat4& viewProjection) {
+		this->viewProjection = viewProjection;
+		triangles.clear();
+	}
+
+	// Set up the triangles of an occluder (counter-clockwise front faces) for Rasterize().
+	void AddOccluder(const std::vector<glm::vec3>& vertices, const std::vector<unsigned int>& indices, const glm::mat4& model) {
+		glm::mat4 transform = viewProjection * model;
+		clipVertices.resize(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); i++) {
+			clipVertices[i] = transform * glm::vec4(vertices[i], 1.0f);
+		}
+
+		for (unsigned int i = 0; i + 2 < indices.size(); i += 3) {
+			const glm::vec4& a = clipVertices[indices[i]];
+			const glm::vec4& b = clipVertices[indices[i + 1]];
+			const glm::vec4& c = clipVertices[indices[i + 2]];
+			// Not clipped against the near plane, such a triangle is simply no occluder.
+			if (a.w < NEAR_W || b.w < NEAR_W || c.w < NEAR_W) {
+				continue;
+			}
+			setupTriangle(toScreen(a), toScreen(b), toScreen(c));
+		}
+	}
+
+	// Clear and rasterize every tile, then build the max-depth levels.
+	void Rasterize(ThreadPool* pool) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		const unsigned int tilesX = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+		const unsigned int tileCount = tilesX * (OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT);
+		auto job = [&](unsigned int begin, unsigned int end) {
+			for (unsigned int i = begin; i < end; i++) {
+				rasterizeTile((i % tilesX) * OCCLUSION_TILE_WIDTH, (i / tilesX) * OCCLUSION_TILE_HEIGHT);
+			}
+		};
+		if (pool != nullptr) {
+			pool->ParallelFor(tileCount, 1, job);
+		} else {
+			job(0, tileCount);
+		}
+		TriangleCount = triangles.size();
+
+		auto stop = std::chrono::high_resolution_clock::now();
+		RasterTime = std::chrono::duration<float, std::milli>(stop - start).count();
+	}
+
+	// Conservative: true unless the box is certainly hidden. viewProjection maps the box's
+	// space to clip space, it may differ from the one of Begin() by a model matrix.
+	bool IsVisible(const AABB& box, const glm::mat4& viewProjection) const {
+		float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+		float nearest = INFINITY;
+		for (int i = 0; i < 8; i++) {
+			glm::vec3 corner = glm::vec3(i & 1 ? box.Max.x : box.Min.x, i & 2 ? box.Max.y : box.Min.y, i & 4 ? box.Max.z : box.Min.z);
+			glm::vec4 clip = viewProjection * glm::vec4(corner, 1.0f);
+			// Reaches behind the camera
+			if (clip.w < NEAR_W) {
+				return true;
+			}
+			glm::vec3 screen = toScreen(clip);
+			minX = std::min(minX, screen.x);
+			maxX = std::max(maxX, screen.x);
+			minY = std::min(minY, screen.y);
+			maxY = std::max(maxY, screen.y);
+			nearest = std::min(nearest, screen.z);
+		}
+
+		// Outside of the screen, left to the frustum culling
+		if (maxX < 0.0f || maxY < 0.0f || minX >= OCCLUSION_WIDTH || minY >= OCCLUSION_HEIGHT) {
+			return true;
+		}
+		int pixelX0 = std::max((int)minX, 0);
+		int pixelX1 = std::min((int)maxX, (int)OCCLUSION_WIDTH - 1);
+		int pixelY0 = std::max((int)minY, 0);
+		int pixelY1 = std::min((int)maxY, (int)OCCLUSION_HEIGHT - 1);
+		const unsigned int tilesX = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+		const unsigned int blocksX = OCCLUSION_WIDTH / OCCLUSION_BLOCK;
+		for (int tileY = pixelY0 / OCCLUSION_TILE_HEIGHT; tileY <= pixelY1 / (int)OCCLUSION_TILE_HEIGHT; tileY++) {
+			for (int tileX = pixelX0 / OCCLUSION_TILE_WIDTH; tileX <= pixelX1 / (int)OCCLUSION_TILE_WIDTH; tileX++) {
+				// Behind the farthest depth of the tile, so behind every block in it
+				if (nearest > tileDepth[tileY * tilesX + tileX]) {
+					continue;
+				}
+				int blockX0 = std::max(pixelX0, tileX * (int)OCCLUSION_TILE_WIDTH) / OCCLUSION_BLOCK;
+				int blockX1 = std::min(pixelX1, (tileX + 1) * (int)OCCLUSION_TILE_WIDTH - 1) / OCCLUSION_BLOCK;
+				int blockY0 = std::max(pixelY0, tileY * (int)OCCLUSION_TILE_HEIGHT) / OCCLUSION_BLOCK;
+				int blockY1 = std::min(pixelY1, (tileY + 1) * (int)OCCLUSION_TILE_HEIGHT - 1) / OCCLUSION_BLOCK;
+				for (int y = blockY0; y <= blockY1; y++) {
+					for (int x = blockX0; x <= blockX1; x++) {
+						if (nearest <= blockDepth[y * blocksX + x]) {
+							return true;
+						}
+					}
+				}
+			}
+		}
+		return false;
+	}
+
+	// Depth of a pixel in [0, 1], for debugging
+	float GetDepth(unsigned int x, unsigned int y) const {
+		return depth[y * OCCLUSION_WIDTH + x];
+	}
+
+private:
+	// Edge functions A * x + B * y + C, positive inside, and the depth plane of a triangle
+	struct Triangle {
+		int MinX, MinY, MaxX, MaxY;
+		float A[3], B[3], C[3];
+		float Z0, ZX, ZY;
+	};
+
+	static constexpr float NEAR_W = 0.0001f;
+
+	glm::mat4 viewProjection;
+	std::vector<glm::vec4> clipVertices;
+	std::vector<Triangle> triangles;
+	std::vector<float> depth;
+	std::vector<float> blockDepth;
+	std::vector<float> tileDepth;
+
+	// Pixel coordinates and depth in [0, 1]
+	static glm::vec3 toScreen(const glm::vec4& clip) {
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		return glm::vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, glm::clamp(ndc.z * 0.5f + 0.5f, 0.0f, 1.0f));
+	}
+
+	void setupTriangle(glm::vec3 a, glm::vec3 b, glm::vec3 c) {
+		// Back facing or degenerate
+		float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+		if (area <= 0.0f) {
+			return;
+		}
+
+		Triangle triangle;
+		triangle.MinX = std::max((int)std::floor(std::min(a.x, std::min(b.x, c.x))), 0);
+		triangle.MinY = std::max((int)std::floor(std::min(a.y, std::min(b.y, c.y))), 0);
+		triangle.MaxX = std::min((int)std::ceil(std::max(a.x, std::max(b.x, c.x))), (int)OCCLUSION_WIDTH - 1);
+		triangle.MaxY = std::min((int)std::ceil(std::max(a.y, std::max(b.y, c.y))), (int)OCCLUSION_HEIGHT - 1);
+		if (triangle.MinX > triangle.MaxX || triangle.MinY > triangle.MaxY) {
+			return;
+		}
+
+		glm::vec3 vertices[3] = { a, b, c };
+		for (int i = 0; i < 3; i++) {
+			glm::vec3 from = vertices[i];
+			glm::vec3 to = vertices[(i + 1) % 3];
+			triangle.A[i] = from.y - to.y;
+			triangle.B[i] = to.x - from.x;
+			triangle.C[i] = -(triangle.A[i] * from.x + triangle.B[i] * from.y);
+		}
+
+		triangle.ZX = ((b.z - a.z) * (c.y - a.y) - (b.y - a.y) * (c.z - a.z)) / area;
+		triangle.ZY = ((b.x - a.x) * (c.z - a.z) - (b.z - a.z) * (c.x - a.x)) / area;
+		triangle.Z0 = a.z - triangle.ZX * a.x - triangle.ZY * a.y;
+		triangles.push_back(triangle);
+	}
+
+	// Only touches the pixels and blocks of its own tile, so tiles run in parallel.
+	void rasterizeTile(unsigned int tileX, unsigned int tileY) {
+		int tileMaxX = tileX + OCCLUSION_TILE_WIDTH - 1;
+		int tileMaxY = tileY + OCCLUSION_TILE_HEIGHT - 1;
+		for (unsigned int y = tileY; y <= (unsigned int)tileMaxY; y++) {
+			std::fill(&depth[y * OCCLUSION_WIDTH + tileX], &depth[y * OCCLUSION_WIDTH + tileX] + OCCLUSION_TILE_WIDTH, 1.0f);
+		}
+
+		for (unsigned int t = 0; t < triangles.size(); t++) {
+			const Triangle& triangle = triangles[t];
+			if (triangle.MaxX < (int)tileX || triangle.MinX > tileMaxX || triangle.MaxY < (int)tileY || triangle.MinY > tileMaxY) {
+				continue;
+			}
+			// Starts on a multiple of 4, the tile's width is one too.
+			int x0 = std::max(triangle.MinX, (int)tileX) & ~3;
+			int x1 = std::min(triangle.MaxX, tileMaxX);
+			int y0 = std::max(triangle.MinY, (int)tileY);
+			int y1 = std::min(triangle.MaxY, tileMaxY);
+
+			for (int y = y0; y <= y1; y++) {
+				float* row = &depth[y * OCCLUSION_WIDTH];
+				float py = y + 0.5f;
+#ifdef FRUSTUM_USE_SSE
+				__m128 rowEdge0 = _mm_set1_ps(triangle.B[0] * py + triangle.C[0]);
+				__m128 rowEdge1 = _mm_set1_ps(triangle.B[1] * py + triangle.C[1]);
+				__m128 rowEdge2 = _mm_set1_ps(triangle.B[2] * py + triangle.C[2]);
+				__m128 rowDepth = _mm_set1_ps(triangle.Z0 + triangle.ZY * py);
+				for (int x = x0; x <= x1; x += 4) {
+					__m128 px = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+					__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.A[0]), px), rowEdge0);
+					__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.A[1]), px), rowEdge1);
+					__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.A[2]), px), rowEdge2);
+					__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, _mm_setzero_ps()), _mm_cmpge_ps(e1, _mm_setzero_ps())), _mm_cmpge_ps(e2, _mm_setzero_ps()));
+					if (_mm_movemask_ps(inside) == 0) {
+						continue;
+					}
+					__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.ZX), px), rowDepth);
+					__m128 old = _mm_loadu_ps(row + x);
+					__m128 nearer = _mm_min_ps(old, z);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+				}
+#else
+				for (int x = x0; x <= x1; x++) {
+					float px = x + 0.5f;
+					bool inside = true;
+					for (int i = 0; i < 3; i++) {
+						inside = inside && triangle.A[i] * px + triangle.B[i] * py + triangle.C[i] >= 0.0f;
+					}
+					if (inside) {
+						row[x] = std::min(row[x], triangle.Z0 + triangle.ZX * px + triangle.ZY * py);
+					}
+				}
+#endif
+			}
+		}
+
+		// Farthest depth of every block in the tile, and of the tile from those
+		const unsigned int blocksX = OCCLUSION_WIDTH / OCCLUSION_BLOCK;
+		float tileFarthest = 0.0f;
+		for (unsigned int by = tileY; by < tileY + OCCLUSION_TILE_HEIGHT; by += OCCLUSION_BLOCK) {
+			for (unsigned int bx = tileX; bx < tileX + OCCLUSION_TILE_WIDTH; bx += OCCLUSION_BLOCK) {
+				float farthest = 0.0f;
+				for (unsigned int y = by; y < by + OCCLUSION_BLOCK; y++) {
+					for (unsigned int x = bx; x < bx + OCCLUSION_BLOCK; x++) {
+						farthest = std::max(farthest, depth[y * OCCLUSION_WIDTH + x]);
+					}
+				}
+				blockDepth[(by / OCCLUSION_BLOCK) * blocksX + bx / OCCLUSION_BLOCK] = farthest;
+				tileFarthest = std::max(tileFarthest, farthest);
+			}
+		}
+		tileDepth[(tileY / OCCLUSION_TILE_HEIGHT) * (OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH) + tileX / OCCLUSION_TILE_WIDTH] = tileFarthest;
+	}
+};
+
+#endif // !OCCLUSION_H
\ No newline at end of file
@@ -0,0 +1,360 @@
+#ifndef PROCEDURALFIELD_H
+#define PROCEDURALFIELD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "model.h"
+#include "frustum.h"
+#include "threadpool.h"
+#include "instancepool.h"
+#include "asteroidfield.h"
+#include "occlusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Side of a square chunk of the ring in the belt's xz plane
+const float CHUNK_SIZE = 32.0f;
+// Candidate rocks per chunk, the ones outside of the ring are dropped.
+const unsigned int CHUNK_CAPACITY = 512;
+// Chunks generated per frame at most, the closest ones first.
+const unsigned int CHUNK_BUDGET = 32;
+// Range of the rock scales
+const float ROCK_MIN_SCALE = 0.05f;
+const float ROCK_MAX_SCALE = 0.25f;
+
+enum Field_Mode {
+	FIELD_BELT,
+	FIELD_PROCEDURAL
+};
+
+// Small deterministic generator, the same seed always gives the same rocks on every platform
+// (unlike rand(), whose sequence is also shared by all threads).
+struct FieldRandom {
+	uint32_t State;
+
+	FieldRandom(uint32_t seed) : State(seed != 0 ? seed : 0x9E3779B9u) {
+
+	}
+
+	uint32_t Next() {
+		State ^= State << 13;
+		State ^= State >> 17;
+		State ^= State << 5;
+		return State;
+	}
+
+	// In [0, 1)
+	float NextFloat() {
+		return (Next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	float Range(float min, float max) {
+		return min + (max - min) * NextFloat();
+	}
+
+	// Seed of the chunk at (x, z)
+	static uint32_t Hash(uint32_t seed, int x, int z) {
+		uint32_t h = seed ^ ((uint32_t)x * 0x8DA6B343u) ^ ((uint32_t)z * 0xD8163841u);
+		h ^= h >> 16;
+		h *= 0x7FEB352Du;
+		h ^= h >> 15;
+		h *= 0x846CA68Bu;
+		h ^= h >> 16;
+		return h;
+	}
+};
+
+// An asteroid ring far too large to store, built on demand around the camera. The ring is split
+// into square chunks; the chunks close to the camera are generated from the seed on the thread
+// pool and copied into a block of the instance pool, the ones left behind are retired and their
+// block reused. Memory stays bounded by the load radius, however large the ring is.
+// Like AsteroidField everything lives in the belt's frame.
+class ProceduralField {
+public:
+	// Statistics
+	unsigned int ResidentChunks;
+	unsigned int GeneratedChunks;
+	unsigned int VisibleChunks;
+	unsigned int OccludedChunks;
+	unsigned int InstanceCount;
+	unsigned int ImpostorCount;
+	float UpdateTime;
+
+	ProceduralField(uint32_t seed = 1337, float innerRadius = 150.0f, float outerRadius = 4000.0f, float thickness = 12.0f, float loadRadius = 256.0f)
+		: ResidentChunks(0), GeneratedChunks(0), VisibleChunks(0), OccludedChunks(0), InstanceCount(0), ImpostorCount(0), UpdateTime(0.0f),
+		seed(seed), innerRadius(innerRadius), outerRadius(outerRadius), thickness(thickness), loadRadius(loadRadius), rockCenter(0.0f), rockRadius(0.0f) {
+
+	}
+
+	// Create the pool, large enough for every chunk within reach of the camera.
+	void Initialize(const AABB& rockBounds) {
+		rockCenter = rockBounds.Center();
+		rockRadius = rockBounds.Radius();
+
+		chunks.clear();
+		unsigned int side = (unsigned int)std::ceil(2.0f * (loadRadius + CHUNK_SIZE) / CHUNK_SIZE) + 2;
+		pool.Create(CHUNK_CAPACITY * sizeof(AsteroidInstance), side * side);
+		staging.resize(CHUNK_BUDGET * CHUNK_CAPACITY);
+		ResidentChunks = 0;
+	}
+
+	// Expected number of rocks in the whole ring
+	double GetPotentialCount() {
+		double area = 3.14159265358979 * ((double)outerRadius * outerRadius - (double)innerRadius * innerRadius);
+		return area / (CHUNK_SIZE * CHUNK_SIZE) * CHUNK_CAPACITY;
+	}
+
+	size_t GetPoolSize() {
+		return pool.GetBlockSize() * pool.GetBlockCount();
+	}
+
+	uint32_t GetSeed() {
+		return seed;
+	}
+
+	// A new seed gives a new ring, the chunks are generated again.
+	void SetSeed(uint32_t value) {
+		if (value != seed) {
+			seed = value;
+			Clear();
+		}
+	}
+
+	// Retire the chunks out of reach and generate the missing ones closest to viewPosition.
+	void Update(glm::vec3 viewPosition, ThreadPool* threadPool) {
+		auto start = std::chrono::high_resolution_clock::now();
+
+		// 1. Retire, with one chunk of margin so chunks on the border don't come and go.
+		for (auto it = chunks.begin(); it != chunks.end();) {
+			if (distanceToChunk(viewPosition, it->second.X, it->second.Z) > loadRadius + CHUNK_SIZE) {
+				pool.Free(it->second.Block);
+				it = chunks.erase(it);
+			} else {
+				++it;
+			}
+		}
+
+		// 2. Find the missing chunks in reach which overlap the ring.
+		missing.clear();
+		int minX = (int)std::floor((viewPosition.x - loadRadius) / CHUNK_SIZE);
+		int maxX = (int)std::floor((viewPosition.x + loadRadius) / CHUNK_SIZE);
+		int minZ = (int)std::floor((viewPosition.z - loadRadius) / CHUNK_SIZE);
+		int maxZ = (int)std::floor((viewPosition.z + loadRadius) / CHUNK_SIZE);
+		for (int z = minZ; z <= maxZ; z++) {
+			for (int x = minX; x <= maxX; x++) {
+				float distance = distanceToChunk(viewPosition, x, z);
+				if (distance > loadRadius || !overlapsRing(x, z) || chunks.count(key(x, z)) != 0) {
+					continue;
+				}
+				PendingChunk pending;
+				pending.X = x;
+				pending.Z = z;
+				pending.Distance = distance;
+				missing.push_back(pending);
+			}
+		}
+
+		// 3. Generate the closest ones in parallel, each job writes its own part of the staging array.
+		std::sort(missing.begin(), missing.end(), [](const PendingChunk& a, const PendingChunk& b) {
+			return a.Distance < b.Distance;
+		});
+		unsigned int count = std::min((unsigned int)missing.size(), std::min(CHUNK_BUDGET, pool.GetFreeCount()));
+		generated.resize(count);
+		auto job = [&](unsigned int begin, unsigned int end) {
+			for (unsigned int i = begin; i < end; i++) {
+				generated[i] = generate(missing[i].X, missing[i].Z, &staging[i * CHUNK_CAPACITY]);
+			}
+		};
+		if (threadPool != nullptr) {
+			threadPool->ParallelFor(count, 1, job);
+		} else {
+			job(0, count);
+		}
+
+		// 4. Upload on this thread, the only one with a GL context.
+		for (unsigned int i = 0; i < count; i++) {
+			Chunk& chunk = generated[i];
+			if (!pool.Allocate(chunk.Block)) {
+				break;
+			}
+			if (chunk.Count > 0) {
+				pool.Upload(chunk.Block, &staging[i * CHUNK_CAPACITY], chunk.Count * sizeof(AsteroidInstance));
+			}
+			chunks[key(chunk.X, chunk.Z)] = chunk;
+		}
+
+		ResidentChunks = chunks.size();
+		GeneratedChunks = count;
+
+		auto stop = std::chrono::high_resolution_clock::now();
+		UpdateTime = std::chrono::duration<float, std::milli>(stop - start).count();
+	}
+
+	// Draw the chunks inside the frustum (in the belt's frame), one instanced draw per chunk.
+	// A chunk is drawn as meshes unless all of its rocks are small enough for impostors, those
+	// are kept for DrawImpostors(). In between the shaders cross-fade every rock on its own.
+	// Chunks hidden in the occlusion buffer (occlusionViewProjection from the belt's frame) are skipped.
+	void Draw(Model& rock, Frustum& frustum, glm::vec3 viewPosition, const LodSettings& lod, const OcclusionBuffer* occlusion = nullptr, const glm::mat4& occlusionViewProjection = glm::mat4(1.0f)) {
+		VisibleChunks = 0;
+		OccludedChunks = 0;
+		InstanceCount = 0;
+		impostorChunks.clear();
+		for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+			Chunk& chunk = it->second;
+			if (chunk.Count == 0 || !frustum.IsVisible(chunk.Bounds)) {
+				continue;
+			}
+			if (occlusion != nullptr && !occlusion->IsVisible(chunk.Bounds, occlusionViewProjection)) {
+				OccludedChunks++;
+				continue;
+			}
+			VisibleChunks++;
+
+			// Largest and smallest screen size of any rock in the chunk
+			glm::vec3 nearest = glm::clamp(viewPosition, chunk.Bounds.Min, chunk.Bounds.Max);
+			glm::vec3 farthest = glm::max(glm::abs(viewPosition - chunk.Bounds.Min), glm::abs(viewPosition - chunk.Bounds.Max));
+			float largest = lod.ScreenSize(rockRadius * ROCK_MAX_SCALE, glm::length(viewPosition - nearest));
+			float smallest = lod.ScreenSize(rockRadius * ROCK_MIN_SCALE, glm::length(farthest));
+			if (lod.NeedsImpostor(smallest)) {
+				impostorChunks.push_back(&chunk);
+			}
+			if (!lod.NeedsMesh(largest)) {
+				continue;
+			}
+
+			BindInstanceBuffer(rock, pool.GetBuffer(), pool.GetOffset(chunk.Block));
+			for (unsigned int i = 0; i < rock.meshes.size(); i++) {
+				glBindVertexArray(rock.meshes[i].VAO);
+				glDrawElementsInstanced(GL_TRIANGLES, rock.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, chunk.Count);
+				glBindVertexArray(0);
+			}
+			InstanceCount += chunk.Count;
+		}
+	}
+
+	// The chunks Draw() left to the impostors, the impostor shader must be in use.
+	void DrawImpostors(Impostor& impostor) {
+		ImpostorCount = 0;
+		for (unsigned int i = 0; i < impostorChunks.size(); i++) {
+			BindInstanceAttributes(impostor.GetVAO(), pool.GetBuffer(), pool.GetOffset(impostorChunks[i]->Block));
+			impostor.Draw(impostorChunks[i]->Count);
+			ImpostorCount += impostorChunks[i]->Count;
+		}
+		impostorChunks.clear();
+	}
+
+	// Retire every chunk
+	void Clear() {
+		for (auto it = chunks.begin(); it != chunks.end(); ++it) {
+			pool.Free(it->second.Block);
+		}
+		chunks.clear();
+		impostorChunks.clear();
+		ResidentChunks = 0;
+	}
+
+	void Release() {
+		impostorChunks.clear();
+		chunks.clear();
+		pool.Release();
+	}
+
+private:
+	struct Chunk {
+		int X;
+		int Z;
+		unsigned int Block;
+		unsigned int Count;
+		AABB Bounds;
+	};
+
+	struct PendingChunk {
+		int X;
+		int Z;
+		float Distance;
+	};
+
+	uint32_t seed;
+	float innerRadius;
+	float outerRadius;
+	float thickness;
+	float loadRadius;
+	glm::vec3 rockCenter;
+	float rockRadius;
+
+	InstancePool pool;
+	std::unordered_map<uint64_t, Chunk> chunks;
+	std::vector<PendingChunk> missing;
+	std::vector<Chunk> generated;
+	std::vector<Chunk*> impostorChunks;
+	std::vector<AsteroidInstance> staging;
+
+	static uint64_t key(int x, int z) {
+		return ((uint64_t)(uint32_t)x << 32) | (uint32_t)z;
+	}
+
+	// Distance from the position to the chunk's square in the xz plane, 0 inside of it.
+	static float distanceToChunk(glm::vec3 position, int x, int z) {
+		float dx = std::max(std::max(x * CHUNK_SIZE - position.x, position.x - (x + 1) * CHUNK_SIZE), 0.0f);
+		float dz = std::max(std::max(z * CHUNK_SIZE - position.z, position.z - (z + 1) * CHUNK_SIZE), 0.0f);
+		return std::sqrt(dx * dx + dz * dz);
+	}
+
+	bool overlapsRing(int x, int z) {
+		// Closest and farthest points of the square from the planet
+		float nearest = distanceToChunk(glm::vec3(0.0f), x, z);
+		float fx = std::max(std::fabs(x * CHUNK_SIZE), std::fabs((x + 1) * CHUNK_SIZE));
+		float fz = std::max(std::fabs(z * CHUNK_SIZE), std::fabs((z + 1) * CHUNK_SIZE));
+		float farthest = std::sqrt(fx * fx + fz * fz);
+		return nearest <= outerRadius && farthest >= innerRadius;
+	}
+
+	// Called from the worker threads, touches nothing but its own output.
+	Chunk generate(int x, int z, AsteroidInstance* out) {
+		Chunk chunk;
+		chunk.X = x;
+		chunk.Z = z;
+		chunk.Block = 0;
+		chunk.Count = 0;
+
+		// Enclosing sphere of a rock around its position, for a scale of 1
+		float rockExtent = glm::length(rockCenter) + rockRadius;
+
+		FieldRandom random(FieldRandom::Hash(seed, x, z));
+		for (unsigned int i = 0; i < CHUNK_CAPACITY; i++) {
+			// Draw every number even for dropped rocks, so a rock only depends on its index.
+			float px = (x + random.NextFloat()) * CHUNK_SIZE;
+			float pz = (z + random.NextFloat()) * CHUNK_SIZE;
+			float height = random.Range(-1.0f, 1.0f);
+			float scale = random.Range(ROCK_MIN_SCALE, ROCK_MAX_SCALE);
+			glm::vec3 axis = glm::vec3(random.Range(-1.0f, 1.0f), random.Range(-1.0f, 1.0f), random.Range(-1.0f, 1.0f));
+			float angle = random.Range(0.0f, 6.2831853f);
+
+			float radius = std::sqrt(px * px + pz * pz);
+			if (radius < innerRadius || radius > outerRadius) {
+				continue;
+			}
+
+			// The ring gets thinner towards its edges.
+			float t = (radius - innerRadius) / (outerRadius - innerRadius);
+			float y = height * thickness * 4.0f * t * (1.0f - t);
+
+			float length = glm::length(axis);
+			axis = length > 0.001f ? axis / length : glm::vec3(0.0f, 1.0f, 0.0f);
+
+			AsteroidInstance& instance = out[chunk.Count++];
+			instance.Orbit = glm::vec4(radius, std::atan2(px, pz), y, scale);
+			instance.Rotation = glm::vec4(axis, angle);
+			chunk.Bounds.Expand(AABB(glm::vec3(px, y, pz) - rockExtent * scale, glm::vec3(px, y, pz) + rockExtent * scale));
+		}
+		return chunk;
+	}
+};
+
+#endif // !PROCEDURALFIELD_H
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
 class Shader {
 public:
@@ -66,6 +67,64 @@ public:
 		glDeleteShader(fragment);
 	};
 
+	// Program without a fragment stage, the outputs of the geometry shader are captured
+	// with transform feedback (interleaved, in the order of feedbackVaryings).
+	Shader(const char* vertexPath, const char* geometryPath, const std::vector<const char*>& feedbackVaryings) {
+		std::string vertexCode;
+		std::string geometryCode;
+
+		std::ifstream vShaderFile;
+		std::ifstream gShaderFile;
+
+		vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		try
+		{
+			// Open files
+			vShaderFile.open(vertexPath);
+			gShaderFile.open(geometryPath);
+			std::stringstream vShaderStream, gShaderStream;
+
+			vShaderStream << vShaderFile.rdbuf();
+			gShaderStream << gShaderFile.rdbuf();
+
+			vShaderFile.close();
+			gShaderFile.close();
+
+			vertexCode = vShaderStream.str();
+			geometryCode = gShaderStream.str();
+		}
+		catch (std::ifstream::failure& e)
+		{
+			fprintf(stderr, "Failed to load shader files.\n");
+		}
+		const char* vShaderCode = vertexCode.c_str();
+		const char* gShaderCode = geometryCode.c_str();
+
+		// Compile these shaders.
+		unsigned int vertex, geometry;
+		vertex = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(vertex, 1, &vShaderCode, NULL);
+		glCompileShader(vertex);
+		checkCompileErrors(vertex, "Vertex", vertexPath);
+
+		geometry = glCreateShader(GL_GEOMETRY_SHADER);
+		glShaderSource(geometry, 1, &gShaderCode, NULL);
+		glCompileShader(geometry);
+		checkCompileErrors(geometry, "Geometry", geometryPath);
+
+		// The varyings have to be set before linking.
+		ID = glCreateProgram();
+		glAttachShader(ID, vertex);
+		glAttachShader(ID, geometry);
+		glTransformFeedbackVaryings(ID, feedbackVaryings.size(), feedbackVaryings.data(), GL_INTERLEAVED_ATTRIBS);
+		glLinkProgram(ID);
+		checkCompileErrors(ID, "Program", vertexPath);
+
+		glDeleteShader(vertex);
+		glDeleteShader(geometry);
+	};
+
 	void use() {
 		glUseProgram(ID);
 	};
@@ -98,6 +157,10 @@ public:
 		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
 	};
 
+	void setVec4(const std::string& name, glm::vec4 vector) const {
+		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &vector[0]);
+	};
+
 	void setMat3(const std::string& name, glm::mat3 metrics) const {
 		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &metrics[0][0]);
 	};
@@ -1,14 +1,54 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in mat4 InstanceMatrix;
+layout (location = 5) in vec4 aOrbit;    // orbit radius, orbit phase, height, scale
+layout (location = 6) in vec4 aRotation; // rotation axis, rotation angle
 
 out vec2 TexCoords;
+flat out float Fade;
 
 uniform mat4 view;
 uniform mat4 projection;
+uniform float time;
+uniform float orbitSpeed;
+
+// Cross-fade with the impostors (see LodSettings), no fade when lodThreshold is 0
+uniform vec4 bounds;
+uniform vec3 viewPos;
+uniform float lodScale;
+uniform float lodThreshold;
+uniform float lodBand;
+
+// Rotation of angle radians around a unit axis (Rodrigues)
+mat3 rotationMatrix(vec3 axis, float angle) {
+	float s = sin(angle);
+	float c = cos(angle);
+	float t = 1.0f - c;
+	return mat3(
+		t * axis.x * axis.x + c,          t * axis.x * axis.y + s * axis.z, t * axis.x * axis.z - s * axis.y,
+		t * axis.x * axis.y - s * axis.z, t * axis.y * axis.y + c,          t * axis.y * axis.z + s * axis.x,
+		t * axis.x * axis.z + s * axis.y, t * axis.y * axis.z - s * axis.x, t * axis.z * axis.z + c
+	);
+}
 
 void main() {
+	// The rock in the belt's frame
+	mat3 rotation = rotationMatrix(aRotation.xyz, aRotation.w);
+	vec3 position = vec3(sin(aOrbit.y) * aOrbit.x, aOrbit.z, cos(aOrbit.y) * aOrbit.x);
+	vec3 beltPos = position + rotation * (aPos * aOrbit.w);
+
+	// The whole belt turns around the planet with the time, nothing is updated on the CPU.
+	float beltAngle = time * orbitSpeed;
+	mat3 belt = mat3(cos(beltAngle), 0.0f, -sin(beltAngle), 0.0f, 1.0f, 0.0f, sin(beltAngle), 0.0f, cos(beltAngle));
+	vec3 worldPos = belt * beltPos;
+
+	Fade = 1.0f;
+	if (lodThreshold > 0.0f) {
+		vec3 center = belt * (position + rotation * (bounds.xyz * aOrbit.w));
+		float screenSize = bounds.w * aOrbit.w * lodScale / max(distance(center, viewPos), 0.0001f);
+		Fade = clamp((screenSize - lodThreshold) / max(lodThreshold * lodBand, 0.0001f), 0.0f, 1.0f);
+	}
+
 	TexCoords = aTexCoords;
-	gl_Position = projection * view * InstanceMatrix * vec4(aPos, 1.0f);
+	gl_Position = projection * view * vec4(worldPos, 1.0f);
 }
\ No newline at end of file
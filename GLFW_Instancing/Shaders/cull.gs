@@ -0,0 +1,20 @@
+#version 330 core
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in vec4 vOrbit[];
+in vec4 vRotation[];
+flat in int vVisible[];
+
+// Captured by transform feedback, only the visible instances are emitted.
+out vec4 InstanceOrbit;
+out vec4 InstanceRotation;
+
+void main() {
+	if (vVisible[0] == 1) {
+		InstanceOrbit = vOrbit[0];
+		InstanceRotation = vRotation[0];
+		EmitVertex();
+		EndPrimitive();
+	}
+}
\ No newline at end of file
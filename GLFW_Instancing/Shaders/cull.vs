@@ -0,0 +1,45 @@
+#version 330 core
+layout (location = 0) in vec4 aOrbit;
+layout (location = 1) in vec4 aRotation;
+
+out vec4 vOrbit;
+out vec4 vRotation;
+flat out int vVisible;
+
+// Frustum planes (normals point inwards) and the local bounding sphere of the rock,
+// all in the belt's frame, where the instances don't move.
+uniform vec4 planes[6];
+uniform vec4 bounds;
+uniform vec3 viewPos;
+uniform float maxDistance;
+
+mat3 rotationMatrix(vec3 axis, float angle) {
+	float s = sin(angle);
+	float c = cos(angle);
+	float t = 1.0f - c;
+	return mat3(
+		t * axis.x * axis.x + c,          t * axis.x * axis.y + s * axis.z, t * axis.x * axis.z - s * axis.y,
+		t * axis.x * axis.y - s * axis.z, t * axis.y * axis.y + c,          t * axis.y * axis.z + s * axis.x,
+		t * axis.x * axis.z + s * axis.y, t * axis.y * axis.z - s * axis.x, t * axis.z * axis.z + c
+	);
+}
+
+void main() {
+	vec3 position = vec3(sin(aOrbit.y) * aOrbit.x, aOrbit.z, cos(aOrbit.y) * aOrbit.x);
+	vec3 center = position + rotationMatrix(aRotation.xyz, aRotation.w) * (bounds.xyz * aOrbit.w);
+	float radius = bounds.w * aOrbit.w;
+
+	bool visible = true;
+	for (int i = 0; i < 6; i++) {
+		if (dot(planes[i].xyz, center) + planes[i].w < -radius) {
+			visible = false;
+		}
+	}
+	if (maxDistance > 0.0f && distance(center, viewPos) > maxDistance + radius) {
+		visible = false;
+	}
+
+	vOrbit = aOrbit;
+	vRotation = aRotation;
+	vVisible = visible ? 1 : 0;
+}
\ No newline at end of file
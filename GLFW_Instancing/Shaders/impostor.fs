@@ -0,0 +1,25 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+flat in float Fade;
+
+uniform sampler2D atlas;
+
+// The same dither as asteroid.fs, so the mesh and the impostor never cover the same pixel.
+float ditherThreshold() {
+	const float bayer[16] = float[16](0.0f, 8.0f, 2.0f, 10.0f, 12.0f, 4.0f, 14.0f, 6.0f, 3.0f, 11.0f, 1.0f, 9.0f, 15.0f, 7.0f, 13.0f, 5.0f);
+	ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+	return (bayer[pixel.y * 4 + pixel.x] + 0.5f) / 16.0f;
+}
+
+void main() {
+	if (Fade >= ditherThreshold()) {
+		discard;
+	}
+	vec4 color = texture(atlas, TexCoords);
+	if (color.a < 0.5f) {
+		discard;
+	}
+	FragColor = vec4(color.rgb, 1.0f);
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner;
+layout (location = 5) in vec4 aOrbit;    // orbit radius, orbit phase, height, scale
+layout (location = 6) in vec4 aRotation; // rotation axis, rotation angle
+
+out vec2 TexCoords;
+flat out float Fade;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float time;
+uniform float orbitSpeed;
+
+// The atlas has frames x frames captures of the sphere bounds (center, radius), each inset by
+// framePadding (a fraction of its cell) on every side.
+uniform float frames;
+uniform float framePadding;
+uniform vec4 bounds;
+uniform vec3 viewPos;
+uniform float lodScale;
+uniform float lodThreshold;
+uniform float lodBand;
+
+mat3 rotationMatrix(vec3 axis, float angle) {
+	float s = sin(angle);
+	float c = cos(angle);
+	float t = 1.0f - c;
+	return mat3(
+		t * axis.x * axis.x + c,          t * axis.x * axis.y + s * axis.z, t * axis.x * axis.z - s * axis.y,
+		t * axis.x * axis.y - s * axis.z, t * axis.y * axis.y + c,          t * axis.y * axis.z + s * axis.x,
+		t * axis.x * axis.z + s * axis.y, t * axis.y * axis.z - s * axis.x, t * axis.z * axis.z + c
+	);
+}
+
+vec2 signNotZero(vec2 v) {
+	return vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+// Octahedral map, the same as OctahedronDecode() in impostor.h
+vec2 octEncode(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 p = n.xz;
+	if (n.y < 0.0f) {
+		p = (1.0f - abs(p.yx)) * signNotZero(p);
+	}
+	return p * 0.5f + 0.5f;
+}
+
+vec3 octDecode(vec2 uv) {
+	vec2 p = uv * 2.0f - 1.0f;
+	vec3 n = vec3(p.x, 1.0f - abs(p.x) - abs(p.y), p.y);
+	if (n.y < 0.0f) {
+		n.xz = (1.0f - abs(n.zx)) * signNotZero(n.xz);
+	}
+	return normalize(n);
+}
+
+void main() {
+	mat3 rotation = rotationMatrix(aRotation.xyz, aRotation.w);
+	float beltAngle = time * orbitSpeed;
+	mat3 belt = mat3(cos(beltAngle), 0.0f, -sin(beltAngle), 0.0f, 1.0f, 0.0f, sin(beltAngle), 0.0f, cos(beltAngle));
+	mat3 toWorld = belt * rotation;
+
+	vec3 position = vec3(sin(aOrbit.y) * aOrbit.x, aOrbit.z, cos(aOrbit.y) * aOrbit.x);
+	vec3 center = belt * (position + rotation * (bounds.xyz * aOrbit.w));
+	float radius = bounds.w * aOrbit.w;
+
+	// Pick the capture taken closest to the direction the rock is seen from, in the rock's frame.
+	vec3 direction = normalize(transpose(toWorld) * (viewPos - center));
+	vec2 frame = clamp(floor(octEncode(direction) * frames), vec2(0.0f), vec2(frames - 1.0f));
+	vec3 frameDirection = octDecode((frame + 0.5f) / frames);
+
+	// The quad lies like the image plane of that capture (glm::lookAt basis).
+	vec3 up = abs(frameDirection.y) > 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(0.0f, 1.0f, 0.0f);
+	vec3 forward = -frameDirection;
+	vec3 right = normalize(cross(forward, up));
+	up = cross(right, forward);
+	vec3 worldPos = center + toWorld * ((right * aCorner.x + up * aCorner.y) * radius);
+
+	float screenSize = radius * lodScale / max(distance(center, viewPos), 0.0001f);
+	Fade = clamp((screenSize - lodThreshold) / max(lodThreshold * lodBand, 0.0001f), 0.0f, 1.0f);
+
+	TexCoords = (frame + aCorner * (0.5f - framePadding) + 0.5f) / frames;
+	gl_Position = projection * view * vec4(worldPos, 1.0f);
+}
\ No newline at end of file
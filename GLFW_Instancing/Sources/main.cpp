@@ -13,8 +13,16 @@
 #include "../Headers/shader.h"
 #include "../Headers/camera.h"
 #include "../Headers/model.h"
+#include "../Headers/frustum.h"
+#include "../Headers/threadpool.h"
+#include "../Headers/asteroidfield.h"
+#include "../Headers/gpuculling.h"
+#include "../Headers/proceduralfield.h"
+#include "../Headers/impostor.h"
+#include "../Headers/occlusion.h"
 
 #include <iostream>
+#include <vector>
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 void mouseCallback(GLFWwindow* window, double xpos, double ypos);
@@ -40,6 +48,25 @@ float lastFrame = 0.0f;
 glm::mat4 view = glm::mat4(1.0f);
 glm::mat4 projection = glm::mat4(1.0f);
 
+Frustum frustum;
+Frustum beltFrustum;
+ThreadPool threadPool;
+AsteroidField asteroids;
+GpuCuller gpuCuller;
+ProceduralField proceduralField;
+int fieldMode = FIELD_BELT;
+int fieldSeed = 1337;
+Impostor rockImpostor;
+bool useImpostors = true;
+float impostorThreshold = 6.0f;
+float impostorBand = 0.5f;
+OcclusionBuffer occlusionBuffer;
+bool useOcclusion = true;
+int cullMode = CULL_MULTI_THREAD;
+int asteroidAmount = 10000;
+float maxDistance = 600.0f;
+float orbitSpeed = 0.02f;
+
 int main(int argc, char *argv[]) {
 
 	glfwInit();
@@ -70,10 +97,15 @@ int main(int argc, char *argv[]) {
 
 	Shader asteroidShader("Shaders/asteroid.vs", "Shaders/asteroid.fs");
 	Shader planetShader("Shaders/planet.vs", "Shaders/planet.fs");
+	Shader cullShader("Shaders/cull.vs", "Shaders/cull.gs", { "InstanceOrbit", "InstanceRotation" });
+	Shader impostorShader("Shaders/impostor.vs", "Shaders/impostor.fs");
 
 	// stbi_set_flip_vertically_on_load(true);
 	Model planet("Resources\\Objects\\planet\\planet.obj");
 	Model rock("Resources\\Objects\\rock\\rock.obj");
+
+	// The rock seen from 8 x 8 directions, the planet shader draws it unlit like asteroid.fs.
+	rockImpostor.Capture(rock, planetShader, rock.Bounds);
 	
 	// Initalize ImGui and bind to GLFW and OpenGL3(glad)
 	std::string glsl_version = "#version 330";
@@ -84,57 +116,14 @@ int main(int argc, char *argv[]) {
 	ImGui_ImplOpenGL3_Init(glsl_version.c_str());
 	ImGui::StyleColorsDark();
 
-	unsigned int amount = 10000;
-	glm::mat4* modelMatrices;
-	modelMatrices = new glm::mat4[amount];
 	srand(glfwGetTime());
 	float radius = 100.0;
 	float offset = 30.0f;
-	for (unsigned int i = 0; i < amount; i++) {
-		glm::mat4 model = glm::mat4(1.0f);
-
-		float angle = (float)i / (float)amount * 360.0f;
-		float displancement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-		float x = sin(angle) * radius + displancement;
-		displancement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-		float y = displancement * 0.4f;
-		displancement = (rand() % (int)(2 * offset * 100)) / 100.0f - offset;
-		float z = cos(angle) * radius + displancement;
-		model = glm::translate(model, glm::vec3(x, y, z));
-
-		float scale = (rand() % 20) / 100.0f + 0.05f;
-		model = glm::scale(model, glm::vec3(scale));
-
-		float rotAngle = (rand() % 360);
-		model = glm::rotate(model, rotAngle, glm::vec3(0.4f, 0.6f, 0.8f));
-
-		modelMatrices[i] = model;
-	}
-
-	unsigned int buffer;
-	glGenBuffers(1, &buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
-	glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-	for (unsigned int i = 0; i < rock.meshes.size(); i++) {
-		unsigned int VAO = rock.meshes[i].VAO;
-		glBindVertexArray(VAO);
-		GLsizei vec4Size = sizeof(glm::vec4);
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)0);
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(vec4Size));
-		glEnableVertexAttribArray(5);
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(2 * vec4Size));
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(3 * vec4Size));
-
-		glVertexAttribDivisor(3, 1);
-		glVertexAttribDivisor(4, 1);
-		glVertexAttribDivisor(5, 1);
-		glVertexAttribDivisor(6, 1);
-		glBindVertexArray(0);
-	}
-	
+	asteroids.Generate(asteroidAmount, radius, offset, rock.Bounds);
+	gpuCuller.Upload(asteroids.Instances);
+	int generatedAmount = asteroidAmount;
+	proceduralField.Initialize(rock.Bounds);
+	bool wasGpuCulling = false;
 
 	while (!glfwWindowShouldClose(window)) {
 		float currentFrame = (float)glfwGetTime();
@@ -153,30 +142,152 @@ int main(int argc, char *argv[]) {
 		
 		view = camera.GetViewMatrix();
 		projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 10000.0f);
+		frustum.Update(projection * view);
+		frustum.ResetStats();
+
+		if (asteroidAmount != generatedAmount) {
+			asteroids.Generate(asteroidAmount, radius, offset, rock.Bounds);
+			gpuCuller.Upload(asteroids.Instances);
+			generatedAmount = asteroidAmount;
+		}
+
+		// The belt rotates as a whole in asteroid.vs, the rocks are culled in its frame instead.
+		glm::mat4 belt = GetBeltMatrix(currentFrame, orbitSpeed);
+		beltFrustum.Update(projection * view * belt);
+		glm::vec3 beltViewPos = glm::vec3(glm::inverse(belt) * glm::vec4(camera.Position, 1.0f));
+
+		// Impostors need the CPU culling, the other paths always draw meshes.
+		LodSettings lod;
+		lod.Scale = LodSettings::ScaleFor(glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+		lod.Band = impostorBand;
+		bool cpuCulling = fieldMode == FIELD_PROCEDURAL || cullMode == CULL_SINGLE_THREAD || cullMode == CULL_MULTI_THREAD;
+		if (useImpostors && cpuCulling) {
+			lod.Threshold = impostorThreshold;
+		}
+
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
+		model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
+
+		// The planet hides the rocks behind it, rendered in software before the CPU culling.
+		OcclusionBuffer* occlusion = nullptr;
+		if (useOcclusion && cpuCulling) {
+			occlusionBuffer.Begin(projection * view);
+			occlusionBuffer.AddOccluder(planet.OccluderVertices, planet.OccluderIndices, model);
+			occlusionBuffer.Rasterize(&threadPool);
+			occlusion = &occlusionBuffer;
+		}
+
+		// Only the rocks inside the frustum are compacted into the instance buffer.
+		if (fieldMode == FIELD_PROCEDURAL) {
+			proceduralField.SetSeed(fieldSeed);
+			proceduralField.Update(beltViewPos, &threadPool);
+		} else if (cullMode == CULL_NONE) {
+			asteroids.UploadAll();
+		} else if (cullMode == CULL_GPU) {
+			// Results left from before another path was used were culled against an old frustum.
+			if (!wasGpuCulling) {
+				gpuCuller.DiscardResults();
+			}
+			gpuCuller.Cull(cullShader, beltFrustum, beltViewPos, maxDistance, rock.Bounds);
+		} else {
+			asteroids.Cull(beltFrustum, beltViewPos, maxDistance, lod, cullMode == CULL_MULTI_THREAD ? &threadPool : nullptr, occlusion, projection * view * belt);
+		}
+		wasGpuCulling = fieldMode != FIELD_PROCEDURAL && cullMode == CULL_GPU;
 
 		asteroidShader.use();
 		asteroidShader.setMat4("view", view);
 		asteroidShader.setMat4("projection", projection);
+		asteroidShader.setFloat("time", currentFrame);
+		asteroidShader.setFloat("orbitSpeed", orbitSpeed);
+		asteroidShader.setVec4("bounds", glm::vec4(rock.Bounds.Center(), rock.Bounds.Radius()));
+		asteroidShader.setVec3("viewPos", camera.Position);
+		asteroidShader.setFloat("lodScale", lod.Scale);
+		asteroidShader.setFloat("lodThreshold", lod.Threshold);
+		asteroidShader.setFloat("lodBand", lod.Band);
 
 		planetShader.use();
 		planetShader.setMat4("view", view);
 		planetShader.setMat4("projection", projection);
 
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, -3.0f, 0.0f));
-		model = glm::scale(model, glm::vec3(4.0f, 4.0f, 4.0f));
 		planetShader.setMat4("model", model);
-		planet.Draw(planetShader);
+		if (cullMode == CULL_NONE || frustum.IsVisible(planet.Bounds.Transform(model))) {
+			planet.Draw(planetShader);
+		}
 
 		asteroidShader.use();
 		asteroidShader.setInt("texture_diffuse1", 0);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, rock.textures_loaded[0].id);
-		for (unsigned int i = 0; i < rock.meshes.size(); i++) {
-			glBindVertexArray(rock.meshes[i].VAO);
-			glDrawElementsInstanced(GL_TRIANGLES, rock.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, amount);
-			glBindVertexArray(0);
+		if (fieldMode == FIELD_PROCEDURAL) {
+			proceduralField.Draw(rock, beltFrustum, beltViewPos, lod, occlusion, projection * view * belt);
+		} else if (cullMode == CULL_GPU) {
+			gpuCuller.Draw(rock);
+		} else {
+			asteroids.Draw(rock);
+		}
+
+		if (lod.IsEnabled()) {
+			impostorShader.use();
+			impostorShader.setMat4("view", view);
+			impostorShader.setMat4("projection", projection);
+			impostorShader.setFloat("time", currentFrame);
+			impostorShader.setFloat("orbitSpeed", orbitSpeed);
+			impostorShader.setVec3("viewPos", camera.Position);
+			impostorShader.setFloat("lodScale", lod.Scale);
+			impostorShader.setFloat("lodThreshold", lod.Threshold);
+			impostorShader.setFloat("lodBand", lod.Band);
+			rockImpostor.Bind(impostorShader);
+			if (fieldMode == FIELD_PROCEDURAL) {
+				proceduralField.DrawImpostors(rockImpostor);
+			} else {
+				asteroids.DrawImpostors(rockImpostor);
+			}
 		}
+		asteroids.EndFrame();
+
+		ImGui::Begin("Control Panel");
+		ImGui::Text("%.1f FPS (%.2f ms)", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
+		ImGui::RadioButton("Belt", &fieldMode, FIELD_BELT);
+		ImGui::SameLine();
+		ImGui::RadioButton("Procedural Ring", &fieldMode, FIELD_PROCEDURAL);
+		ImGui::SliderFloat("Orbit Speed", &orbitSpeed, 0.0f, 0.5f);
+		ImGui::SliderFloat("Camera Speed", &camera.MovementSpeed, 5.0f, 500.0f);
+		ImGui::Text("Threads: %d", threadPool.GetThreadCount());
+		ImGui::Checkbox("Impostors (CPU culling)", &useImpostors);
+		ImGui::SliderFloat("Impostor Size (px)", &impostorThreshold, 1.0f, 64.0f);
+		ImGui::SliderFloat("Cross-fade Band", &impostorBand, 0.0f, 1.0f);
+		ImGui::Checkbox("Occlusion Culling (CPU culling)", &useOcclusion);
+		if (occlusion != nullptr) {
+			ImGui::Text("Occluders: %d triangles, %.2f ms", occlusionBuffer.TriangleCount, occlusionBuffer.RasterTime);
+		}
+		if (fieldMode == FIELD_PROCEDURAL) {
+			ImGui::InputInt("Seed", &fieldSeed);
+			ImGui::Text("Potential rocks: %.1f million", proceduralField.GetPotentialCount() / 1000000.0);
+			ImGui::Text("Chunks: %d resident, %d visible, %d occluded, %d generated", proceduralField.ResidentChunks, proceduralField.VisibleChunks, proceduralField.OccludedChunks, proceduralField.GeneratedChunks);
+			ImGui::Text("Pool: %.1f MB, update %.2f ms", proceduralField.GetPoolSize() / (1024.0f * 1024.0f), proceduralField.UpdateTime);
+		} else {
+			ImGui::SliderInt("Asteroids", &asteroidAmount, 1000, 1000000);
+			ImGui::RadioButton("No Culling", &cullMode, CULL_NONE);
+			ImGui::RadioButton("Single Thread", &cullMode, CULL_SINGLE_THREAD);
+			ImGui::RadioButton("Multithreaded", &cullMode, CULL_MULTI_THREAD);
+			ImGui::RadioButton("GPU (Transform Feedback)", &cullMode, CULL_GPU);
+			ImGui::SliderFloat("Max Distance", &maxDistance, 0.0f, 2000.0f);
+			ImGui::Text("Instance stream: %s, %d stalls", asteroids.IsStreamPersistent() ? "persistent" : "unsynchronized", asteroids.GetStreamStalls());
+			if (cullMode == CULL_GPU) {
+				ImGui::Text("Culling: %d tested, %d visible (last result)", gpuCuller.Tested, gpuCuller.Visible);
+			} else {
+				ImGui::Text("Culling: %d tested, %d visible, %d occluded, %.2f ms", asteroids.Tested, asteroids.Visible, asteroids.Occluded, asteroids.CullTime);
+			}
+		}
+		ImGui::Text("Planet: %d tested, %d visible", frustum.Tested, frustum.Visible);
+		if (fieldMode == FIELD_PROCEDURAL) {
+			ImGui::Text("Asteroids drawn: %d meshes, %d impostors", proceduralField.InstanceCount, lod.IsEnabled() ? proceduralField.ImpostorCount : 0);
+		} else {
+			ImGui::Text("Asteroids drawn: %d / %d", cullMode == CULL_GPU ? gpuCuller.InstanceCount : asteroids.InstanceCount, asteroids.GetCount());
+			ImGui::Text("Impostors drawn: %d", lod.IsEnabled() ? asteroids.ImpostorCount : 0);
+		}
+		ImGui::End();
 		
 		// render on the screen
 		ImGui::Render();
@@ -185,6 +296,11 @@ int main(int argc, char *argv[]) {
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
+	asteroids.Release();
+	gpuCuller.Release();
+	proceduralField.Release();
+	rockImpostor.Release();
+
 	// glDeleteVertexArrays(1, &quadVAO);
 	// glDeleteBuffers(1, &quadVBO);
 	
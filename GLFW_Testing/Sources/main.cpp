@@ -168,6 +168,20 @@ int main(void) {
 	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(5 * sizeof(float)));
 	glEnableVertexAttribArray(2);
 
+	// All cubes share the mesh and material, so their model matrices are streamed per instance.
+	const unsigned int cubeAmount = sizeof(cubePositions) / sizeof(cubePositions[0]);
+	glm::mat4 cubeModels[cubeAmount];
+	unsigned int instanceVBO;
+	glGenBuffers(1, &instanceVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(cubeModels), NULL, GL_STREAM_DRAW);
+	GLsizei vec4Size = sizeof(glm::vec4);
+	for (unsigned int i = 0; i < 4; i++) {
+		glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, 4 * vec4Size, (void*)(i * vec4Size));
+		glEnableVertexAttribArray(3 + i);
+		glVertexAttribDivisor(3 + i, 1);
+	}
+
 	unsigned int lightVAO;
 	glGenVertexArrays(1, &lightVAO);
 	glBindVertexArray(lightVAO);
@@ -288,17 +302,20 @@ int main(void) {
 		ourShader.setVec3("material.specular", materialSpecularVec);
 		ourShader.setFloat("material.shininess", materialShininess);
 
-		glBindVertexArray(VAO);
-		for (unsigned int i = 0; i < 10; i++)
+		for (unsigned int i = 0; i < cubeAmount; i++)
 		{
 			model = glm::mat4(1.0f);
 			model = glm::translate(model, cubePositions[i]);
 			float angle = 20.0f * (i + 1) * currentFrame;
 			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.5f, 0.3f, 0.5f));
-			ourShader.setMat4("model", model);
-			ourShader.setMat3("normalModel", glm::mat3(glm::transpose(glm::inverse(model))));
-			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+			cubeModels[i] = model;
 		}
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(cubeModels), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(cubeModels), cubeModels);
+
+		glBindVertexArray(VAO);
+		glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, cubeAmount);
 
 		// render GUI
 		static float rotation = 0.0f;
@@ -340,6 +357,7 @@ int main(void) {
 	glDeleteVertexArrays(1, &lightVAO);
 	glDeleteBuffers(1, &VBO);
 	glDeleteBuffers(1, &EBO);
+	glDeleteBuffers(1, &instanceVBO);
 
 	// clean up
 	ImGui_ImplOpenGL3_Shutdown();
@@ -32,6 +32,8 @@ public:
 	vector<unsigned int> indices;
 	vector<Texture> textures;
 	unsigned int VAO;
+	// Positions only, for depth-only passes
+	unsigned int DepthVAO;
 
 	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures) {
 		this->vertices = vertices;
@@ -71,8 +73,16 @@ public:
 		glActiveTexture(GL_TEXTURE0);
 	}
 
+	// Depth-only draw, the shader only reads the position at location 0.
+	void DrawDepth() {
+		glBindVertexArray(DepthVAO);
+		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
+	}
+
 private:
 	unsigned int VBO, EBO;
+	unsigned int depthVBO;
 
 	void setupMesh() {
 		glGenVertexArrays(1, &VAO);
@@ -98,6 +108,26 @@ private:
 		glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
 
 		glBindVertexArray(0);
+
+		// A tightly packed copy of the positions: 12 bytes a vertex instead of the whole Vertex,
+		// sharing the index buffer.
+		vector<glm::vec3> positions(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); i++) {
+			positions[i] = vertices[i].Position;
+		}
+		glGenVertexArrays(1, &DepthVAO);
+		glGenBuffers(1, &depthVBO);
+
+		glBindVertexArray(DepthVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, depthVBO);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+		glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), &positions[0], GL_STATIC_DRAW);
+
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+		glBindVertexArray(0);
 	}
 };
 
@@ -42,6 +42,13 @@ public:
 		}
 	}
 
+	// Positions only, for a depth pre-pass with Shaders/depth.vs/.fs.
+	void DrawDepth() {
+		for (unsigned int i = 0; i < meshes.size(); i++) {
+			meshes[i].DrawDepth();
+		}
+	}
+
 private:
 	void loadModel(string const &path) {
 		Assimp::Importer importer;
@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+
+// Must compute gl_Position exactly like model_loading.vs, so the GL_EQUAL pass matches.
+invariant gl_Position;
+
+void main() {
+	vec3 FragPos = vec3(model * vec4(aPos, 1.0));
+
+	gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
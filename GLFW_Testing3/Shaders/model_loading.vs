@@ -12,6 +12,9 @@ uniform mat4 view;
 uniform mat4 projection;
 uniform mat3 normalModel;
 
+// Same position as Shaders/depth.vs, the depth pre-pass relies on it.
+invariant gl_Position;
+
 void main() {
 	FragPos = vec3(model * vec4(aPos, 1.0));
 	Normal = normalModel * aNormal;
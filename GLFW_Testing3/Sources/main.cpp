@@ -31,6 +31,7 @@ float lastY = (float)SCR_HEIGHT / 2.0f;
 bool firstMouse = true;
 bool moveCameraView = false;
 bool enableFlash = true;
+bool useDepthPrepass = true;
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -71,6 +72,7 @@ int main(void) {
 
 	Shader ourShader("Shaders\\model_loading.vs", "Shaders\\model_loading.fs");
 	Shader lightCubeShader("Shaders\\lightcube.vs", "Shaders\\lightcube.fs");
+	Shader depthShader("Shaders\\depth.vs", "Shaders\\depth.fs");
 
 	Model ourModel("Resources\\objects\\nanosuit\\nanosuit.obj");
 
@@ -204,6 +206,10 @@ int main(void) {
 		ImGui::ColorPicker3("Color", color);
 		ImGui::SliderFloat("Outer cutoff", &lightOuterCutoff, 10, 100);
 		ImGui::End();
+
+		ImGui::Begin("Rendering");
+		ImGui::Checkbox("Depth Pre-pass", &useDepthPrepass);
+		ImGui::End();
 		spotlightColor = glm::vec3(color[0], color[1], color[2]);
 		ourShader.setVec3("spotlight.color", spotlightColor);
 		ourShader.setFloat("spotlight.cutoff", glm::cos(glm::radians(lightOuterCutoff - 5.0f)));
@@ -221,7 +227,26 @@ int main(void) {
 		model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
 		ourShader.setMat4("model", model);
 		ourShader.setMat3("normalModel", glm::mat3(glm::transpose(glm::inverse(model))));
+
+		// Lay down the depth first with the positions only, then shade each pixel once with GL_EQUAL.
+		if (useDepthPrepass) {
+			depthShader.use();
+			depthShader.setMat4("projection", projection);
+			depthShader.setMat4("view", view);
+			depthShader.setMat4("model", model);
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			ourModel.DrawDepth();
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+			ourShader.use();
+		}
 		ourModel.Draw(ourShader);
+		if (useDepthPrepass) {
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+		}
 
 		lightCubeShader.use();
 		lightCubeShader.setMat4("projection", projection);
@@ -0,0 +1,205 @@
+#ifndef OCCLUSIONQUERY_H
+#define OCCLUSIONQUERY_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.h"
+#include "frustum.h"
+
+#include <string>
+#include <vector>
+
+// Hardware occlusion culling for expensive draws. At the end of the opaque pass the bounding
+// box of every registered object is drawn (no color, no depth writes) inside a
+// GL_ANY_SAMPLES_PASSED query. Next frame the object is drawn inside a conditional render on
+// that query with GL_QUERY_NO_WAIT, so the GPU skips it when its box was hidden and the CPU
+// never waits; if the result isn't there yet the object is simply drawn.
+// Being one frame late, an object coming out from behind an occluder may appear a frame late.
+class OcclusionQueries {
+public:
+	struct Object {
+		std::string Name;
+		AABB LocalBounds;
+		AABB WorldBounds;
+		unsigned int Queries[2];
+		bool Issued[2];
+		bool Drawn;
+
+		// Statistics: frames with a query result, and how many of them were hidden
+		unsigned int Frames;
+		unsigned int Occluded;
+
+		float GetHitRate() const {
+			return Frames > 0 ? (float)Occluded / (float)Frames : 0.0f;
+		}
+	};
+
+	bool Enabled;
+	std::vector<Object> Objects;
+
+	OcclusionQueries() : Enabled(true), boxShader(nullptr), boxVAO(0), boxVBO(0), boxEBO(0), frame(0), cameraPosition(0.0f), viewProjection(1.0f) {
+
+	}
+
+	// The shader only needs a mvp uniform (see Shaders/occlusion_box.vs).
+	void Initialize(Shader* shader) {
+		boxShader = shader;
+
+		float vertices[] = {
+			0.0f, 0.0f, 0.0f,	1.0f, 0.0f, 0.0f,	1.0f, 1.0f, 0.0f,	0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 1.0f,	1.0f, 0.0f, 1.0f,	1.0f, 1.0f, 1.0f,	0.0f, 1.0f, 1.0f,
+		};
+		unsigned int indices[] = {
+			0, 2, 1,	0, 3, 2,
+			4, 5, 6,	4, 6, 7,
+			0, 1, 5,	0, 5, 4,
+			3, 6, 2,	3, 7, 6,
+			0, 4, 7,	0, 7, 3,
+			1, 2, 6,	1, 6, 5,
+		};
+		glGenVertexArrays(1, &boxVAO);
+		glGenBuffers(1, &boxVBO);
+		glGenBuffers(1, &boxEBO);
+		glBindVertexArray(boxVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxEBO);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+		glBindVertexArray(0);
+	}
+
+	// Register an object by its bounds in model space, returns its id.
+	unsigned int Add(const std::string& name, const AABB& localBounds) {
+		Object object;
+		object.Name = name;
+		object.LocalBounds = localBounds;
+		object.Issued[0] = object.Issued[1] = false;
+		object.Drawn = false;
+		object.Frames = 0;
+		object.Occluded = 0;
+		glGenQueries(2, object.Queries);
+		Objects.push_back(object);
+		return Objects.size() - 1;
+	}
+
+	// Start a frame, collect the results used by the frame before for the statistics, those that
+	// have arrived.
+	void BeginFrame(const glm::mat4& view, const glm::mat4& projection, glm::vec3 cameraPosition) {
+		frame++;
+		this->cameraPosition = cameraPosition;
+		viewProjection = projection * view;
+
+		unsigned int current = frame % 2;
+		for (unsigned int i = 0; i < Objects.size(); i++) {
+			Object& object = Objects[i];
+			object.Drawn = false;
+			// Issued two frames ago and used for last frame's draw. Only counted when the result is
+			// already there, the query is issued again this frame either way.
+			if (object.Issued[current]) {
+				GLuint available = GL_FALSE;
+				glGetQueryObjectuiv(object.Queries[current], GL_QUERY_RESULT_AVAILABLE, &available);
+				if (available == GL_TRUE) {
+					GLuint passed = 0;
+					glGetQueryObjectuiv(object.Queries[current], GL_QUERY_RESULT, &passed);
+					object.Frames++;
+					object.Occluded += (passed == 0);
+				}
+				object.Issued[current] = false;
+			}
+		}
+	}
+
+	// Wrap the draw of an object, model places it in the world this frame.
+	void BeginConditional(unsigned int id, const glm::mat4& model) {
+		Object& object = Objects[id];
+		object.WorldBounds = object.LocalBounds.Transform(model);
+		object.Drawn = true;
+		unsigned int previous = (frame + 1) % 2;
+		if (Enabled && object.Issued[previous]) {
+			glBeginConditionalRender(object.Queries[previous], GL_QUERY_NO_WAIT);
+		}
+	}
+
+	void EndConditional(unsigned int id) {
+		unsigned int previous = (frame + 1) % 2;
+		if (Enabled && Objects[id].Issued[previous]) {
+			glEndConditionalRender();
+		}
+	}
+
+	// Draw the boxes of this frame's objects against the depth buffer, after the opaque
+	// geometry and before anything transparent.
+	void IssueQueries() {
+		if (!Enabled || boxShader == nullptr) {
+			return;
+		}
+		unsigned int current = frame % 2;
+
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		glDepthMask(GL_FALSE);
+		boxShader->use();
+		glBindVertexArray(boxVAO);
+		for (unsigned int i = 0; i < Objects.size(); i++) {
+			Object& object = Objects[i];
+			if (!object.Drawn) {
+				continue;
+			}
+			// A little larger, so the box isn't hidden by the object's own surface.
+			glm::vec3 extents = object.WorldBounds.Extents() * 1.01f + 0.001f;
+			glm::vec3 min = object.WorldBounds.Center() - extents;
+			glm::vec3 max = object.WorldBounds.Center() + extents;
+
+			// The near plane would cut the box open, such an object is always drawn.
+			glm::vec3 margin = glm::vec3(0.2f);
+			if (glm::all(glm::greaterThan(cameraPosition, min - margin)) && glm::all(glm::lessThan(cameraPosition, max + margin))) {
+				continue;
+			}
+
+			glm::mat4 box = glm::translate(glm::mat4(1.0f), min);
+			box = glm::scale(box, max - min);
+			boxShader->setMat4("mvp", viewProjection * box);
+			glBeginQuery(GL_ANY_SAMPLES_PASSED, object.Queries[current]);
+			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+			glEndQuery(GL_ANY_SAMPLES_PASSED);
+			object.Issued[current] = true;
+		}
+		glBindVertexArray(0);
+		glDepthMask(GL_TRUE);
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+	}
+
+	void ResetStats() {
+		for (unsigned int i = 0; i < Objects.size(); i++) {
+			Objects[i].Frames = 0;
+			Objects[i].Occluded = 0;
+		}
+	}
+
+	void Release() {
+		for (unsigned int i = 0; i < Objects.size(); i++) {
+			glDeleteQueries(2, Objects[i].Queries);
+		}
+		Objects.clear();
+		if (boxVAO != 0) {
+			glDeleteVertexArrays(1, &boxVAO);
+			glDeleteBuffers(1, &boxVBO);
+			glDeleteBuffers(1, &boxEBO);
+			boxVAO = 0;
+		}
+	}
+
+private:
+	Shader* boxShader;
+	unsigned int boxVAO;
+	unsigned int boxVBO;
+	unsigned int boxEBO;
+	unsigned int frame;
+	glm::vec3 cameraPosition;
+	glm::mat4 viewProjection;
+};
+
+#endif // !OCCLUSIONQUERY_H
\ No newline at end of file
@@ -0,0 +1,364 @@
+#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Taps of one blur direction, the center and one for every two texels on each side, must match
+// Shaders/framebuffer_screen.fs
+const unsigned int POST_BLUR_MAX_TAPS = 9;
+const int POST_BLUR_MAX_RADIUS = 2 * (POST_BLUR_MAX_TAPS - 1);
+
+enum PostEffect {
+	POST_GRAYSCALE,
+	POST_INVERSION,
+	POST_SHARPEN,
+	POST_EDGE,
+	POST_BLUR
+};
+
+struct PostStage {
+	PostEffect Effect;
+	bool Enabled;
+	// Blur only, in texels
+	int Radius;
+};
+
+// Full screen effects declared as a list of stages and run in that order. Stages that only look at
+// their own pixel (grayscale, inversion) are fused into a neighboring pass: after a stage that
+// samples its neighbors they run on its result, before the first one on every tap it takes (both
+// are affine, so running them on a bilinear tap gives the same as on its texels). A sharpen or edge
+// result can leave [0, 1], so it is clamped before the stages after it, as the 8 bit target of an
+// unfused pass would. Every
+// sampling stage is then one pass, a blur two since it is split into a horizontal and a vertical
+// gaussian whose taps each fetch two texels with the bilinear filter, about radius + 1 fetches per
+// direction where a full 2D kernel would take (2 * radius + 1)^2.
+// The passes take turns writing into two color targets of the screen size, the last one into the
+// output. Each pass is a variant of Shaders/framebuffer_screen.fs with only its own stages defined,
+// compiled the first time it is needed, so disabled stages are not in any shader.
+class PostProcessChain {
+public:
+	std::vector<PostStage> Stages;
+
+	// Passes drawn by the last Render()
+	unsigned int Passes;
+
+	PostProcessChain() : Passes(0), width(0), height(0), quadVAO(0), quadVBO(0), vertexPath(nullptr), fragmentPath(nullptr) {
+		for (unsigned int i = 0; i < 2; i++) {
+			targets[i].FBO = 0;
+			targets[i].Texture = 0;
+		}
+	}
+
+	// vertexPath and fragmentPath: Shaders/framebuffer_screen.vs and framebuffer_screen.fs
+	void Initialize(unsigned int width, unsigned int height, const char* vertexPath, const char* fragmentPath) {
+		this->vertexPath = vertexPath;
+		this->fragmentPath = fragmentPath;
+
+		float quadVertices[] = {
+			-1.0f,  1.0f,		0.0f, 1.0f,
+			-1.0f, -1.0f,		0.0f, 0.0f,
+			 1.0f, -1.0f,		1.0f, 0.0f,
+
+			-1.0f,  1.0f,		0.0f, 1.0f,
+			 1.0f, -1.0f,		1.0f, 0.0f,
+			 1.0f,  1.0f,		1.0f, 1.0f
+		};
+		glGenVertexArrays(1, &quadVAO);
+		glGenBuffers(1, &quadVBO);
+		glBindVertexArray(quadVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+		glBindVertexArray(0);
+
+		Resize(width, height);
+	}
+
+	// Returns the index of the stage.
+	unsigned int AddStage(PostEffect effect, bool enabled = true, int radius = 4) {
+		PostStage stage;
+		stage.Effect = effect;
+		stage.Enabled = enabled;
+		stage.Radius = radius;
+		Stages.push_back(stage);
+		return Stages.size() - 1;
+	}
+
+	void Resize(unsigned int width, unsigned int height) {
+		if (width == 0 || height == 0 || (width == this->width && height == this->height)) {
+			return;
+		}
+		releaseTargets();
+		this->width = width;
+		this->height = height;
+
+		for (unsigned int i = 0; i < 2; i++) {
+			glGenTextures(1, &targets[i].Texture);
+			glBindTexture(GL_TEXTURE_2D, targets[i].Texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glGenFramebuffers(1, &targets[i].FBO);
+			glBindFramebuffer(GL_FRAMEBUFFER, targets[i].FBO);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, targets[i].Texture, 0);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				std::cout << "Error: Post process framebuffer " << i << " is not completed!" << std::endl;
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	// Run the enabled stages on the scene texture (linear filtered, of the same size) into the
+	// output framebuffer. Depth test and blending must be off.
+	void Render(unsigned int sceneTexture, unsigned int output) {
+		build();
+
+		glBindVertexArray(quadVAO);
+		glActiveTexture(GL_TEXTURE0);
+		unsigned int source = sceneTexture;
+		unsigned int target = 0;
+		for (unsigned int i = 0; i < passes.size(); i++) {
+			const Pass& pass = passes[i];
+			bool last = i == passes.size() - 1;
+			glBindFramebuffer(GL_FRAMEBUFFER, last ? output : targets[target].FBO);
+			glBindTexture(GL_TEXTURE_2D, source);
+
+			pass.Program->use();
+			pass.Program->setInt("screenTexture", 0);
+			if (pass.Effect == POST_BLUR) {
+				glm::vec2 direction = pass.Vertical ? glm::vec2(0.0f, 1.0f / height) : glm::vec2(1.0f / width, 0.0f);
+				glUniform2fv(glGetUniformLocation(pass.Program->ID, "blurDirection"), 1, &direction[0]);
+				glUniform1fv(glGetUniformLocation(pass.Program->ID, "blurOffsets"), pass.Taps, pass.Offsets);
+				glUniform1fv(glGetUniformLocation(pass.Program->ID, "blurWeights"), pass.Taps, pass.Weights);
+				pass.Program->setInt("blurTaps", pass.Taps);
+			}
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+
+			if (!last) {
+				source = targets[target].Texture;
+				target = 1 - target;
+			}
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glBindVertexArray(0);
+		Passes = passes.size();
+	}
+
+	static const char* GetName(PostEffect effect) {
+		switch (effect) {
+			case POST_GRAYSCALE:
+				return "Grayscale";
+			case POST_INVERSION:
+				return "Inversion";
+			case POST_SHARPEN:
+				return "Sharpen";
+			case POST_EDGE:
+				return "Edge Detection";
+			case POST_BLUR:
+				return "Blur";
+		}
+		return "";
+	}
+
+	void Release() {
+		releaseTargets();
+		for (auto it = programs.begin(); it != programs.end(); ++it) {
+			glDeleteProgram(it->second->ID);
+			delete it->second;
+		}
+		programs.clear();
+		passes.clear();
+		signature.clear();
+		if (quadVAO != 0) {
+			glDeleteVertexArrays(1, &quadVAO);
+			glDeleteBuffers(1, &quadVBO);
+		}
+		quadVAO = 0;
+		quadVBO = 0;
+	}
+
+private:
+	struct Target {
+		unsigned int FBO;
+		unsigned int Texture;
+	};
+
+	struct Pass {
+		// POST_SHARPEN, POST_EDGE or POST_BLUR, a plain copy with anything else
+		PostEffect Effect;
+		bool Vertical;
+		std::vector<PostEffect> Pre;
+		std::vector<PostEffect> Post;
+		Shader* Program;
+
+		// Blur only, offsets in texels and their weights, the center first
+		int Taps;
+		float Offsets[POST_BLUR_MAX_TAPS];
+		float Weights[POST_BLUR_MAX_TAPS];
+	};
+
+	unsigned int width;
+	unsigned int height;
+	Target targets[2];
+	unsigned int quadVAO;
+	unsigned int quadVBO;
+
+	const char* vertexPath;
+	const char* fragmentPath;
+	std::map<std::string, Shader*> programs;
+	std::vector<Pass> passes;
+	std::string signature;
+
+	static bool isPerPixel(PostEffect effect) {
+		return effect == POST_GRAYSCALE || effect == POST_INVERSION;
+	}
+
+	// Group the enabled stages into passes, only when the stages changed since the last frame.
+	void build() {
+		std::ostringstream stream;
+		for (unsigned int i = 0; i < Stages.size(); i++) {
+			if (Stages[i].Enabled) {
+				stream << Stages[i].Effect << ":" << (Stages[i].Effect == POST_BLUR ? Stages[i].Radius : 0) << ";";
+			}
+		}
+		if (stream.str() == signature && !passes.empty()) {
+			return;
+		}
+		signature = stream.str();
+
+		passes.clear();
+		std::vector<PostEffect> leading;
+		for (unsigned int i = 0; i < Stages.size(); i++) {
+			const PostStage& stage = Stages[i];
+			if (!stage.Enabled) {
+				continue;
+			}
+			if (isPerPixel(stage.Effect)) {
+				if (passes.empty()) {
+					leading.push_back(stage.Effect);
+				} else {
+					passes.back().Post.push_back(stage.Effect);
+				}
+				continue;
+			}
+
+			Pass pass = makePass(stage.Effect, false);
+			if (stage.Effect == POST_BLUR) {
+				setBlurTaps(pass, stage.Radius);
+				passes.push_back(pass);
+				pass.Vertical = true;
+			}
+			passes.push_back(pass);
+		}
+		// Nothing samples its neighbors, the per-pixel stages run in one copy pass.
+		if (passes.empty()) {
+			passes.push_back(makePass(POST_GRAYSCALE, false));
+			passes.back().Post = leading;
+		} else {
+			passes.front().Pre = leading;
+		}
+
+		for (unsigned int i = 0; i < passes.size(); i++) {
+			passes[i].Program = getProgram(passes[i]);
+		}
+	}
+
+	static Pass makePass(PostEffect effect, bool vertical) {
+		Pass pass;
+		pass.Effect = effect;
+		pass.Vertical = vertical;
+		pass.Program = nullptr;
+		pass.Taps = 0;
+		return pass;
+	}
+
+	// Gaussian weights of the texels 0 to radius, then every pair of texels 2k - 1 and 2k merged into
+	// one tap between them, at the offset where the bilinear filter gives them the same ratio.
+	static void setBlurTaps(Pass& pass, int radius) {
+		radius = std::max(1, std::min(radius, POST_BLUR_MAX_RADIUS));
+		float sigma = std::max(radius / 2.0f, 0.5f);
+		std::vector<float> weights(radius + 2, 0.0f);
+		float total = 0.0f;
+		for (int i = 0; i <= radius; i++) {
+			weights[i] = std::exp(-(float)(i * i) / (2.0f * sigma * sigma));
+			total += i == 0 ? weights[i] : 2.0f * weights[i];
+		}
+
+		pass.Offsets[0] = 0.0f;
+		pass.Weights[0] = weights[0] / total;
+		pass.Taps = 1;
+		for (int i = 1; i <= radius; i += 2) {
+			float weight = weights[i] + weights[i + 1];
+			pass.Offsets[pass.Taps] = (i * weights[i] + (i + 1) * weights[i + 1]) / weight;
+			pass.Weights[pass.Taps] = weight / total;
+			pass.Taps++;
+		}
+	}
+
+	static std::string getOps(const std::vector<PostEffect>& ops) {
+		std::string body;
+		for (unsigned int i = 0; i < ops.size(); i++) {
+			body += std::string(" c = ") + (ops[i] == POST_GRAYSCALE ? "Grayscale" : "Inversion") + "(c);";
+		}
+		return body;
+	}
+
+	Shader* getProgram(const Pass& pass) {
+		std::string defines;
+		if (pass.Effect == POST_SHARPEN) {
+			defines += "#define SAMPLE_SHARPEN\n";
+		} else if (pass.Effect == POST_EDGE) {
+			defines += "#define SAMPLE_EDGE\n";
+		} else if (pass.Effect == POST_BLUR) {
+			defines += "#define SAMPLE_BLUR\n";
+		}
+		if (!pass.Pre.empty()) {
+			defines += "#define PRE_OPS(c)" + getOps(pass.Pre) + "\n";
+		}
+		if (!pass.Post.empty()) {
+			std::string clamp = pass.Effect == POST_SHARPEN || pass.Effect == POST_EDGE ? " c = clamp(c, 0.0, 1.0);" : "";
+			defines += "#define POST_OPS(c)" + clamp + getOps(pass.Post) + "\n";
+		}
+
+		auto it = programs.find(defines);
+		if (it != programs.end()) {
+			return it->second;
+		}
+		Shader* program = new Shader(vertexPath, fragmentPath, defines);
+		programs[defines] = program;
+		return program;
+	}
+
+	void releaseTargets() {
+		for (unsigned int i = 0; i < 2; i++) {
+			if (targets[i].FBO != 0) {
+				glDeleteFramebuffers(1, &targets[i].FBO);
+				glDeleteTextures(1, &targets[i].Texture);
+			}
+			targets[i].FBO = 0;
+			targets[i].Texture = 0;
+		}
+		width = 0;
+		height = 0;
+	}
+};
+
+#endif // !POSTPROCESS_H
\ No newline at end of file
@@ -12,7 +12,8 @@ class Shader {
 public:
 	unsigned int ID;
 
-	Shader(const char* vertexPath, const char* fragmentPath) {
+	// defines are put right after the #version line of both stages, for variants of one file.
+	Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "") {
 		std::string vertexCode;
 		std::string fragmentCode;
 
@@ -41,6 +42,10 @@ public:
 		{
 			fprintf(stderr, "Failed to load shader files.\n");
 		}
+		if (!defines.empty()) {
+			vertexCode = insertDefines(vertexCode, defines);
+			fragmentCode = insertDefines(fragmentCode, defines);
+		}
 		const char* vShaderCode = vertexCode.c_str();
 		const char* fShaderCode = fragmentCode.c_str();
 
@@ -100,6 +105,14 @@ public:
 
 private:
 
+	static std::string insertDefines(const std::string& code, const std::string& defines) {
+		size_t line = code.find('\n');
+		if (line == std::string::npos) {
+			return code + "\n" + defines;
+		}
+		return code.substr(0, line + 1) + defines + code.substr(line + 1);
+	}
+
 	void checkCompileErrors(unsigned int shader, std::string type, const char* filePath) {
 		int success;
 		char infoLog[1024];
@@ -5,50 +5,69 @@ in vec2 TexCoords;
 
 uniform sampler2D screenTexture;
 
-const float offset = 1.0 / 300.0;
+// One pass of PostProcessChain (Headers/postprocess.h). The chain compiles a variant per pass with
+// at most one of SAMPLE_SHARPEN, SAMPLE_EDGE or SAMPLE_BLUR (a plain copy without any), and the
+// per-pixel stages fused into the pass as PRE_OPS, run on every tap, and POST_OPS, run on the result
+// (clamped to [0, 1] first after sharpen or edge, as it would be stored between two passes).
+// Disabled stages are never in the defines, so they cost nothing.
+#ifndef PRE_OPS
+#define PRE_OPS(c)
+#endif
+#ifndef POST_OPS
+#define POST_OPS(c)
+#endif
 
-void main()
-{    
-    vec2 offsets[9] = vec2[](
-        vec2(-offset, offset),
-        vec2( 0.0f, offset),
-        vec2(offset, offset),
-        vec2(-offset, 0.0f),
-        vec2(0.0f, 0.0f),
-        vec2(offset, 0.0f),
-        vec2(-offset, -offset),
-        vec2(0.0f, -offset),
-        vec2(offset, -offset)
-    );
-
-    float sharpen_kernel[9] = float[](
-        -1, -1, -1,
-        -1, 9, -1, 
-        -1, -1, -1
-    );
-
-    float blur_kernel[9] = float[](
-        1.0/16, 2.0/16, 1.0/16,
-        2.0/16, 4.0/16, 2.0/16,
-        1.0/16, 2.0/16, 1.0/16
-    );
-
-    float edge_kernel[9] = float[](
-        1, 1, 1,
-        1, -8, 1,
-        1, 1, 1
-    );
-
-    vec3 sampleTex[9];
-    for(int i = 0; i < 9; i++){
-        sampleTex[i] = vec3(texture(screenTexture, TexCoords.st + offsets[i]));
-    }
-    vec3 col = vec3(0.0);
-    for(int i = 0; i < 9; i++){
-        col += sampleTex[i] * edge_kernel[i];
-    }
-    FragColor = vec4(col, 1.0);
+// Must match POST_BLUR_MAX_TAPS
+#define BLUR_MAX_TAPS 9
+
+// One direction of a separable gaussian, each tap but the center sits between two texels so the
+// bilinear filter weighs both of them.
+uniform vec2 blurDirection;
+uniform float blurOffsets[BLUR_MAX_TAPS];
+uniform float blurWeights[BLUR_MAX_TAPS];
+uniform int blurTaps;
+
+vec3 Grayscale(vec3 color)
+{
+    return vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));
+}
 
+vec3 Inversion(vec3 color)
+{
+    return vec3(1.0) - color;
+}
 
-    FragColor = texture(screenTexture, TexCoords);
+vec3 Fetch(vec2 uv)
+{
+    vec3 color = texture(screenTexture, uv).rgb;
+    PRE_OPS(color)
+    return color;
+}
+
+vec3 Neighbors(vec2 uv, vec2 texel)
+{
+    return Fetch(uv + texel * vec2(-1.0, 1.0)) + Fetch(uv + texel * vec2(0.0, 1.0)) + Fetch(uv + texel * vec2(1.0, 1.0))
+         + Fetch(uv + texel * vec2(-1.0, 0.0)) + Fetch(uv + texel * vec2(1.0, 0.0))
+         + Fetch(uv + texel * vec2(-1.0, -1.0)) + Fetch(uv + texel * vec2(0.0, -1.0)) + Fetch(uv + texel * vec2(1.0, -1.0));
+}
+
+void main()
+{
+    vec2 texel = 1.0 / vec2(textureSize(screenTexture, 0));
+    vec3 color;
+#if defined(SAMPLE_SHARPEN)
+    color = Fetch(TexCoords) * 9.0 - Neighbors(TexCoords, texel);
+#elif defined(SAMPLE_EDGE)
+    color = Neighbors(TexCoords, texel) - Fetch(TexCoords) * 8.0;
+#elif defined(SAMPLE_BLUR)
+    color = Fetch(TexCoords) * blurWeights[0];
+    for (int i = 1; i < blurTaps; i++) {
+        vec2 offset = blurDirection * blurOffsets[i];
+        color += (Fetch(TexCoords + offset) + Fetch(TexCoords - offset)) * blurWeights[i];
+    }
+#else
+    color = Fetch(TexCoords);
+#endif
+    POST_OPS(color)
+    FragColor = vec4(color, 1.0);
 }
\ No newline at end of file
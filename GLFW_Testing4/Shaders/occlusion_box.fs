@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor;
+
+// Only depth tested for the occlusion queries, the color writes are masked.
+void main()
+{
+    FragColor = vec4(1.0);
+}
\ No newline at end of file
@@ -13,6 +13,9 @@
 #include "../Headers/shader.h"
 #include "../Headers/camera.h"
 #include "../Headers/model.h"
+#include "../Headers/frustum.h"
+#include "../Headers/occlusionquery.h"
+#include "../Headers/postprocess.h"
 
 #include <iostream>
 
@@ -44,6 +47,9 @@ glm::mat4 projection = glm::mat4(1.0f);
 
 unsigned int framebuffer, texColorBuffer, rbo;
 
+OcclusionQueries occlusionQueries;
+PostProcessChain postProcess;
+
 int main(int argc, char *argv[]) {
 
 	glfwInit();
@@ -71,9 +77,9 @@ int main(int argc, char *argv[]) {
 	}
 
 	Shader ourShader("Shaders\\deapth_testing.vs", "Shaders\\deapth_testing.fs");
-	Shader screenShader("Shaders\\framebuffer_screen.vs", "Shaders\\framebuffer_screen.fs");
 	Shader cubemapShader("Shaders\\cubemap.vs", "Shaders\\cubemap.fs");
 	Shader reflectShader("Shaders\\reflection.vs", "Shaders\\reflection.fs");
+	Shader boxShader("Shaders\\occlusion_box.vs", "Shaders\\occlusion_box.fs");
 	// Shader singleShader("Shaders\\deapth_testing.vs", "Shaders\\outlining.fs");
 
 	// Initalize ImGui and bind to GLFW and OpenGL3(glad)
@@ -159,16 +165,6 @@ int main(int argc, char *argv[]) {
 		 1.0,  0.5, 0.0,		0.0f, 0.0f, 1.0f,	1.0, 0.0,
 	};
 
-	float quadVertices[] = {
-		-1.0f,  1.0f,		0.0f, 1.0f,
-		-1.0f, -1.0f,		0.0f, 0.0f,
-		 1.0f, -1.0f,		1.0f, 0.0f,
-
-		-1.0f,  1.0f,		0.0f, 1.0f,
-		 1.0f, -1.0f,		1.0f, 0.0f,
-		 1.0f,  1.0f,		1.0f, 1.0f
-	};
-
 	unsigned int cubeVAO, cubeVBO, cubeEBO;
 	glGenVertexArrays(1, &cubeVAO);
 	glGenBuffers(1, &cubeVBO);
@@ -214,18 +210,6 @@ int main(int argc, char *argv[]) {
 		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
 	glBindVertexArray(0);
 
-	unsigned int quadVAO, quadVBO;
-	glGenVertexArrays(1, &quadVAO);
-	glGenBuffers(1, &quadVBO);
-	glBindVertexArray(quadVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(1);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-	glBindVertexArray(0);
-
 	// Create our frame buffer.
 	glGenFramebuffers(1, &framebuffer);
 	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
@@ -236,6 +220,8 @@ int main(int argc, char *argv[]) {
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glBindTexture(GL_TEXTURE_2D, 0);
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer, 0);
 
@@ -280,6 +266,21 @@ int main(int argc, char *argv[]) {
 	reflectShader.setInt("skybox", 0);
 	reflectShader.setInt("texture1", 1);
 
+	// The reflective cubes are the expensive draws, skipped while hidden.
+	occlusionQueries.Initialize(&boxShader);
+	unsigned int cubeQueries[2] = {
+		occlusionQueries.Add("Reflective cube 1", AABB(glm::vec3(-0.5f), glm::vec3(0.5f))),
+		occlusionQueries.Add("Reflective cube 2", AABB(glm::vec3(-0.5f), glm::vec3(0.5f)))
+	};
+
+	// The screen pass, every effect off shows the scene as it is.
+	postProcess.Initialize(SCR_WIDTH, SCR_HEIGHT, "Shaders\\framebuffer_screen.vs", "Shaders\\framebuffer_screen.fs");
+	postProcess.AddStage(POST_GRAYSCALE, false);
+	postProcess.AddStage(POST_SHARPEN, false);
+	postProcess.AddStage(POST_BLUR, false, 4);
+	postProcess.AddStage(POST_EDGE, false);
+	postProcess.AddStage(POST_INVERSION, false);
+
 	while (!glfwWindowShouldClose(window)) {
 		float currentFrame = (float)glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
@@ -322,6 +323,8 @@ int main(int argc, char *argv[]) {
 		reflectShader.setMat4("projection", projection);
 		reflectShader.setVec3("cameraPos", camera.Position);
 
+		occlusionQueries.BeginFrame(view, projection, camera.Position);
+
 		// Draw Skybox
 		glDepthFunc(GL_LEQUAL);
 		cubemapShader.use();
@@ -358,15 +361,22 @@ int main(int argc, char *argv[]) {
 			model = glm::translate(model, glm::vec3(-1.0f, 0.001f, -1.0f));
 			reflectShader.setMat4("model", model);
 			reflectShader.setMat3("normalModel", glm::mat3(glm::transpose(glm::inverse(model))));
+			occlusionQueries.BeginConditional(cubeQueries[0], model);
 			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+			occlusionQueries.EndConditional(cubeQueries[0]);
 			model = glm::mat4(1.0f);
 			model = glm::translate(model, glm::vec3(2.0f, 0.001f, 0.0f));
 			reflectShader.setMat4("model", model);
 			reflectShader.setMat3("normalModel", glm::mat3(glm::transpose(glm::inverse(model))));
+			occlusionQueries.BeginConditional(cubeQueries[1], model);
 			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+			occlusionQueries.EndConditional(cubeQueries[1]);
 		glBindVertexArray(0);
 		glDisable(GL_CULL_FACE);
 
+		// Against the opaque scene only, the windows below would hide the cubes behind them.
+		occlusionQueries.IssueQueries();
+
 		// Draw Windows
 		ourShader.use();
 		glEnable(GL_BLEND);
@@ -392,10 +402,31 @@ int main(int argc, char *argv[]) {
 		glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		screenShader.use();
-		glBindVertexArray(quadVAO);
-		glBindTexture(GL_TEXTURE_2D, texColorBuffer);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		postProcess.Render(texColorBuffer, 0);
+
+		ImGui::Begin("Occlusion Queries");
+		ImGui::Checkbox("Conditional Rendering", &occlusionQueries.Enabled);
+		for (unsigned int i = 0; i < occlusionQueries.Objects.size(); i++) {
+			const OcclusionQueries::Object& object = occlusionQueries.Objects[i];
+			ImGui::Text("%s: %.1f%% skipped (%d / %d frames)", object.Name.c_str(), object.GetHitRate() * 100.0f, object.Occluded, object.Frames);
+		}
+		if (ImGui::Button("Reset")) {
+			occlusionQueries.ResetStats();
+		}
+		ImGui::End();
+
+		ImGui::Begin("Post Processing");
+		for (unsigned int i = 0; i < postProcess.Stages.size(); i++) {
+			PostStage& stage = postProcess.Stages[i];
+			ImGui::PushID(i);
+			ImGui::Checkbox(PostProcessChain::GetName(stage.Effect), &stage.Enabled);
+			if (stage.Effect == POST_BLUR && stage.Enabled) {
+				ImGui::SliderInt("Radius", &stage.Radius, 1, POST_BLUR_MAX_RADIUS);
+			}
+			ImGui::PopID();
+		}
+		ImGui::Text("Passes: %d", postProcess.Passes);
+		ImGui::End();
 		
 		// render on the screen
 		ImGui::Render();
@@ -411,6 +442,8 @@ int main(int argc, char *argv[]) {
 	glDeleteBuffers(1, &planeVBO);
 	glDeleteRenderbuffers(1, &rbo);
 	glDeleteFramebuffers(1, &framebuffer);
+	occlusionQueries.Release();
+	postProcess.Release();
 	
 	// clean up
 	ImGui_ImplOpenGL3_Shutdown();
@@ -432,6 +465,8 @@ void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
 	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
 	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SCR_WIDTH, SCR_HEIGHT);
 	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	postProcess.Resize(width, height);
 	
 	glViewport(0, 0, width, height);
 }
@@ -13,8 +13,10 @@
 #include "../Headers/shader.h"
 #include "../Headers/camera.h"
 #include "../Headers/model.h"
+#include "../Headers/streambuffer.h"
 
 #include <iostream>
+#include <cstring>
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 void mouseCallback(GLFWwindow* window, double xpos, double ypos);
@@ -152,22 +154,14 @@ int main(int argc, char* argv[]) {
 	glUniformBlockBinding(shaderBlue.ID, uniformBlockIndexBlue, 0);
 	glUniformBlockBinding(shaderYellow.ID, uniformBlockIndexYellow, 0);
 
-	// 3. Now actually create the buffer
-	unsigned int uboMatrices;
-	glGenBuffers(1, &uboMatrices);
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-	glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_STATIC_DRAW);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	// 3. Now actually create the buffer, a ring so each frame writes a block the GPU isn't reading.
+	GLint uboAlignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uboAlignment);
+	StreamBuffer uboMatrices(GL_UNIFORM_BUFFER);
+	uboMatrices.Reserve(16 * uboAlignment);
 
-	// 4. Define the range of the buffer that links to a uniform binding point;
-	glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices, 0, 2 * sizeof(glm::mat4));
-
-	// 5. Store the projection matrix (We only do this once now)
 	// Note: we're not using zoom anymore by changing the FoV
 	glm::mat4 projection = glm::perspective(45.0f, (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-	glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
 	while (!glfwWindowShouldClose(window)) {
 
@@ -186,9 +180,17 @@ int main(int argc, char* argv[]) {
 		ImGui::NewFrame();
 
 		glm::mat4 view = camera.GetViewMatrix();
-		glBindBuffer(GL_UNIFORM_BUFFER, uboMatrices);
-		glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+		// 4. Store the matrices of this frame and link that range to the uniform binding point.
+		uboMatrices.BeginFrame();
+		size_t uboOffset = 0;
+		unsigned char* block = (unsigned char*)uboMatrices.Map(2 * sizeof(glm::mat4), uboAlignment, &uboOffset);
+		if (block != nullptr) {
+			std::memcpy(block, glm::value_ptr(projection), sizeof(glm::mat4));
+			std::memcpy(block + sizeof(glm::mat4), glm::value_ptr(view), sizeof(glm::mat4));
+			uboMatrices.Unmap();
+			glBindBufferRange(GL_UNIFORM_BUFFER, 0, uboMatrices.GetBuffer(), uboOffset, 2 * sizeof(glm::mat4));
+		}
 
 		glm::mat4 model = glm::mat4(1.0f);
 		
@@ -217,6 +219,7 @@ int main(int argc, char* argv[]) {
 			shaderBlue.setMat4("model", model);
 			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 		glBindVertexArray(0);
+		uboMatrices.EndFrame();
 
 		// render on the screen
 		ImGui::Render();
@@ -228,6 +231,7 @@ int main(int argc, char* argv[]) {
 	glDeleteVertexArrays(1, &cubeVAO);
 	glDeleteBuffers(1, &cubeVBO);
 	glDeleteBuffers(1, &cubeEBO);
+	uboMatrices.Release();
 
 	// clean up
 	ImGui_ImplOpenGL3_Shutdown();